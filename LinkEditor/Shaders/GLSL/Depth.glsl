@@ -9,11 +9,20 @@ layout(binding = 0) uniform ViewProjectionUBO {
     mat4 ProjMatrix;
 } ViewProj;
 
+uniform int u_VertexFormat; // `MeshVertexFormat`: 0 for float attributes, otherwise normals are octahedral.
+uniform vec4 u_PositionOffset;
+uniform vec4 u_PositionScale; // Maps quantized positions back over the mesh bounds.
+
+vec3 DecodePosition()
+{
+    return u_PositionOffset.xyz + a_Position * u_PositionScale.xyz;
+}
+
 layout(location = 0) out vec4 VertexPosition;
 
 void main()
 {
-    VertexPosition = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(a_Position, 1.0);
+    VertexPosition = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(DecodePosition(), 1.0);
     gl_Position = VertexPosition;
 }
 
@@ -11,19 +11,74 @@ layout(binding = 0) uniform ViewProjectionUBO {
     mat4 ProjMatrix;
 } ViewProj;
 
+uniform int u_VertexFormat; // `MeshVertexFormat`: 0 for float attributes, otherwise normals are octahedral.
+uniform vec4 u_PositionOffset;
+uniform vec4 u_PositionScale; // Maps quantized positions back over the mesh bounds.
+
+vec3 DecodePosition()
+{
+    return u_PositionOffset.xyz + a_Position * u_PositionScale.xyz;
+}
+
+layout(location = 0) out float Highlight;
+
+uniform int u_ElementType; // `MeshElementType` of the drawn buffer: 1 for faces, 2 for vertices, 3 for edges.
+
+// Selected and hovered bits of each face, edge and vertex, written by `MeshSelectionBuffer`.
+layout(std430, binding = 3) readonly buffer MeshSelectionSSBO {
+    uint SectionOffsets[6]; // Word offsets in `Bits` of the face, edge and vertex bits, each selected and then hovered.
+    uint Bits[];
+} Selection;
+
+bool IsHighlighted(uint Section, uint Element)
+{
+    uint Word = Selection.Bits[Selection.SectionOffsets[Section] + Element / 32u] | Selection.Bits[Selection.SectionOffsets[Section + 1u] + Element / 32u];
+    return ((Word >> (Element % 32u)) & 1u) != 0;
+}
+
 void main()
 { 
-    gl_Position = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(a_Position, 1.0);
+    gl_Position = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(DecodePosition(), 1.0);
+    // Vertex buffers are indexed by vertex, and edge buffers hold the two vertices of each edge.
+    Highlight = (u_ElementType == 2 && IsHighlighted(4u, uint(gl_VertexID))) || (u_ElementType == 3 && IsHighlighted(2u, uint(gl_VertexID) / 2u)) ? 1.0 : 0.0;
 }
 
 #type fragment
 #version 450
 
+layout(location = 0) in float Highlight;
+
 uniform vec4 u_Color;
 
 layout(location = 0) out vec4 Color;
 
+uniform int u_ElementType;
+uniform vec4 u_HighlightColor;
+
+// Selected and hovered bits of each face, edge and vertex, written by `MeshSelectionBuffer`.
+layout(std430, binding = 3) readonly buffer MeshSelectionSSBO {
+    uint SectionOffsets[6]; // Word offsets in `Bits` of the face, edge and vertex bits, each selected and then hovered.
+    uint Bits[];
+} Selection;
+
+bool IsHighlighted(uint Section, uint Element)
+{
+    uint Word = Selection.Bits[Selection.SectionOffsets[Section] + Element / 32u] | Selection.Bits[Selection.SectionOffsets[Section + 1u] + Element / 32u];
+    return ((Word >> (Element % 32u)) & 1u) != 0;
+}
+
+layout(std430, binding = 4) readonly buffer TriangleFacesSSBO {
+    uint TriangleFaces[];
+};
+
+// Highlight of the vertex stage, or of the face of the triangle.
+float GetHighlight(float VertexHighlight)
+{
+    bool bIsFaceHighlighted = u_ElementType == 1 && gl_PrimitiveID < TriangleFaces.length() && IsHighlighted(0u, TriangleFaces[gl_PrimitiveID]);
+    return bIsFaceHighlighted ? 1.0 : VertexHighlight;
+}
+
 void main()
 {
-    Color = u_Color;
+    Color = mix(u_Color, u_HighlightColor, GetHighlight(Highlight));
 }
\ No newline at end of file
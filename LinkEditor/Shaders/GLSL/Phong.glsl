@@ -11,14 +11,52 @@ layout(binding = 0) uniform ViewProjectionUBO {
     mat4 ProjMatrix;
 } ViewProj;
 
+uniform int u_VertexFormat; // `MeshVertexFormat`: 0 for float attributes, otherwise normals are octahedral.
+uniform vec4 u_PositionOffset;
+uniform vec4 u_PositionScale; // Maps quantized positions back over the mesh bounds.
+
+vec3 DecodePosition()
+{
+    return u_PositionOffset.xyz + a_Position * u_PositionScale.xyz;
+}
+
+vec3 DecodeOctahedral(vec2 Encoded)
+{
+    vec3 Normal = vec3(Encoded, 1.0 - abs(Encoded.x) - abs(Encoded.y));
+    if (Normal.z < 0.0) Normal.xy = (1.0 - abs(Normal.yx)) * vec2(Normal.x >= 0.0 ? 1.0 : -1.0, Normal.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(Normal);
+}
+
+vec3 DecodeNormal()
+{
+    return u_VertexFormat == 0 ? a_WorldNormal : DecodeOctahedral(a_WorldNormal.xy);
+}
+
 layout(location = 0) out vec4 WorldPosition;
 layout(location = 1) out vec3 WorldNormal;
+layout(location = 2) out float Highlight;
+
+uniform int u_ElementType; // `MeshElementType` of the drawn buffer: 1 for faces, 2 for vertices, 3 for edges.
+
+// Selected and hovered bits of each face, edge and vertex, written by `MeshSelectionBuffer`.
+layout(std430, binding = 3) readonly buffer MeshSelectionSSBO {
+    uint SectionOffsets[6]; // Word offsets in `Bits` of the face, edge and vertex bits, each selected and then hovered.
+    uint Bits[];
+} Selection;
+
+bool IsHighlighted(uint Section, uint Element)
+{
+    uint Word = Selection.Bits[Selection.SectionOffsets[Section] + Element / 32u] | Selection.Bits[Selection.SectionOffsets[Section + 1u] + Element / 32u];
+    return ((Word >> (Element % 32u)) & 1u) != 0;
+}
 
 void main()
 {
-    WorldPosition = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(a_Position, 1.0);
-    WorldNormal = normalize(mat3(u_ModelMatrix) * a_WorldNormal);
+    WorldPosition = ViewProj.ProjMatrix * ViewProj.ViewMatrix * u_ModelMatrix * vec4(DecodePosition(), 1.0);
+    WorldNormal = normalize(mat3(u_ModelMatrix) * DecodeNormal());
     gl_Position = WorldPosition;
+    // Vertex buffers are indexed by vertex, and edge buffers hold the two vertices of each edge.
+    Highlight = (u_ElementType == 2 && IsHighlighted(4u, uint(gl_VertexID))) || (u_ElementType == 3 && IsHighlighted(2u, uint(gl_VertexID) / 2u)) ? 1.0 : 0.0;
 }
 
 #type fragment
@@ -26,6 +64,7 @@ void main()
 
 layout(location = 0) in vec4 WorldPosition;
 layout(location = 1) in vec3 WorldNormal;
+layout(location = 2) in float Highlight;
 
 uniform vec4 u_DiffuseColor;
 uniform vec4 u_SpecularColor;
@@ -37,9 +76,58 @@ layout(binding = 2) uniform LightShaderDataUBO {
 
 layout(location = 0) out vec4 Color;
 
+uniform int u_ElementType;
+uniform vec4 u_HighlightColor;
+
+// Selected and hovered bits of each face, edge and vertex, written by `MeshSelectionBuffer`.
+layout(std430, binding = 3) readonly buffer MeshSelectionSSBO {
+    uint SectionOffsets[6]; // Word offsets in `Bits` of the face, edge and vertex bits, each selected and then hovered.
+    uint Bits[];
+} Selection;
+
+bool IsHighlighted(uint Section, uint Element)
+{
+    uint Word = Selection.Bits[Selection.SectionOffsets[Section] + Element / 32u] | Selection.Bits[Selection.SectionOffsets[Section + 1u] + Element / 32u];
+    return ((Word >> (Element % 32u)) & 1u) != 0;
+}
+
+layout(std430, binding = 4) readonly buffer TriangleFacesSSBO {
+    uint TriangleFaces[];
+};
+
+// Highlight of the vertex stage, or of the face of the triangle.
+float GetHighlight(float VertexHighlight)
+{
+    bool bIsFaceHighlighted = u_ElementType == 1 && gl_PrimitiveID < TriangleFaces.length() && IsHighlighted(0u, TriangleFaces[gl_PrimitiveID]);
+    return bIsFaceHighlighted ? 1.0 : VertexHighlight;
+}
+
+uniform mat4 u_ModelMatrix;
+
+// Octahedral normal of each face as two normalized shorts, so that faces drawn from shared vertices are shaded flat.
+layout(std430, binding = 5) readonly buffer FaceNormalsSSBO {
+    uint FaceNormals[];
+};
+
+vec3 DecodeOctahedral(vec2 Encoded)
+{
+    vec3 Normal = vec3(Encoded, 1.0 - abs(Encoded.x) - abs(Encoded.y));
+    if (Normal.z < 0.0) Normal.xy = (1.0 - abs(Normal.yx)) * vec2(Normal.x >= 0.0 ? 1.0 : -1.0, Normal.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(Normal);
+}
+
+// Normal of the face of the triangle, or the interpolated vertex normal.
+vec3 GetNormal()
+{
+    if (u_ElementType != 1 || gl_PrimitiveID >= TriangleFaces.length()) return normalize(WorldNormal);
+
+    vec3 FaceNormal = DecodeOctahedral(unpackSnorm2x16(FaceNormals[TriangleFaces[gl_PrimitiveID]]));
+    return normalize(mat3(u_ModelMatrix) * FaceNormal);
+}
+
 void main()
 {
-    vec3 Normal = normalize(WorldNormal);
+    vec3 Normal = GetNormal();
     vec3 LightDir = normalize(LightShaderData.LightDirAndIntensity.xyz);
     float NDotL = max(0.0, dot(LightDir, Normal));
 
@@ -48,7 +136,8 @@ void main()
     vec3 Ambient = MaterialAmbient * LightShaderData.LightColorAndAmbient.w;
 
     // Diffuse
-    vec3 Diffuse = LightShaderData.LightColorAndAmbient.rgb * u_DiffuseColor.rgb * NDotL;
+    vec3 DiffuseColor = mix(u_DiffuseColor.rgb, u_HighlightColor.rgb, GetHighlight(Highlight));
+    vec3 Diffuse = LightShaderData.LightColorAndAmbient.rgb * DiffuseColor * NDotL;
     
     // Specular
     vec3 ReflectDir = normalize(reflect(-LightDir, Normal));
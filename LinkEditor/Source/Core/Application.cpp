@@ -7,6 +7,7 @@
 #include "Renderer/Texture/Texture.h"
 #include "Renderer/Texture/Texture2D/Texture2D.h"
 #include "Renderer/Ray/Ray.h"
+#include "Core/Thread/ThreadPool.h"
 #include "MeshSegmentation/MeshSegementation.h"
 
 #include <nfd.h>
@@ -26,6 +27,10 @@ LINK_EDITOR_NAMESPACE_BEGIN
     static float LastFrameTime;
 static glm::vec2 LastMousePos;
 static bool bIsViewportHovered = false;
+static bool bIsRegionSelecting = false;        // Marquee or lasso drag in progress.
+static bool bIsRegionSelectVisibleOnly = false;
+static std::vector<glm::vec2> LassoPoints;     // NDC positions of the lasso drag, empty for a marquee.
+static std::atomic<bool> bIsExporting = false;
 
 std::shared_ptr<Application> Application::Instance = nullptr;
 
@@ -39,6 +44,40 @@ static void ShowDockingDisabledMessage()
         IO.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
 }
 
+// Snapshots the mesh, its face colors and matching segmentation labels, and writes them on the thread pool so that the UI stays responsive.
+static void ExportMeshAsync(const Mesh& InMesh, const fs::path& InFilePath)
+{
+    if(bIsExporting.exchange(true))
+    {
+        LOG_WARN("An export is already in progress");
+        return;
+    }
+
+    auto Data = std::make_shared<MeshData>(InMesh.CreateMeshData());
+    auto Attributes = std::make_shared<MeshFileAttributes>();
+    Attributes->FaceColors = InMesh.CreateFaceColors();
+    const Eigen::VectorXi& SegLabels = MeshSegmentationManager::CurrentSegmentationInfo.SegLabels;
+    if(SegLabels.size() == InMesh.GetFaceCount())
+    {
+        Attributes->FaceLabels.assign(SegLabels.data(), SegLabels.data() + SegLabels.size());
+    }
+
+    ThreadPool::Get().EnqueueBackground([InFilePath, Data, Attributes]
+    {
+        const auto StartTime = std::chrono::steady_clock::now();
+        if(WriteMeshFile(InFilePath, *Data, *Attributes))
+        {
+            const auto ElapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+            LOG_INFO("Exported {0} vertices and {1} faces to {2} in {3} ms", Data->GetVertexCount(), Data->GetFaceCount(), InFilePath.string(), ElapsedMs);
+        }
+        else
+        {
+            LOG_ERROR("Error exporting mesh file: {0}", InFilePath.string());
+        }
+        bIsExporting = false;
+    });
+}
+
 Application::Application()
 {
     AppWindow = std::make_unique<Window>(WindowProps());
@@ -110,6 +149,7 @@ void Application::Update()
         if(!bIsMinimized)
         {
             // Render Scene
+            AppScene->UpdateMeshImports();
             AppScene->SetViewportSize(AppWindow->GetWidth(), AppWindow->GetHeight());
             
             AppScene->SceneRenderer->GetFrameBuffer()->Bind();
@@ -243,31 +283,66 @@ void Application::RenderImGUI()
                 static const std::vector<nfdfilteritem_t> Filters {
                         {"Mesh object", "obj,off,ply,stl,om"}
                 };
-                nfdchar_t *NFDPath;
-                nfdresult_t Result = NFD_OpenDialog(&NFDPath, Filters.data(), Filters.size(), "");
+                const nfdpathset_t *NFDPaths;
+                nfdresult_t Result = NFD_OpenDialogMultiple(&NFDPaths, Filters.data(), Filters.size(), "");
                 if (Result == NFD_OKAY)
                 {
-                    const auto Path = fs::path(NFDPath);
-                    
-                    MeshCreateInfo MeshCreateInfo;
-                    MeshCreateInfo.Name = Path.filename().string();
-                    AppScene->AddMesh(Path, MeshCreateInfo);
-                    
-                    NFD_FreePath(NFDPath);
+                    nfdpathsetsize_t PathCount = 0;
+                    NFD_PathSet_GetCount(NFDPaths, &PathCount);
+                    for (nfdpathsetsize_t i = 0; i < PathCount; ++i)
+                    {
+                        nfdchar_t *NFDPath;
+                        if (NFD_PathSet_GetPath(NFDPaths, i, &NFDPath) != NFD_OKAY) continue;
+
+                        const auto Path = fs::path(NFDPath);
+                        MeshCreateInfo MeshCreateInfo;
+                        MeshCreateInfo.Name = Path.filename().string();
+                        AppScene->ImportMesh(Path, MeshCreateInfo);
+
+                        NFD_PathSet_FreePath(NFDPath);
+                    }
+                    NFD_PathSet_Free(NFDPaths);
                 }
                 else if (Result != NFD_CANCEL) {
                     LOG_ERROR("Error loading mesh file: {0}", NFD_GetError());
                 }
             }
 
-            if(ImGui::MenuItem("Export Mesh"))
+            const bool bCanExport = AppScene->SelectedEntity != entt::null && !bIsExporting;
+            bool bIsExportPathNeeded = false;
+            if(ImGui::MenuItem("Export Mesh", nullptr, false, bCanExport))
             {
-                // TODO(WT)
+                // Each mesh is exported to its own last destination, so that another mesh never overwrites it.
+                if(const auto* Destination = AppScene->Registry.try_get<ExportDestination>(AppScene->SelectedEntity))
+                {
+                    ExportMeshAsync(AppScene->GetSelectedMesh(), Destination->FilePath);
+                }
+                else
+                {
+                    bIsExportPathNeeded = true;
+                }
             }
 
-            if(ImGui::MenuItem("Export Mesh As..."))
+            if(ImGui::MenuItem("Export Mesh As...", nullptr, false, bCanExport) || bIsExportPathNeeded)
             {
-                // TODO(WT)
+                static const std::vector<nfdfilteritem_t> Filters {
+                        {"Binary PLY", "ply"}, {"Wavefront OBJ", "obj"}, {"Binary STL", "stl"}
+                };
+                const std::string DefaultName = fs::path(AppScene->GetEntityName(AppScene->SelectedEntity)).replace_extension(".ply").string();
+                nfdchar_t *NFDPath;
+                nfdresult_t Result = NFD_SaveDialog(&NFDPath, Filters.data(), Filters.size(), nullptr, DefaultName.c_str());
+                if (Result == NFD_OKAY)
+                {
+                    fs::path ExportPath(NFDPath);
+                    if(!ExportPath.has_extension()) ExportPath.replace_extension(".ply");
+                    AppScene->Registry.emplace_or_replace<ExportDestination>(AppScene->SelectedEntity, ExportPath);
+                    ExportMeshAsync(AppScene->GetSelectedMesh(), ExportPath);
+
+                    NFD_FreePath(NFDPath);
+                }
+                else if (Result != NFD_CANCEL) {
+                    LOG_ERROR("Error exporting mesh file: {0}", NFD_GetError());
+                }
             }
 
             ImGui::Separator();
@@ -314,7 +389,7 @@ void Application::RenderImGUI()
                 if(ImGui::MenuItem("Load Seg File"))
                 {
                     static const std::vector<nfdfilteritem_t> Filters {
-                            {"Mesh Seg Labels", "seg"}
+                            {"Mesh Seg Labels", "seg,lkseg"}
                     };
                     nfdchar_t *NFDPath;
                     nfdresult_t Result = NFD_OpenDialog(&NFDPath, Filters.data(), Filters.size(), "");
@@ -330,9 +405,23 @@ void Application::RenderImGUI()
                     }
                 }
 
-                if(ImGui::MenuItem("Save Seg File"))
+                const Eigen::VectorXi& SegLabels = MeshSegmentationManager::CurrentSegmentationInfo.SegLabels;
+                if(ImGui::MenuItem("Save Seg File", nullptr, false, SegLabels.size() > 0))
                 {
-                    
+                    static const std::vector<nfdfilteritem_t> Filters {
+                            {"Mesh Seg Labels", "seg"}, {"Binary Mesh Seg Labels", "lkseg"}
+                    };
+                    nfdchar_t *NFDPath;
+                    nfdresult_t Result = NFD_SaveDialog(&NFDPath, Filters.data(), Filters.size(), nullptr, nullptr);
+                    if (Result == NFD_OKAY)
+                    {
+                        MeshSegmentationManager::SaveSegLabels(SegLabels, fs::path(NFDPath).string());
+
+                        NFD_FreePath(NFDPath);
+                    }
+                    else if (Result != NFD_CANCEL) {
+                        LOG_ERROR("Error saving label file: {0}", NFD_GetError());
+                    }
                 }
 
 
@@ -376,16 +465,46 @@ void Application::RenderImGUI()
             ImGui::SeparatorText("Stats");
             ImGui::Text("FPS : %.1f", IO.Framerate);
         }
+
+        if(!AppScene->GetMeshImports().empty())
+        {
+            ImGui::SeparatorText("Importing");
+            for(const auto& Import : AppScene->GetMeshImports())
+            {
+                const std::string Overlay = Import->CreateInfo.Name + ": " + Import->Progress.Stage.load();
+                ImGui::ProgressBar(Import->Progress.Fraction, ImVec2(-1, 0), Overlay.c_str());
+            }
+        }
         
         if(ImGui::CollapsingHeader("General"))
         {
             ImGui::Checkbox("Show Stats", &bIsShowStats);
+            ImGui::DragFloat("Weld Tolerance On Load", &Mesh::VertexWeldTolerance, 1e-6f, 0.0f, 0.01f, "%.6f");
+            ImGui::DragFloat("Import Upload Budget (ms)", &AppScene->MeshUploadBudgetMs, 0.1f, 0.5f, 33.0f, "%.1f");
+            ImGui::Checkbox("Use Mesh Cache", &Mesh::bUseMeshCache);
+            if(Mesh::bUseMeshCache)
+            {
+                ImGui::Checkbox("Compress Mesh Cache", &Mesh::bCompressMeshCache);
+                if(Mesh::bCompressMeshCache)
+                {
+                    // Unquantized values are exact. The sliders stay within the codec's bit ranges, so that cache keys match the encoding.
+                    auto& CodecOptions = Mesh::MeshCacheCodecOptions;
+                    bool bIsQuantizingPositions = CodecOptions.PositionBits > 0, bIsQuantizingNormals = CodecOptions.NormalBits > 0;
+                    if(ImGui::Checkbox("Quantize Positions", &bIsQuantizingPositions)) CodecOptions.PositionBits = bIsQuantizingPositions ? 16 : 0;
+                    if(bIsQuantizingPositions) ImGui::SliderInt("Position Bits", (int*)&CodecOptions.PositionBits, 8, 24, "%d", ImGuiSliderFlags_AlwaysClamp);
+                    if(ImGui::Checkbox("Quantize Normals", &bIsQuantizingNormals)) CodecOptions.NormalBits = bIsQuantizingNormals ? 16 : 0;
+                    if(bIsQuantizingNormals) ImGui::SliderInt("Normal Bits", (int*)&CodecOptions.NormalBits, 6, 16, "%d", ImGuiSliderFlags_AlwaysClamp);
+                }
+            }
         }
 
         if(ImGui::CollapsingHeader("Rendering"))
         {
             if(ImGui::TreeNode("Render Settings"))
             {
+                // Applies to meshes added afterwards.
+                ImGui::Combo("Vertex Format", (int*)&Mesh::RenderVertexFormat, "Float\0Packed\0Quantized\0");
+                ImGui::Checkbox("Share Face Vertices", &Mesh::bShareFaceVertices);
                 ImGui::Checkbox("Show Face", &bIsShowFace);
                 if(bIsShowFace)
                 {
@@ -426,6 +545,89 @@ void Application::RenderImGUI()
                 ImGui::Spacing();
             }
             
+            if(ImGui::TreeNode("BVH"))
+            {
+                if(ImGui::Combo("Query Structure", (int*)&Mesh::BVHQueryType, "Binary\0BVH4\0BVH8\0"))
+                {
+                    for(auto Entity : AppScene->Registry.view<MeshComponent>())
+                    {
+                        AppScene->GetMesh(Entity).UpdateWideBVH();
+                    }
+                }
+                ImGui::Combo("Builder", (int*)&Mesh::BVHOptions.Builder, "Median\0SAH\0");
+                ImGui::SliderInt("Max Leaf Size", (int*)&Mesh::BVHOptions.MaxLeafSize, 1, BVH::MaxLeafSizeLimit);
+                if(Mesh::BVHOptions.Builder == BVHBuilder::SAH)
+                {
+                    ImGui::SliderInt("Bin Count", (int*)&Mesh::BVHOptions.BinCount, 2, BVH::MaxBinCount);
+                }
+                ImGui::SliderFloat("Rebuild Threshold", &Mesh::BVHRebuildThreshold, 1.0f, 4.0f, "%.2f");
+
+                if(AppScene->SelectedEntity != entt::null)
+                {
+                    auto& SelectedMesh = AppScene->GetMesh(AppScene->SelectedEntity);
+                    if(ImGui::Button("Rebuild BVH"))
+                    {
+                        SelectedMesh.RebuildBVH();
+                    }
+                    ImGui::SameLine();
+                    if(ImGui::Button("Refit BVH"))
+                    {
+                        SelectedMesh.RefitBVH();
+                    }
+
+                    static std::vector<BVHBenchmarkResult> BenchmarkResults;
+                    ImGui::SameLine();
+                    if(ImGui::Button("Benchmark"))
+                    {
+                        BenchmarkResults = SelectedMesh.BenchmarkBVH(100000);
+                    }
+                    for(const auto& Result : BenchmarkResults)
+                    {
+                        static const char* TypeNames[] = {"Binary", "BVH4", "BVH8"};
+                        ImGui::Text("%s: Build %.2f ms, 100k Rays %.2f ms, %u Hits", TypeNames[static_cast<int>(Result.Type)], Result.BuildTimeMs, Result.QueryTimeMs, Result.HitCount);
+                    }
+
+                    const BVHStats& Stats = SelectedMesh.GetBVH().GetStats();
+                    ImGui::SeparatorText("Build Quality");
+                    ImGui::Text("Build Time: %.2f ms", Stats.BuildTimeMs);
+                    ImGui::Text("Last Refit Time: %.2f ms", Stats.RefitTimeMs);
+                    ImGui::Text("SAH Cost: %.3f (%.2fx Build)", Stats.SAHCost, SelectedMesh.GetBVH().GetSAHDegradation());
+                    ImGui::Text("Depth: %u", Stats.Depth);
+                    ImGui::Text("Nodes: %u, Leaves: %u", Stats.NodeCount, Stats.LeafCount);
+                    for(uint LeafSize = 1; LeafSize < Stats.LeafSizeHistogram.size(); ++LeafSize)
+                    {
+                        if(Stats.LeafSizeHistogram[LeafSize] > 0)
+                        {
+                            ImGui::Text("Leaves With %u Primitives: %u", LeafSize, Stats.LeafSizeHistogram[LeafSize]);
+                        }
+                    }
+                }
+
+                ImGui::TreePop();
+                ImGui::Spacing();
+            }
+
+            if(ImGui::TreeNode("Intersections"))
+            {
+                static bool bIsHighlightIntersections = true;
+                static std::optional<size_t> IntersectingPairCount;
+                static float IntersectionTimeMs = 0;
+                ImGui::Checkbox("Highlight Intersecting Faces", &bIsHighlightIntersections);
+                if(AppScene->SelectedEntity != entt::null && ImGui::Button("Find Intersections"))
+                {
+                    const auto StartTime = std::chrono::steady_clock::now();
+                    IntersectingPairCount = AppScene->FindIntersections(AppScene->SelectedEntity, bIsHighlightIntersections);
+                    IntersectionTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+                }
+                if(IntersectingPairCount)
+                {
+                    ImGui::Text("Intersecting Face Pairs: %zu (%.2f ms)", *IntersectingPairCount, IntersectionTimeMs);
+                }
+
+                ImGui::TreePop();
+                ImGui::Spacing();
+            }
+
             if(ImGui::TreeNode("Camera"))
             {
                 ImGui::SeparatorText("Viewport Movement");
@@ -533,6 +735,12 @@ void Application::RenderImGUI()
             {
                 ImGui::Combo("Mesh Element Type", (int*)&AppScene->SelectionMeshElementType, "None\0Face\0Vertex\0Edge\0");
                 ImGui::Text("Selected %s: %s", MeshElementTypeToString(AppScene->SelectionMeshElementType).c_str(), AppScene->SelectedElement.IsValid() ? std::to_string(AppScene->SelectedElement.Idx()).c_str() : "None");
+                ImGui::Checkbox("Select Visible Only", &bIsRegionSelectVisibleOnly);
+                ImGui::TextDisabled("Drag: Marquee Select, Ctrl + Drag: Lasso Select");
+                if(AppScene->SelectedEntity != entt::null)
+                {
+                    ImGui::Text("Region Selected: %d", static_cast<int>(AppScene->GetSelectedMesh().GetHighlightedElements().size()));
+                }
             }
             else if(AppScene->SelectionMode == SelectionMode::Object)
             {
@@ -574,14 +782,30 @@ void Application::RenderImGUI()
         ImGui::Begin("Viewport", nullptr, ViewportWindowFlags);
         {
             auto WindowSize = ImGui::GetWindowSize();
+            const glm::vec2 ViewportScreenPos = ToGlm(ImGui::GetCursorScreenPos());
+            const auto ScreenToNDC = [&](const ImVec2& ScreenPos)
+            {
+                const glm::vec2 Pos = (ToGlm(ScreenPos) - ViewportScreenPos) / ToGlm(WindowSize);
+                return glm::vec2(2 * Pos.x - 1, 1 - 2 * Pos.y);
+            };
+            const bool bCanRegionSelect = AppScene->SelectedEntity != entt::null && AppScene->SelectionMode == SelectionMode::Element
+                && AppScene->SelectionMeshElementType != MeshElementType::None;
 
             if(ImGui::IsWindowHovered())
             {
                 bIsViewportHovered = true;
-                if(Input::IsMouseButtonPressed(AppWindow->GetNativeWindow(), MouseCode::ButtonLeft))
+                if(bCanRegionSelect && !bIsRegionSelecting && ImGui::IsMouseDragging(ImGuiMouseButton_Left))
                 {
-                    const glm::vec2 MousePos = (ToGlm(ImGui::GetMousePos()) - ToGlm(ImGui::GetCursorScreenPos())) / ToGlm(WindowSize);
-                    const glm::vec2 MousePosNDC = glm::vec2(2 * MousePos.x - 1, 1 - 2 * MousePos.y);
+                    bIsRegionSelecting = true;
+                    LassoPoints.clear();
+                    if(ImGui::GetIO().KeyCtrl)
+                    {
+                        LassoPoints.emplace_back(ScreenToNDC(ImGui::GetIO().MouseClickedPos[ImGuiMouseButton_Left]));
+                    }
+                }
+                else if(!bIsRegionSelecting && Input::IsMouseButtonPressed(AppWindow->GetNativeWindow(), MouseCode::ButtonLeft))
+                {
+                    const glm::vec2 MousePosNDC = ScreenToNDC(ImGui::GetMousePos());
                     Ray MouseRay = AppScene->SceneCamera.ClipPosToWorldRay(MousePosNDC);
                     
                     if(AppScene->SelectedEntity != entt::null && AppScene->SelectionMode == SelectionMode::Element
@@ -589,6 +813,12 @@ void Application::RenderImGUI()
                     {
                         const auto PreviousSelectedElement = AppScene->SelectedElement;
                         const auto& SelectedMesh = AppScene->GetSelectedMesh();
+                        if(!SelectedMesh.GetHighlightedElements().empty())
+                        {
+                            // A click replaces the region selection.
+                            AppScene->GetMesh(AppScene->SelectedEntity).SetHighlightedElements({});
+                            AppScene->UpdateSelectionBuffer(AppScene->SelectedEntity, AppScene->SelectedElement);
+                        }
                         
                         if(AppScene->SelectionMeshElementType == MeshElementType::Face)
                         {
@@ -603,17 +833,18 @@ void Application::RenderImGUI()
                             AppScene->SelectedElement = Mesh::ElementIndex{SelectedMesh.FindNearestEdge(MouseRay)};
                         }
 
-                        // if(AppScene->SelectedElement.Idx() != PreviousSelectedElement.Idx())
-                        // {
-                        //     AppScene->UpdateRenderBuffers(AppScene->GetParentEntity(AppScene->GetSelectedEntity()), AppScene->SelectedElement);
-                        // }
+                        if(AppScene->SelectedElement.ElementType != PreviousSelectedElement.ElementType || AppScene->SelectedElement.Idx() != PreviousSelectedElement.Idx())
+                        {
+                            AppScene->UpdateSelectionBuffer(AppScene->SelectedEntity, AppScene->SelectedElement);
+                        }
                     }
                     else if(AppScene->SelectionMode == SelectionMode::Object) // Select Mesh Object
                     {
-                        static std::multimap<float, entt::entity> HoveredEntitiesByDistance;
-                        HoveredEntitiesByDistance.clear();
-
-                        // TODO(WT)
+                        const auto HoveredEntity = AppScene->FindNearestIntersectingEntity(MouseRay);
+                        if(HoveredEntity != entt::null)
+                        {
+                            AppScene->SelectEntity(HoveredEntity);
+                        }
                     }
                 }
             }
@@ -625,6 +856,55 @@ void Application::RenderImGUI()
             // copy framebuffer to the viewport
             uint32_t ColorAttachmentRendererID = AppScene->SceneRenderer->GetFrameBuffer()->GetColorAttachmentRendererID();
             ImGui::Image(ColorAttachmentRendererID, WindowSize, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+
+            // Marquee/lasso overlay, and the region query when the drag ends.
+            if(bIsRegionSelecting)
+            {
+                const ImVec2 DragStart = ImGui::GetIO().MouseClickedPos[ImGuiMouseButton_Left];
+                const ImVec2 DragEnd = ImGui::GetMousePos();
+                const ImU32 OverlayColor = ImGui::GetColorU32(ImVec4(Mesh::HighlightColor.r, Mesh::HighlightColor.g, Mesh::HighlightColor.b, 1.0f));
+                auto* DrawList = ImGui::GetWindowDrawList();
+                if(LassoPoints.empty())
+                {
+                    DrawList->AddRect(ImMin(DragStart, DragEnd), ImMax(DragStart, DragEnd), OverlayColor);
+                }
+                else
+                {
+                    if(glm::distance(LassoPoints.back(), ScreenToNDC(DragEnd)) > 0.005f)
+                    {
+                        LassoPoints.emplace_back(ScreenToNDC(DragEnd));
+                    }
+                    std::vector<ImVec2> LassoScreenPoints;
+                    LassoScreenPoints.reserve(LassoPoints.size());
+                    for(const auto& Point : LassoPoints)
+                    {
+                        const glm::vec2 ScreenPos = ViewportScreenPos + glm::vec2(Point.x + 1, 1 - Point.y) * 0.5f * ToGlm(WindowSize);
+                        LassoScreenPoints.emplace_back(ScreenPos.x, ScreenPos.y);
+                    }
+                    DrawList->AddPolyline(LassoScreenPoints.data(), static_cast<int>(LassoScreenPoints.size()), OverlayColor, ImDrawFlags_Closed, 1.0f);
+                }
+
+                if(!ImGui::IsMouseDown(ImGuiMouseButton_Left))
+                {
+                    bIsRegionSelecting = false;
+                    if(bCanRegionSelect)
+                    {
+                        MeshSelectionRegion Region;
+                        if(LassoPoints.size() >= 3)
+                        {
+                            Region = MeshSelectionRegion::FromLasso(std::move(LassoPoints));
+                        }
+                        else
+                        {
+                            const glm::vec2 StartNDC = ScreenToNDC(DragStart), EndNDC = ScreenToNDC(DragEnd);
+                            Region.Min = glm::min(StartNDC, EndNDC);
+                            Region.Max = glm::max(StartNDC, EndNDC);
+                        }
+                        AppScene->SelectElementsInRegion(std::move(Region), bIsRegionSelectVisibleOnly);
+                    }
+                    LassoPoints.clear();
+                }
+            }
             
             ImGui::End();
         }
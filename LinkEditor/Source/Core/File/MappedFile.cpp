@@ -0,0 +1,64 @@
+﻿#include "MappedFile.h"
+
+#ifndef LINK_EDITOR_PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+#ifdef LINK_EDITOR_PLATFORM_WINDOWS
+
+MappedFile::MappedFile(const fs::path& InFilePath)
+{
+    FileHandle = CreateFileW(InFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(FileHandle == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER FileSize;
+    if(!GetFileSizeEx(FileHandle, &FileSize) || FileSize.QuadPart == 0) return;
+
+    MappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!MappingHandle) return;
+
+    Data = static_cast<const char*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(Data) Size = static_cast<size_t>(FileSize.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if(Data) UnmapViewOfFile(Data);
+    if(MappingHandle) CloseHandle(MappingHandle);
+    if(FileHandle != INVALID_HANDLE_VALUE) CloseHandle(FileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const fs::path& InFilePath)
+{
+    const int FileDescriptor = open(InFilePath.c_str(), O_RDONLY);
+    if(FileDescriptor < 0) return;
+
+    struct stat FileStatus;
+    if(fstat(FileDescriptor, &FileStatus) == 0 && FileStatus.st_size > 0)
+    {
+        void* Mapping = mmap(nullptr, static_cast<size_t>(FileStatus.st_size), PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+        if(Mapping != MAP_FAILED)
+        {
+            Data = static_cast<const char*>(Mapping);
+            Size = static_cast<size_t>(FileStatus.st_size);
+        }
+    }
+    // The mapping stays valid after closing the file.
+    close(FileDescriptor);
+}
+
+MappedFile::~MappedFile()
+{
+    if(Data) munmap(const_cast<char*>(Data), Size);
+}
+
+#endif
+
+LINK_EDITOR_NAMESPACE_END
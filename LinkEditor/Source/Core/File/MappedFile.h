@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Read-only memory mapping of a whole file. Pages are loaded on first access, so large files can be read in parallel without copying
+// them into a buffer first.
+class MappedFile
+{
+public:
+    explicit MappedFile(const fs::path& InFilePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file could not be opened or mapped. Empty files are not mapped.
+    bool IsOpen() const { return Data != nullptr; }
+    const char* GetData() const { return Data; }
+    size_t GetSize() const { return Size; }
+    std::string_view GetText() const { return {Data, Size}; }
+
+private:
+    const char* Data = nullptr;
+    size_t Size = 0;
+#ifdef LINK_EDITOR_PLATFORM_WINDOWS
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+    HANDLE MappingHandle = nullptr;
+#endif
+};
+
+LINK_EDITOR_NAMESPACE_END
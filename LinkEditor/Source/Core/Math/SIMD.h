@@ -0,0 +1,136 @@
+﻿#pragma once
+
+#include "pch.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define LINK_EDITOR_SSE
+#include <immintrin.h>
+#if defined(__AVX__)
+#define LINK_EDITOR_AVX
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Index of the lowest set bit of a non-zero lane mask. Iterate a mask with `for (; Mask != 0; Mask &= Mask - 1)`.
+inline uint FirstSetBit(uint Mask)
+{
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanForward(&Index, Mask);
+    return static_cast<uint>(Index);
+#else
+    return static_cast<uint>(__builtin_ctz(Mask));
+#endif
+}
+
+// Thin wrappers over SSE/AVX float registers, so SIMD kernels can be written once as templates over the lane count.
+// Comparisons return lane masks (all bits set in true lanes), which combine with `&`, `|`, `AndNot` and `Select`.
+#if defined(LINK_EDITOR_SSE)
+struct Float4
+{
+    static constexpr uint Width = 4;
+    __m128 V;
+
+    Float4() = default;
+    Float4(__m128 InV) : V(InV) {}
+    Float4(float Scalar) : V(_mm_set1_ps(Scalar)) {}
+
+    static Float4 Load(const float* Data) { return _mm_loadu_ps(Data); }
+    void Store(float* Data) const { _mm_storeu_ps(Data, V); }
+
+    friend Float4 operator+(Float4 A, Float4 B) { return _mm_add_ps(A.V, B.V); }
+    friend Float4 operator-(Float4 A, Float4 B) { return _mm_sub_ps(A.V, B.V); }
+    friend Float4 operator*(Float4 A, Float4 B) { return _mm_mul_ps(A.V, B.V); }
+    friend Float4 operator/(Float4 A, Float4 B) { return _mm_div_ps(A.V, B.V); }
+    friend Float4 operator<(Float4 A, Float4 B) { return _mm_cmplt_ps(A.V, B.V); }
+    friend Float4 operator<=(Float4 A, Float4 B) { return _mm_cmple_ps(A.V, B.V); }
+    friend Float4 operator>(Float4 A, Float4 B) { return _mm_cmpgt_ps(A.V, B.V); }
+    friend Float4 operator==(Float4 A, Float4 B) { return _mm_cmpeq_ps(A.V, B.V); }
+    friend Float4 operator!=(Float4 A, Float4 B) { return _mm_cmpneq_ps(A.V, B.V); }
+    friend Float4 operator&(Float4 A, Float4 B) { return _mm_and_ps(A.V, B.V); }
+    friend Float4 operator|(Float4 A, Float4 B) { return _mm_or_ps(A.V, B.V); }
+    friend Float4 AndNot(Float4 A, Float4 B) { return _mm_andnot_ps(B.V, A.V); } // `A & ~B`
+    friend Float4 Min(Float4 A, Float4 B) { return _mm_min_ps(A.V, B.V); }
+    friend Float4 Max(Float4 A, Float4 B) { return _mm_max_ps(A.V, B.V); }
+    friend Float4 Select(Float4 Mask, Float4 A, Float4 B) { return _mm_or_ps(_mm_and_ps(Mask.V, A.V), _mm_andnot_ps(Mask.V, B.V)); }
+    friend uint MoveMask(Float4 Mask) { return static_cast<uint>(_mm_movemask_ps(Mask.V)); }
+};
+#else
+struct Float4
+{
+    static constexpr uint Width = 4;
+    std::array<float, 4> V;
+
+    Float4() = default;
+    Float4(float Scalar) { V.fill(Scalar); }
+
+    static Float4 Load(const float* Data) { Float4 R; std::copy(Data, Data + 4, R.V.begin()); return R; }
+    void Store(float* Data) const { std::copy(V.begin(), V.end(), Data); }
+
+    template<typename Op>
+    static Float4 Map(Float4 A, Float4 B, Op InOp) { Float4 R; for (uint i = 0; i < 4; ++i) R.V[i] = InOp(A.V[i], B.V[i]); return R; }
+    static float MaskOf(bool Value) { uint32_t Bits = Value ? ~0u : 0u; float R; std::memcpy(&R, &Bits, 4); return R; }
+    static uint32_t BitsOf(float Value) { uint32_t Bits; std::memcpy(&Bits, &Value, 4); return Bits; }
+    static float FloatOf(uint32_t Bits) { float R; std::memcpy(&R, &Bits, 4); return R; }
+
+    friend Float4 operator+(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return X + Y; }); }
+    friend Float4 operator-(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return X - Y; }); }
+    friend Float4 operator*(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return X * Y; }); }
+    friend Float4 operator/(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return X / Y; }); }
+    friend Float4 operator<(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return MaskOf(X < Y); }); }
+    friend Float4 operator<=(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return MaskOf(X <= Y); }); }
+    friend Float4 operator>(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return MaskOf(X > Y); }); }
+    friend Float4 operator==(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return MaskOf(X == Y); }); }
+    friend Float4 operator!=(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return MaskOf(X != Y); }); }
+    friend Float4 operator&(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return FloatOf(BitsOf(X) & BitsOf(Y)); }); }
+    friend Float4 operator|(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return FloatOf(BitsOf(X) | BitsOf(Y)); }); }
+    friend Float4 AndNot(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return FloatOf(BitsOf(X) & ~BitsOf(Y)); }); }
+    friend Float4 Min(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return Y < X ? Y : X; }); }
+    friend Float4 Max(Float4 A, Float4 B) { return Map(A, B, [](float X, float Y) { return Y > X ? Y : X; }); }
+    friend Float4 Select(Float4 Mask, Float4 A, Float4 B) { return (Mask & A) | AndNot(B, Mask); }
+    friend uint MoveMask(Float4 Mask) { uint R = 0; for (uint i = 0; i < 4; ++i) R |= (BitsOf(Mask.V[i]) >> 31) << i; return R; }
+};
+#endif
+
+#if defined(LINK_EDITOR_AVX)
+struct Float8
+{
+    static constexpr uint Width = 8;
+    __m256 V;
+
+    Float8() = default;
+    Float8(__m256 InV) : V(InV) {}
+    Float8(float Scalar) : V(_mm256_set1_ps(Scalar)) {}
+
+    static Float8 Load(const float* Data) { return _mm256_loadu_ps(Data); }
+    void Store(float* Data) const { _mm256_storeu_ps(Data, V); }
+
+    friend Float8 operator+(Float8 A, Float8 B) { return _mm256_add_ps(A.V, B.V); }
+    friend Float8 operator-(Float8 A, Float8 B) { return _mm256_sub_ps(A.V, B.V); }
+    friend Float8 operator*(Float8 A, Float8 B) { return _mm256_mul_ps(A.V, B.V); }
+    friend Float8 operator/(Float8 A, Float8 B) { return _mm256_div_ps(A.V, B.V); }
+    friend Float8 operator<(Float8 A, Float8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ); }
+    friend Float8 operator<=(Float8 A, Float8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_LE_OQ); }
+    friend Float8 operator>(Float8 A, Float8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ); }
+    friend Float8 operator==(Float8 A, Float8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_EQ_OQ); }
+    friend Float8 operator!=(Float8 A, Float8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_NEQ_UQ); }
+    friend Float8 operator&(Float8 A, Float8 B) { return _mm256_and_ps(A.V, B.V); }
+    friend Float8 operator|(Float8 A, Float8 B) { return _mm256_or_ps(A.V, B.V); }
+    friend Float8 AndNot(Float8 A, Float8 B) { return _mm256_andnot_ps(B.V, A.V); } // `A & ~B`
+    friend Float8 Min(Float8 A, Float8 B) { return _mm256_min_ps(A.V, B.V); }
+    friend Float8 Max(Float8 A, Float8 B) { return _mm256_max_ps(A.V, B.V); }
+    friend Float8 Select(Float8 Mask, Float8 A, Float8 B) { return _mm256_blendv_ps(B.V, A.V, Mask.V); }
+    friend uint MoveMask(Float8 Mask) { return static_cast<uint>(_mm256_movemask_ps(Mask.V)); }
+};
+// Widest float register available in this build.
+using FloatV = Float8;
+#else
+using FloatV = Float4;
+#endif
+
+LINK_EDITOR_NAMESPACE_END
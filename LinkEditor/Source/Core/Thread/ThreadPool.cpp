@@ -0,0 +1,170 @@
+﻿#include "ThreadPool.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+ThreadPool::ThreadPool(uint ThreadCount, uint BackgroundThreadCount)
+{
+    Workers.reserve(ThreadCount);
+    for (uint i = 0; i < ThreadCount; ++i)
+    {
+        Workers.emplace_back([this] { WorkerLoop(); });
+    }
+    BackgroundWorkers.reserve(BackgroundThreadCount);
+    for (uint i = 0; i < BackgroundThreadCount; ++i)
+    {
+        BackgroundWorkers.emplace_back([this] { BackgroundWorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    // Background jobs may still wait on tasks, so they finish before the workers stop.
+    {
+        std::lock_guard<std::mutex> Lock(BackgroundJobsMutex);
+        bIsBackgroundStopping = true;
+    }
+    BackgroundJobsCondition.notify_all();
+    for (auto& Worker : BackgroundWorkers)
+    {
+        Worker.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(TasksMutex);
+        bIsStopping = true;
+    }
+    TasksCondition.notify_all();
+    for (auto& Worker : Workers)
+    {
+        Worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    // The calling thread also executes tasks while waiting, so leave one hardware thread for it. The count may be 0 if unknown.
+    static ThreadPool Pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return Pool;
+}
+
+void ThreadPool::Enqueue(std::function<void()> Task)
+{
+    {
+        std::lock_guard<std::mutex> Lock(TasksMutex);
+        Tasks.emplace_back(std::move(Task));
+    }
+    TasksCondition.notify_one();
+}
+
+void ThreadPool::EnqueueBackground(std::function<void()> Job)
+{
+    {
+        std::lock_guard<std::mutex> Lock(BackgroundJobsMutex);
+        BackgroundJobs.emplace_back(std::move(Job));
+    }
+    BackgroundJobsCondition.notify_one();
+}
+
+bool ThreadPool::TryRunPendingTask()
+{
+    std::function<void()> Task;
+    {
+        std::lock_guard<std::mutex> Lock(TasksMutex);
+        if (Tasks.empty())
+        {
+            return false;
+        }
+        Task = std::move(Tasks.front());
+        Tasks.pop_front();
+    }
+    Task();
+    return true;
+}
+
+void ThreadPool::ParallelFor(size_t Begin, size_t End, size_t GrainSize, const std::function<void(size_t, size_t)>& Body)
+{
+    if (End <= Begin)
+    {
+        return;
+    }
+
+    // Over-split a bit relative to the thread count to balance uneven chunks.
+    const size_t Count = End - Begin;
+    const size_t MaxChunkCount = (GetThreadCount() + 1) * 4;
+    const size_t ChunkCount = std::max<size_t>(1, std::min(MaxChunkCount, Count / std::max<size_t>(1, GrainSize)));
+    if (ChunkCount == 1)
+    {
+        Body(Begin, End);
+        return;
+    }
+
+    const size_t ChunkSize = (Count + ChunkCount - 1) / ChunkCount;
+    TaskGroup Group(*this);
+    for (size_t ChunkBegin = Begin + ChunkSize; ChunkBegin < End; ChunkBegin += ChunkSize)
+    {
+        Group.Run([&Body, ChunkBegin, ChunkEnd = std::min(End, ChunkBegin + ChunkSize)] { Body(ChunkBegin, ChunkEnd); });
+    }
+    Body(Begin, std::min(End, Begin + ChunkSize));
+    Group.Wait();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> Task;
+        {
+            std::unique_lock<std::mutex> Lock(TasksMutex);
+            TasksCondition.wait(Lock, [this] { return bIsStopping || !Tasks.empty(); });
+            if (bIsStopping && Tasks.empty())
+            {
+                return;
+            }
+            Task = std::move(Tasks.front());
+            Tasks.pop_front();
+        }
+        Task();
+    }
+}
+
+void ThreadPool::BackgroundWorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> Job;
+        {
+            std::unique_lock<std::mutex> Lock(BackgroundJobsMutex);
+            BackgroundJobsCondition.wait(Lock, [this] { return bIsBackgroundStopping || !BackgroundJobs.empty(); });
+            if (bIsBackgroundStopping && BackgroundJobs.empty())
+            {
+                return;
+            }
+            Job = std::move(BackgroundJobs.front());
+            BackgroundJobs.pop_front();
+        }
+        Job();
+    }
+}
+
+void TaskGroup::Run(std::function<void()> Task)
+{
+    ++PendingCount;
+    Pool.Enqueue([this, Task = std::move(Task)]
+    {
+        Task();
+        --PendingCount;
+    });
+}
+
+void TaskGroup::Wait()
+{
+    while (PendingCount > 0)
+    {
+        if (!Pool.TryRunPendingTask())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+LINK_EDITOR_NAMESPACE_END
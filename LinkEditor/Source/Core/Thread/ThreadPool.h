@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Fixed-size pool of worker threads consuming a shared task queue.
+// Threads waiting on a `TaskGroup` help execute queued tasks, so task groups can be nested without deadlocking.
+// Long background jobs (e.g. imports and exports) have their own queue and threads, so that a thread waiting on a `TaskGroup`
+// (e.g. the UI thread in a `ParallelFor`) never picks up a whole job.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint ThreadCount, uint BackgroundThreadCount = 2);
+    ~ThreadPool();
+
+    static ThreadPool& Get();
+
+    uint GetThreadCount() const { return static_cast<uint>(Workers.size()); }
+
+    // Fire-and-forget task, run by the workers and by threads waiting on a `TaskGroup`. Should be short.
+    void Enqueue(std::function<void()> Task);
+    // Fire-and-forget job that may run for long, run by the background threads only. Jobs may use `ParallelFor` and `TaskGroup`.
+    void EnqueueBackground(std::function<void()> Job);
+
+    // Runs one queued task on the calling thread, if any. Returns false if the queue was empty.
+    bool TryRunPendingTask();
+
+    // Splits `[Begin, End)` into chunks of at least `GrainSize` elements and calls `Body(ChunkBegin, ChunkEnd)` for each in parallel.
+    // Blocks until all chunks are done. The calling thread processes chunks too.
+    void ParallelFor(size_t Begin, size_t End, size_t GrainSize, const std::function<void(size_t, size_t)>& Body);
+
+private:
+    void WorkerLoop();
+    void BackgroundWorkerLoop();
+
+    std::vector<std::thread> Workers;
+    std::deque<std::function<void()>> Tasks;
+    std::mutex TasksMutex;
+    std::condition_variable TasksCondition;
+    bool bIsStopping = false;
+
+    std::vector<std::thread> BackgroundWorkers;
+    std::deque<std::function<void()>> BackgroundJobs;
+    std::mutex BackgroundJobsMutex;
+    std::condition_variable BackgroundJobsCondition;
+    bool bIsBackgroundStopping = false;
+};
+
+// Fork-join group of tasks on a `ThreadPool`.
+class TaskGroup
+{
+public:
+    TaskGroup(ThreadPool& InPool = ThreadPool::Get()) : Pool(InPool) {}
+    ~TaskGroup() { Wait(); }
+
+    void Run(std::function<void()> Task);
+    void Wait();
+
+private:
+    ThreadPool& Pool;
+    std::atomic<uint> PendingCount = 0;
+};
+
+LINK_EDITOR_NAMESPACE_END
@@ -1,35 +1,147 @@
 ﻿#include "MeshSegementation.h"
+#include "Core/File/MappedFile.h"
+#include "Core/Thread/ThreadPool.h"
+
+#include <charconv>
+#include <cstring>
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
 MeshSegmentationInfo MeshSegmentationManager::CurrentSegmentationInfo;
 
-Eigen::VectorXi MeshSegmentationManager::LoadSegLabels(const std::string& InSegFilePath)
+static constexpr size_t SegTextChunkSize = 1 << 20; // Bytes of text per parsing task.
+static constexpr size_t SegLabelsPerWriteChunk = 1 << 18;
+static constexpr size_t MaxLabelChars = 11;
+static constexpr std::array<char, 8> BinarySegMagic{'L', 'K', 'S', 'E', 'G', '\0', '\0', '\0'};
+static constexpr uint BinarySegVersion = 1;
+
+// Header of `.lkseg` files, followed by `RunCount` runs of equal labels in face order.
+struct BinarySegHeader
+{
+    std::array<char, 8> Magic = BinarySegMagic;
+    uint Version = BinarySegVersion;
+    uint RunCount = 0;
+    uint64_t LabelCount = 0;
+};
+
+struct BinarySegRun
+{
+    int Label;
+    uint Length;
+};
+
+static bool IsSpace(char C) { return C == ' ' || C == '\n' || C == '\r' || C == '\t'; }
+
+// Start of the first token at or after `P`, so that parallel chunks never split a label.
+static const char* AlignToToken(const char* Begin, const char* P, const char* End)
 {
-    if (!std::ifstream(InSegFilePath).good())
+    while (P > Begin && P < End && !IsSpace(P[-1])) ++P;
+    return P;
+}
+
+template<typename TokenVisitor>
+static bool ForEachToken(const char* P, const char* End, const TokenVisitor& Visit)
+{
+    while (true)
     {
-        LOG_ERROR("File not found: {0}", InSegFilePath);
+        while (P < End && IsSpace(*P)) ++P;
+        if (P == End) return true;
+
+        const char* TokenEnd = P;
+        while (TokenEnd < End && !IsSpace(*TokenEnd)) ++TokenEnd;
+        if (!Visit(P, TokenEnd)) return false;
+        P = TokenEnd;
     }
-    
-    std::ifstream File(InSegFilePath);
-    if (!File.is_open())
+}
+
+// Counts the labels of each chunk in parallel, and then parses them straight into `OutLabels`.
+static bool ParseTextSegLabels(std::string_view Text, Eigen::VectorXi& OutLabels)
+{
+    const char* const Begin = Text.data();
+    const char* const End = Begin + Text.size();
+    const size_t ChunkCount = (Text.size() + SegTextChunkSize - 1) / SegTextChunkSize;
+    std::vector<const char*> ChunkBegins(ChunkCount + 1, End);
+    for (size_t Chunk = 0; Chunk < ChunkCount; ++Chunk) ChunkBegins[Chunk] = AlignToToken(Begin, Begin + Chunk * SegTextChunkSize, End);
+
+    std::vector<size_t> ChunkOffsets(ChunkCount + 1, 0);
+    ThreadPool::Get().ParallelFor(0, ChunkCount, 1, [&](size_t ChunkBegin, size_t ChunkEnd)
     {
-        LOG_ERROR("Failed to open file: {0}", InSegFilePath);
-    }
+        for (size_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            ForEachToken(ChunkBegins[Chunk], ChunkBegins[Chunk + 1], [&](const char*, const char*)
+            {
+                ++ChunkOffsets[Chunk + 1];
+                return true;
+            });
+        }
+    });
+    std::partial_sum(ChunkOffsets.begin(), ChunkOffsets.end(), ChunkOffsets.begin());
 
-    std::vector<int> Labels;
-    int Label;
-    while (File >> Label)
+    OutLabels.resize(Eigen::Index(ChunkOffsets.back()));
+    std::atomic<bool> bIsValid = true;
+    ThreadPool::Get().ParallelFor(0, ChunkCount, 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for (size_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            int* Label = OutLabels.data() + ChunkOffsets[Chunk];
+            const bool bIsChunkValid = ForEachToken(ChunkBegins[Chunk], ChunkBegins[Chunk + 1], [&](const char* TokenBegin, const char* TokenEnd)
+            {
+                const char* NumberBegin = TokenBegin + (*TokenBegin == '+' ? 1 : 0);
+                const auto [NumberEnd, Error] = std::from_chars(NumberBegin, TokenEnd, *Label++);
+                return Error == std::errc() && NumberEnd == TokenEnd;
+            });
+            if (!bIsChunkValid) bIsValid = false;
+        }
+    });
+    return bIsValid;
+}
+
+static bool ParseBinarySegLabels(std::string_view Data, Eigen::VectorXi& OutLabels)
+{
+    BinarySegHeader Header;
+    if (Data.size() < sizeof(Header)) return false;
+    std::memcpy(&Header, Data.data(), sizeof(Header));
+    if (Header.Version != BinarySegVersion || Data.size() != sizeof(Header) + size_t(Header.RunCount) * sizeof(BinarySegRun)) return false;
+
+    std::vector<BinarySegRun> Runs(Header.RunCount);
+    std::memcpy(Runs.data(), Data.data() + sizeof(Header), Runs.size() * sizeof(BinarySegRun));
+    uint64_t LabelCount = 0;
+    for (const auto& Run : Runs) LabelCount += Run.Length;
+    if (LabelCount != Header.LabelCount || LabelCount > MeshSegmentationManager::MaxSegLabelCount) return false;
+
+    OutLabels.resize(Eigen::Index(LabelCount));
+    int* Label = OutLabels.data();
+    for (const auto& Run : Runs) Label = std::fill_n(Label, Run.Length, Run.Label);
+    return true;
+}
+
+static bool IsBinarySegFile(const std::string& InFilePath) { return fs::path(InFilePath).extension() == ".lkseg"; }
+
+Eigen::VectorXi MeshSegmentationManager::LoadSegLabels(const std::string& InSegFilePath)
+{
+    Eigen::VectorXi SegLabels;
+    const MappedFile File(InSegFilePath);
+    if (!File.IsOpen())
     {
-        Labels.push_back(Label);
+        std::error_code Error;
+        if (!fs::exists(InSegFilePath, Error))
+        {
+            LOG_ERROR("File not found: {0}", InSegFilePath);
+        }
+        else if (fs::file_size(InSegFilePath, Error) != 0)
+        {
+            LOG_ERROR("Failed to open file: {0}", InSegFilePath);
+        }
     }
-    
-    File.close();
-    
-    Eigen::VectorXi SegLabels(Labels.size());
-    for (size_t i = 0; i < Labels.size(); ++i)
+    else
     {
-        SegLabels[i] = Labels[i];
+        const std::string_view Data = File.GetText();
+        const bool bIsBinary = Data.size() >= BinarySegMagic.size() && std::equal(BinarySegMagic.begin(), BinarySegMagic.end(), Data.begin());
+        if (!(bIsBinary ? ParseBinarySegLabels(Data, SegLabels) : ParseTextSegLabels(Data, SegLabels)))
+        {
+            LOG_ERROR("Invalid segmentation labels: {0}", InSegFilePath);
+            SegLabels.resize(0);
+        }
     }
 
     CurrentSegmentationInfo.SegLabelsFilePath = InSegFilePath;
@@ -40,18 +152,54 @@ Eigen::VectorXi MeshSegmentationManager::LoadSegLabels(const std::string& InSegF
 
 void MeshSegmentationManager::SaveSegLabels(const Eigen::VectorXi& SegLabels, const std::string& InFilePath)
 {
-    std::ofstream File(InFilePath);
+    std::ofstream File(InFilePath, std::ios::binary | std::ios::trunc);
     if (!File.is_open())
     {
         LOG_ERROR("Failed to open file: {0}", InFilePath);
+        return;
     }
 
-    for (int i = 0; i < SegLabels.size(); ++i)
+    if (IsBinarySegFile(InFilePath))
     {
-        File << SegLabels(i) << "\n";
+        // Labels are piecewise constant over the face order, so runs are far fewer than labels.
+        std::vector<BinarySegRun> Runs;
+        for (Eigen::Index i = 0; i < SegLabels.size(); ++i)
+        {
+            if (Runs.empty() || Runs.back().Label != SegLabels[i] || Runs.back().Length == std::numeric_limits<uint>::max())
+            {
+                Runs.push_back({SegLabels[i], 0});
+            }
+            ++Runs.back().Length;
+        }
+
+        BinarySegHeader Header;
+        Header.RunCount = static_cast<uint>(Runs.size());
+        Header.LabelCount = static_cast<uint64_t>(SegLabels.size());
+        File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        File.write(reinterpret_cast<const char*>(Runs.data()), static_cast<std::streamsize>(Runs.size() * sizeof(BinarySegRun)));
+        return;
     }
 
-    File.close();
+    // One label per line, formatted in parallel chunks.
+    const size_t LabelCount = static_cast<size_t>(SegLabels.size());
+    std::vector<std::string> Chunks((LabelCount + SegLabelsPerWriteChunk - 1) / SegLabelsPerWriteChunk);
+    ThreadPool::Get().ParallelFor(0, Chunks.size(), 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for (size_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            const size_t Begin = Chunk * SegLabelsPerWriteChunk, End = std::min(LabelCount, Begin + SegLabelsPerWriteChunk);
+            std::string& Text = Chunks[Chunk];
+            Text.resize((End - Begin) * (MaxLabelChars + 1));
+            char* P = Text.data();
+            for (size_t i = Begin; i < End; ++i)
+            {
+                P = std::to_chars(P, P + MaxLabelChars, SegLabels[Eigen::Index(i)]).ptr;
+                *P++ = '\n';
+            }
+            Text.resize(P - Text.data());
+        }
+    });
+    for (const auto& Text : Chunks) File.write(Text.data(), static_cast<std::streamsize>(Text.size()));
 }
 
 LINK_EDITOR_NAMESPACE_END
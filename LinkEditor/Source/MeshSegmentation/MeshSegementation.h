@@ -15,8 +15,14 @@ struct MeshSegmentationInfo
 class MeshSegmentationManager
 {
 public:
+    // Reads whitespace-separated labels (`.seg`), or run-length encoded binary labels (`.lkseg`). Text files are memory-mapped and parsed
+    // in parallel chunks directly into the returned vector. Returns no labels for missing or invalid files.
     static Eigen::VectorXi LoadSegLabels(const std::string& InSegFilePath);
+    // Writes one label per line, or binary runs of equal labels if the extension is `.lkseg`.
     static void SaveSegLabels(const Eigen::VectorXi& SegLabels, const std::string& InFilePath);
+
+    // Binary files with more labels are invalid, since their runs could otherwise ask for any amount of memory.
+    inline static constexpr uint64_t MaxSegLabelCount = uint64_t(1) << 28; // 1 GiB of labels.
     
     static MeshSegmentationInfo CurrentSegmentationInfo;
 };
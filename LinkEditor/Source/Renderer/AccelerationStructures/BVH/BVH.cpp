@@ -1,38 +1,311 @@
 ﻿#include "BVH.h"
+#include "Core/Thread/ThreadPool.h"
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
-BVH::BVH(std::vector<BoundingBox>& leaf_boxes) : LeafBoxes(leaf_boxes) {
-    std::vector<uint> indices(LeafBoxes.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    Build(indices);
+BVH::BVH(std::vector<BoundingBox> leaf_boxes, BVHBuildOptions options) : Options(options), LeafBoxes(std::move(leaf_boxes)) {
+    if (LeafBoxes.empty()) return;
+
+    Options.MaxLeafSize = std::clamp(Options.MaxLeafSize, 1u, MaxLeafSizeLimit);
+    Options.BinCount = std::clamp(Options.BinCount, 2u, MaxBinCount);
+
+    const auto start_time = std::chrono::high_resolution_clock::now();
+
+    Centers.resize(LeafBoxes.size());
+    PrimitiveIndices.resize(LeafBoxes.size());
+    ParallelFor(0, LeafBoxes.size(), [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Centers[i] = LeafBoxes[i].Center();
+            PrimitiveIndices[i] = i;
+        }
+    });
+    Nodes.reserve(2 * LeafBoxes.size() - 1);
+    Build(0, PrimitiveIndices.size(), 0, Nodes);
+    Nodes.shrink_to_fit();
+    Centers = {};
+
+    const float build_time_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    Stats = ComputeStats();
+    Stats.BuildTimeMs = build_time_ms;
+    BuildSAHCost = Stats.SAHCost;
+}
+
+BVH::BVH(std::vector<Node> nodes, std::vector<uint> primitive_indices, BVHBuildOptions options, float build_sah_cost)
+    : Options(options), PrimitiveIndices(std::move(primitive_indices)), Nodes(std::move(nodes)), BuildSAHCost(build_sah_cost) {
+    Stats = ComputeStats();
+}
+
+void BVH::Refit(std::vector<BoundingBox> leaf_boxes) {
+    LINK_EDITOR_CORE_ASSERT(leaf_boxes.size() == PrimitiveIndices.size(), "A refit can't change the number of primitives");
+    LeafBoxes = std::move(leaf_boxes);
+    if (Nodes.empty()) return;
+
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    RefitNode(0);
+    const float refit_time_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    const float build_time_ms = Stats.BuildTimeMs;
+    Stats = ComputeStats();
+    Stats.BuildTimeMs = build_time_ms;
+    Stats.RefitTimeMs = refit_time_ms;
+}
+
+// Children always follow their parent in `Nodes`, and the left subtree occupies `[node_index + 1, right)`,
+// so the two subtrees of large nodes can be refitted in parallel without synchronization.
+BoundingBox BVH::RefitNode(uint node_index) {
+    auto &node = Nodes[node_index];
+    BoundingBox box;
+    if (node.IsLeaf()) {
+        for (uint i = node.Offset; i < node.Offset + node.Count; ++i) box = box.Union(LeafBoxes[PrimitiveIndices[i]]);
+    } else {
+        const uint left = node_index + 1, right = node.Offset;
+        BoundingBox left_box, right_box;
+        if (Options.Parallel && right - left >= ParallelRefitThreshold) {
+            TaskGroup group;
+            group.Run([&] { left_box = RefitNode(left); });
+            right_box = RefitNode(right);
+            group.Wait();
+        } else {
+            left_box = RefitNode(left);
+            right_box = RefitNode(right);
+        }
+        box = left_box.Union(right_box);
+    }
+    node.Min = box.Min;
+    node.Max = box.Max;
+    return box;
+}
+
+void BVH::ParallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body) const {
+    if (Options.Parallel) ThreadPool::Get().ParallelFor(begin, end, ParallelGrainSize, body);
+    else body(begin, end);
+}
+
+std::vector<BVH::NodePair> BVH::SplitOverlapTraversal(const BVH &other, const glm::mat4 *other_to_this, uint min_count) const {
+    std::vector<NodePair> pairs;
+    if (Nodes.empty() || other.Nodes.empty()) return pairs;
+
+    pairs.push_back({0, 0});
+    std::array<NodePair, 3> children;
+    bool expanded = true;
+    while (expanded && pairs.size() < min_count) {
+        // Expand a whole level at a time, so that the pairs cover subtrees of similar size.
+        std::vector<NodePair> next_pairs;
+        expanded = false;
+        for (const NodePair &pair : pairs) {
+            if (!IsSelfPair(other, pair) && !NodesOverlap(other, other_to_this, pair)) continue;
+
+            if (const uint child_count = SplitPair(other, pair, children); child_count > 0) {
+                next_pairs.insert(next_pairs.end(), children.begin(), children.begin() + child_count);
+                expanded = true;
+            } else {
+                next_pairs.push_back(pair);
+            }
+        }
+        pairs = std::move(next_pairs);
+    }
+    return pairs;
 }
 
-uint BVH::Build(std::vector<uint>& indices) {
-    if (indices.size() == 1) {
-        Nodes.emplace_back(indices.front());
-        return Nodes.size() - 1;
+// Builds the subtree over `PrimitiveIndices[begin, end)` in place, appending its nodes to `nodes` in depth-first order.
+// Returns the index of the subtree root in `nodes`.
+// Large subtrees are built as parallel tasks into separate node arrays, which are then spliced in depth-first order,
+// so the result is identical to the serial build.
+uint BVH::Build(uint begin, uint end, uint depth, std::vector<Node> &nodes) {
+    const uint node_index = nodes.size();
+    nodes.emplace_back();
+
+    BoundingBox box, center_box;
+    ComputeBounds(begin, end, box, center_box);
+    const uint mid = end - begin == 1 || depth + 1 >= MaxDepth ? end :
+        Options.Builder == BVHBuilder::SAH ? SplitSAH(begin, end, box, center_box) : SplitMedian(begin, end, box);
+    if (mid == end) {
+        nodes[node_index] = {box.Min, begin, box.Max, end - begin};
+        return node_index;
+    }
+
+    if (!Options.Parallel || end - begin < ParallelBuildThreshold) {
+        // The first child directly follows its parent. `nodes` may reallocate during recursion, so assign by index.
+        Build(begin, mid, depth + 1, nodes);
+        const uint right = Build(mid, end, depth + 1, nodes);
+        nodes[node_index] = {box.Min, right, box.Max, 0};
+        return node_index;
     }
 
-    // Partially sort the indices array around the median element,
+    std::vector<Node> left_nodes, right_nodes;
+    {
+        TaskGroup group;
+        group.Run([&] { Build(begin, mid, depth + 1, left_nodes); });
+        Build(mid, end, depth + 1, right_nodes);
+        group.Wait();
+    }
+
+    const auto splice = [&nodes](const std::vector<Node> &subtree_nodes) {
+        const uint base = nodes.size();
+        for (Node node : subtree_nodes) {
+            if (node.IsInternal()) node.Offset += base;
+            nodes.push_back(node);
+        }
+    };
+    splice(left_nodes);
+    const uint right = nodes.size();
+    splice(right_nodes);
+    nodes[node_index] = {box.Min, right, box.Max, 0};
+
+    return node_index;
+}
+
+// Computes the union of the leaf boxes and the bounds of their centers.
+void BVH::ComputeBounds(uint begin, uint end, BoundingBox &box_out, BoundingBox &center_box_out) const {
+    std::mutex mutex;
+    box_out = center_box_out = {};
+    const auto reduce = [&](size_t chunk_begin, size_t chunk_end) {
+        BoundingBox box, center_box;
+        for (size_t i = chunk_begin; i < chunk_end; ++i) {
+            const uint primitive = PrimitiveIndices[i];
+            box = box.Union(LeafBoxes[primitive]);
+            center_box = center_box.Union({Centers[primitive], Centers[primitive]});
+        }
+        // Unions are exact, so merging chunks in any order gives the same result.
+        std::lock_guard<std::mutex> lock(mutex);
+        box_out = box_out.Union(box);
+        center_box_out = center_box_out.Union(center_box);
+    };
+    if (end - begin >= ParallelBuildThreshold) ParallelFor(begin, end, reduce);
+    else reduce(begin, end);
+}
+
+uint BVH::SplitMedian(uint begin, uint end, const BoundingBox &box) {
+    if (end - begin <= Options.MaxLeafSize) return end;
+
+    // Partially sort the indices range around the median element,
     // based on the box centers along the longest axis of the encompassing box.
-    BoundingBox box = std::accumulate(indices.begin(), indices.end(), BoundingBox{}, [&](const BoundingBox &acc, uint i) {
-        return acc.Union(LeafBoxes[i]);
-    });
     const auto split_axis = box.MaxAxis();
-    const uint mid = indices.size() / 2;
-    std::nth_element(indices.begin(), indices.begin() + mid, indices.end(), [this, split_axis](auto a, auto b) {
-        return LeafBoxes[a].Center()[split_axis] < LeafBoxes[b].Center()[split_axis];
+    const uint mid = begin + (end - begin) / 2;
+    std::nth_element(PrimitiveIndices.begin() + begin, PrimitiveIndices.begin() + mid, PrimitiveIndices.begin() + end, [this, split_axis](auto a, auto b) {
+        return Centers[a][split_axis] < Centers[b][split_axis];
     });
+    return mid;
+}
+
+namespace {
+struct Bin {
+    BoundingBox Box;
+    uint Count = 0;
+};
+using AxisBins = std::array<std::array<Bin, BVH::MaxBinCount>, 3>;
+
+uint BinIndex(float center, float min, float scale, uint bin_count) {
+    return std::min(bin_count - 1, uint((center - min) * scale));
+}
+} // namespace
+
+uint BVH::SplitSAH(uint begin, uint end, const BoundingBox &box, const BoundingBox &center_box) {
+    const uint count = end - begin;
+    const uint bin_count = Options.BinCount;
+    glm::vec3 scale;
+    for (uint axis = 0; axis < 3; ++axis) {
+        const float extent = center_box.Max[axis] - center_box.Min[axis];
+        scale[axis] = extent > 0 ? bin_count / extent : 0;
+    }
+
+    // Bin the box centers along each axis.
+    AxisBins bins;
+    std::mutex mutex;
+    const auto bin_primitives = [&](size_t chunk_begin, size_t chunk_end) {
+        AxisBins chunk_bins;
+        for (size_t i = chunk_begin; i < chunk_end; ++i) {
+            const uint primitive = PrimitiveIndices[i];
+            for (uint axis = 0; axis < 3; ++axis) {
+                auto &bin = chunk_bins[axis][BinIndex(Centers[primitive][axis], center_box.Min[axis], scale[axis], bin_count)];
+                bin.Box = bin.Box.Union(LeafBoxes[primitive]);
+                ++bin.Count;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint axis = 0; axis < 3; ++axis) {
+            for (uint b = 0; b < bin_count; ++b) {
+                bins[axis][b].Box = bins[axis][b].Box.Union(chunk_bins[axis][b].Box);
+                bins[axis][b].Count += chunk_bins[axis][b].Count;
+            }
+        }
+    };
+    if (count >= ParallelBuildThreshold) ParallelFor(begin, end, bin_primitives);
+    else bin_primitives(begin, end);
 
-    // Add an internal parent node encompassing both children.
-    Nodes.emplace_back(
-        Build(std::vector<uint>{indices.begin(), indices.begin() + mid}),
-        Build(std::vector<uint>{indices.begin() + mid, indices.end()}),
-        std::move(box)
-    );
+    // Evaluate the cost of splitting between each pair of adjacent bins.
+    float best_cost = std::numeric_limits<float>::max();
+    uint best_axis = 0, best_bin = 0;
+    for (uint axis = 0; axis < 3; ++axis) {
+        if (scale[axis] == 0) continue;
 
-    return Nodes.size() - 1;
+        // Sweep from the right to accumulate the right-side areas, then from the left to evaluate each split.
+        std::array<float, MaxBinCount> right_areas;
+        BoundingBox right_box;
+        for (uint bin = bin_count - 1; bin > 0; --bin) {
+            right_box = right_box.Union(bins[axis][bin].Box);
+            right_areas[bin] = right_box.SurfaceArea();
+        }
+        BoundingBox left_box;
+        uint left_count = 0;
+        for (uint bin = 0; bin < bin_count - 1; ++bin) {
+            left_box = left_box.Union(bins[axis][bin].Box);
+            left_count += bins[axis][bin].Count;
+            const uint right_count = count - left_count;
+            if (left_count == 0 || right_count == 0) continue;
+
+            const float cost = left_box.SurfaceArea() * left_count + right_areas[bin + 1] * right_count;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = bin;
+            }
+        }
+    }
+
+    if (best_cost == std::numeric_limits<float>::max()) {
+        // All centers coincide, so any split is as good as another.
+        return count <= Options.MaxLeafSize ? end : begin + count / 2;
+    }
+
+    const float split_cost = TraversalCost + IntersectionCost * best_cost / box.SurfaceArea();
+    const float leaf_cost = IntersectionCost * count;
+    if (count <= Options.MaxLeafSize && split_cost >= leaf_cost) return end;
+
+    const float min = center_box.Min[best_axis], axis_scale = scale[best_axis];
+    const auto mid = std::partition(PrimitiveIndices.begin() + begin, PrimitiveIndices.begin() + end, [&](uint primitive) {
+        return BinIndex(Centers[primitive][best_axis], min, axis_scale, bin_count) <= best_bin;
+    });
+    return mid - PrimitiveIndices.begin();
+}
+
+BVHStats BVH::ComputeStats() const {
+    BVHStats stats;
+    if (Nodes.empty()) return stats;
+
+    const float root_area = Nodes[0].Box().SurfaceArea();
+    std::vector<std::pair<uint, uint>> stack{{0, 1}}; // Node index and depth.
+    while (!stack.empty()) {
+        const auto [node_index, depth] = stack.back();
+        stack.pop_back();
+
+        const auto &node = Nodes[node_index];
+        const float area_ratio = root_area > 0 ? node.Box().SurfaceArea() / root_area : 1;
+        ++stats.NodeCount;
+        stats.Depth = std::max(stats.Depth, depth);
+        if (node.IsLeaf()) {
+            ++stats.LeafCount;
+            stats.SAHCost += IntersectionCost * node.Count * area_ratio;
+            if (stats.LeafSizeHistogram.size() <= node.Count) stats.LeafSizeHistogram.resize(node.Count + 1);
+            ++stats.LeafSizeHistogram[node.Count];
+        } else {
+            stats.SAHCost += TraversalCost * area_ratio;
+            stack.emplace_back(node_index + 1, depth + 1);
+            stack.emplace_back(node.Offset, depth + 1);
+        }
+    }
+
+    return stats;
 }
 
 std::vector<BoundingBox> BVH::CreateInternalBoxes() const {
@@ -40,7 +313,7 @@ std::vector<BoundingBox> BVH::CreateInternalBoxes() const {
     
     for (const auto& node : Nodes) {
         if (node.IsInternal()) {
-            internal_boxes.push_back(node.Internal->Box);
+            internal_boxes.push_back(node.Box());
         }
     }
 
@@ -48,32 +321,11 @@ std::vector<BoundingBox> BVH::CreateInternalBoxes() const {
 }
 
 std::optional<uint> BVH::Intersect(const Ray &ray, const std::function<bool(uint)> &callback) const {
-    if (Nodes.empty()) return std::nullopt;
-
-    const uint root_index = Nodes.size() - 1;
-    return IntersectNode(root_index, ray, callback);
+    return Intersect<const std::function<bool(uint)> &>(ray, callback);
 }
 
-std::optional<uint> BVH::IntersectNode(uint node_index, const Ray &ray, const std::function<bool(uint)> &callback) const {
-    const auto& node = Nodes[node_index];
-    if (node.IsLeaf())
-    {
-        return LeafBoxes[*node.BoxIndex].Intersect(ray) && callback(*node.BoxIndex) ? node.BoxIndex : std::nullopt;
-    }
-
-    // Internal node.
-    if (!node.Internal->Box.Intersect(ray))
-    {
-        return std::nullopt;
-    }
-    
-    if (auto left_hit = IntersectNode(node.Internal->Left, ray, callback))
-    {
-        return left_hit;
-    }
-    
-    return IntersectNode(node.Internal->Right, ray, callback);
+std::optional<uint> BVH::IntersectNearest(const Ray &ray, const std::function<std::optional<float>(uint)> &callback, float *distance_out) const {
+    return IntersectNearest<const std::function<std::optional<float>(uint)> &>(ray, callback, distance_out);
 }
 
-
 LINK_EDITOR_NAMESPACE_END
@@ -1,40 +1,403 @@
 ﻿#pragma once
 #include "pch.h"
+#include "Core/Math/SIMD.h"
 #include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
+#include "Renderer/AccelerationStructures/Frustum/Frustum.h"
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
+enum class BVHBuilder
+{
+    Median, // Split at the median box center along the longest axis.
+    SAH,    // Binned surface area heuristic.
+};
+
+struct BVHBuildOptions
+{
+    BVHBuilder Builder = BVHBuilder::SAH;
+    uint MaxLeafSize = 4; // Maximum number of primitives per leaf, in `[1, 8]`.
+    uint BinCount = 16;   // Number of SAH bins per axis, in `[2, BVH::MaxBinCount]`.
+    bool Parallel = true; // Build on the thread pool. Produces the same tree as the serial build.
+};
+
+// Build-quality report, for comparing builders.
+struct BVHStats
+{
+    float SAHCost = 0;  // Expected cost of a random ray query, in units of `BVH::TraversalCost`/`BVH::IntersectionCost`.
+    uint Depth = 0;     // Number of levels, counting the root.
+    uint NodeCount = 0;
+    uint LeafCount = 0;
+    std::vector<uint> LeafSizeHistogram; // Number of leaves by primitive count.
+    float BuildTimeMs = 0;
+    float RefitTimeMs = 0; // Duration of the last refit, if any.
+};
+
+// `FloatV::Width` rays traversed together, one per lane.
+struct BVHRayPacket
+{
+    FloatV OriginX, OriginY, OriginZ;
+    FloatV InvDirX, InvDirY, InvDirZ;
+};
+
 struct BVH
 {
+    // Compact 32-byte node. Nodes are stored in depth-first order, so the first child of an internal node
+    // always directly follows its parent in `BVH::Nodes`, and only the second child needs an explicit index.
     struct Node {
-        // Leaf nodes have a valid `BoxIndex` pointing to the index of the box in `BVH::LeafBoxes`.
-        // Internal nodes have a valid `Internal` field.
-        struct InternalData {
-            uint Left, Right; // Indices of child nodes in `BVH::Nodes`.
-            BoundingBox Box; // Union of the child boxes.
-        };
-        std::optional<uint> BoxIndex;
-        std::optional<InternalData> Internal;
+        glm::vec3 Min;
+        uint Offset; // Leaf: index of the first primitive in `BVH::PrimitiveIndices`. Internal: index of the second child in `BVH::Nodes`.
+        glm::vec3 Max;
+        uint Count; // Number of primitives in a leaf. Zero for internal nodes.
 
-        Node(uint index) : BoxIndex(index) {}
-        Node(uint left, uint right, BoundingBox box) : Internal({left, right, box}) {}
+        bool IsLeaf() const { return Count != 0; }
+        bool IsInternal() const { return Count == 0; }
+        BoundingBox Box() const { return {Min, Max}; }
+    };
+    static_assert(sizeof(Node) == 32, "BVH::Node should fit two nodes per cache line.");
 
-        bool IsLeaf() const { return BoxIndex.has_value(); }
-        bool IsInternal() const { return Internal.has_value(); }
+    // A node of this tree and a node of another tree (or of this one, for self-overlap queries).
+    struct NodePair {
+        uint Node, OtherNode;
     };
-    
-    BVH(std::vector<BoundingBox>& leaf_boxes);
+
+    // Upper bound of the tree depth, which bounds the traversal stack.
+    inline static constexpr uint MaxDepth = 64;
+    inline static constexpr uint MaxBinCount = 32;
+    inline static constexpr uint MaxLeafSizeLimit = 8;
+    // Subtrees with at least this many primitives are split into parallel tasks.
+    inline static constexpr uint ParallelBuildThreshold = 4096;
+    inline static constexpr size_t ParallelGrainSize = 16384;
+    // Subtrees with at least this many nodes are refitted in parallel tasks.
+    inline static constexpr uint ParallelRefitThreshold = 8192;
+    // SAH cost model.
+    inline static constexpr float TraversalCost = 1.f;
+    inline static constexpr float IntersectionCost = 1.f;
+
+    BVH(std::vector<BoundingBox> leaf_boxes, BVHBuildOptions options = {});
+    // Restores a tree built earlier with `options`, e.g. from a mesh cache, without rebuilding it. `build_sah_cost` is the SAH cost
+    // right after the original build, so that refits keep measuring the degradation from it.
+    BVH(std::vector<Node> nodes, std::vector<uint> primitive_indices, BVHBuildOptions options, float build_sah_cost);
     ~BVH() = default;
 
+    // Any-hit query. Returns the first leaf box index for which `callback(uint) -> bool` returns true, visiting children front-to-back.
+    template<typename Callback>
+    std::optional<uint> Intersect(const Ray &ray, Callback &&callback) const {
+        std::optional<uint> hit;
+        float t_max = std::numeric_limits<float>::max();
+        TraverseLeaves(ray, t_max, [&](uint first, uint count, float &) {
+            for (uint i = first; i < first + count; ++i) {
+                if (callback(PrimitiveIndices[i])) {
+                    hit = PrimitiveIndices[i];
+                    return true;
+                }
+            }
+            return false;
+        });
+        return hit;
+    }
+
+    // Nearest-hit query. `callback(uint) -> std::optional<float>` returns the hit distance of the ray with the primitive
+    // (or `std::nullopt` on a miss), which is used to shrink the search interval so subtrees behind the current nearest hit are culled.
+    // Returns the leaf box index of the nearest hit, and sets `distance_out`, if not null.
+    template<typename Callback>
+    std::optional<uint> IntersectNearest(const Ray &ray, Callback &&callback, float *distance_out = nullptr) const {
+        std::optional<uint> nearest;
+        float t_max = std::numeric_limits<float>::max();
+        TraverseLeaves(ray, t_max, [&](uint first, uint count, float &leaf_t_max) {
+            for (uint i = first; i < first + count; ++i) {
+                if (const std::optional<float> distance = callback(PrimitiveIndices[i]); distance && *distance < leaf_t_max) {
+                    leaf_t_max = *distance;
+                    nearest = PrimitiveIndices[i];
+                }
+            }
+            return false;
+        });
+        if (nearest && distance_out) *distance_out = t_max;
+        return nearest;
+    }
+
+    // Non-template shims, for call sites holding a `std::function`.
     std::optional<uint> Intersect(const Ray &, const std::function<bool(uint)> &callback) const;
+    std::optional<uint> IntersectNearest(const Ray &, const std::function<std::optional<float>(uint)> &callback, float *distance_out = nullptr) const;
+
+    // Core traversal. Visits the leaves entered by the ray within `[0, t_max]` front-to-back, calling
+    // `visit_leaf(uint first, uint count, float &t_max) -> bool` with the leaf's range in `PrimitiveIndices`.
+    // The visitor may shrink `t_max` to cull farther subtrees, and returns true to stop the traversal.
+    template<typename LeafVisitor>
+    void TraverseLeaves(const Ray &ray, float &t_max, LeafVisitor &&visit_leaf) const {
+        if (Nodes.empty()) return;
+
+        struct StackEntry {
+            uint NodeIndex;
+            float TNear; // Entry distance, to skip deferred nodes that are behind a closer hit found in the meantime.
+        };
+
+        const glm::vec3 inv_dir = 1.f / ray.Direction;
+        std::array<StackEntry, MaxDepth> stack;
+        uint stack_size = 0;
+        float t_root;
+        if (!BoundingBox::IntersectSlabs(Nodes[0].Min, Nodes[0].Max, ray.Origin, inv_dir, t_max, t_root)) return;
+
+        stack[stack_size++] = {0, t_root};
+        while (stack_size > 0) {
+            const auto entry = stack[--stack_size];
+            if (entry.TNear > t_max) continue;
+
+            uint node_index = entry.NodeIndex;
+            while (true) {
+                const auto &node = Nodes[node_index];
+                if (node.IsLeaf()) {
+                    if (visit_leaf(node.Offset, node.Count, t_max)) return;
+                    break;
+                }
+
+                // Visit the nearer child first, and defer the farther one.
+                const uint left = node_index + 1, right = node.Offset;
+                float t_left, t_right;
+                const bool hit_left = BoundingBox::IntersectSlabs(Nodes[left].Min, Nodes[left].Max, ray.Origin, inv_dir, t_max, t_left);
+                const bool hit_right = BoundingBox::IntersectSlabs(Nodes[right].Min, Nodes[right].Max, ray.Origin, inv_dir, t_max, t_right);
+                if (hit_left && hit_right) {
+                    const bool left_first = t_left <= t_right;
+                    stack[stack_size++] = left_first ? StackEntry{right, t_right} : StackEntry{left, t_left};
+                    node_index = left_first ? left : right;
+                } else if (hit_left || hit_right) {
+                    node_index = hit_left ? left : right;
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Proximity traversal. Visits the leaves whose boxes are within `sqrt(max_distance_sq)` of the point, nearer boxes first,
+    // calling `visit_leaf(uint first, uint count, float &max_distance_sq) -> bool`. The visitor may shrink `max_distance_sq`
+    // to cull farther subtrees, and returns true to stop the traversal.
+    template<typename LeafVisitor>
+    void TraverseLeavesByDistance(const glm::vec3 &point, float &max_distance_sq, LeafVisitor &&visit_leaf) const {
+        if (Nodes.empty()) return;
+
+        struct StackEntry {
+            uint NodeIndex;
+            float DistanceSq;
+        };
+
+        std::array<StackEntry, MaxDepth> stack;
+        uint stack_size = 0;
+        const float d_root = Nodes[0].Box().DistanceSquared(point);
+        if (d_root > max_distance_sq) return;
+
+        stack[stack_size++] = {0, d_root};
+        while (stack_size > 0) {
+            const auto entry = stack[--stack_size];
+            if (entry.DistanceSq > max_distance_sq) continue;
+
+            uint node_index = entry.NodeIndex;
+            while (true) {
+                const auto &node = Nodes[node_index];
+                if (node.IsLeaf()) {
+                    if (visit_leaf(node.Offset, node.Count, max_distance_sq)) return;
+                    break;
+                }
+
+                const uint left = node_index + 1, right = node.Offset;
+                const float d_left = Nodes[left].Box().DistanceSquared(point), d_right = Nodes[right].Box().DistanceSquared(point);
+                const bool near_left = d_left <= max_distance_sq, near_right = d_right <= max_distance_sq;
+                if (near_left && near_right) {
+                    const bool left_first = d_left <= d_right;
+                    stack[stack_size++] = left_first ? StackEntry{right, d_right} : StackEntry{left, d_left};
+                    node_index = left_first ? left : right;
+                } else if (near_left || near_right) {
+                    node_index = near_left ? left : right;
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Packet traversal. Visits the leaves entered by any ray of the packet, calling
+    // `visit_leaf(uint first, uint count, FloatV &t_max) -> bool` with per-lane `t_max`. Lanes with a negative `t_max` are inactive.
+    // Children are ordered front-to-back for the first ray entering both.
+    template<typename LeafVisitor>
+    void TraversePacketLeaves(const BVHRayPacket &packet, FloatV &t_max, LeafVisitor &&visit_leaf) const {
+        if (Nodes.empty()) return;
+
+        std::array<uint, MaxDepth> stack;
+        uint stack_size = 0;
+        stack[stack_size++] = 0;
+        alignas(32) float t_left[FloatV::Width], t_right[FloatV::Width];
+        while (stack_size > 0) {
+            uint node_index = stack[--stack_size];
+            FloatV t_near;
+            // Deferred nodes are retested, since hits found in the meantime may have culled them.
+            if (IntersectPacket(Nodes[node_index], packet, t_max, t_near) == 0) continue;
+
+            while (true) {
+                const auto &node = Nodes[node_index];
+                if (node.IsLeaf()) {
+                    if (visit_leaf(node.Offset, node.Count, t_max)) return;
+                    break;
+                }
+
+                const uint left = node_index + 1, right = node.Offset;
+                FloatV t_near_left, t_near_right;
+                const uint mask_left = IntersectPacket(Nodes[left], packet, t_max, t_near_left);
+                const uint mask_right = IntersectPacket(Nodes[right], packet, t_max, t_near_right);
+                if (mask_left != 0 && mask_right != 0) {
+                    bool left_first = true;
+                    if (const uint both = mask_left & mask_right; both != 0) {
+                        const uint lane = FirstSetBit(both);
+                        t_near_left.Store(t_left);
+                        t_near_right.Store(t_right);
+                        left_first = t_left[lane] <= t_right[lane];
+                    }
+                    stack[stack_size++] = left_first ? right : left;
+                    node_index = left_first ? left : right;
+                } else if (mask_left != 0 || mask_right != 0) {
+                    node_index = mask_left != 0 ? left : right;
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Region traversal. Calls `visit_leaf(uint first, uint count, bool inside)` for the ranges in `PrimitiveIndices` whose boxes
+    // overlap the frustum. Subtrees entirely inside the frustum are reported as a single range with `inside = true`, without
+    // testing their children, so the visitor can accept their primitives wholesale.
+    template<typename LeafVisitor>
+    void TraverseFrustum(const Frustum &frustum, LeafVisitor &&visit_leaf) const {
+        if (Nodes.empty()) return;
+
+        std::array<uint, MaxDepth> stack;
+        uint stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0) {
+            const uint node_index = stack[--stack_size];
+            const auto &node = Nodes[node_index];
+            const auto containment = frustum.Classify(node.Min, node.Max);
+            if (containment == FrustumContainment::Outside) continue;
+            if (containment == FrustumContainment::Inside) {
+                const auto [first, count] = GetPrimitiveRange(node_index);
+                visit_leaf(first, count, true);
+            } else if (node.IsLeaf()) {
+                visit_leaf(node.Offset, node.Count, false);
+            } else {
+                stack[stack_size++] = node.Offset;
+                stack[stack_size++] = node_index + 1;
+            }
+        }
+    }
+
+    // The `{first, count}` range in `PrimitiveIndices` covered by the subtree. Subtrees cover contiguous ranges, since the build
+    // partitions primitives in place, so this walks down to the leftmost and rightmost leaves.
+    std::pair<uint, uint> GetPrimitiveRange(uint node_index) const {
+        uint first = node_index, last = node_index;
+        while (Nodes[first].IsInternal()) ++first;
+        while (Nodes[last].IsInternal()) last = Nodes[last].Offset;
+        return {Nodes[first].Offset, Nodes[last].Offset + Nodes[last].Count - Nodes[first].Offset};
+    }
+
+    // Simultaneous traversal of this tree and `other`, starting from the node pair `root` (`{0, 0}` for the whole trees).
+    // Calls `visit_pair(uint first, uint count, uint other_first, uint other_count) -> bool` for each pair of leaves with overlapping boxes,
+    // and stops if it returns true. `other_to_this` maps `other`'s space to this tree's space, or is null if they share it.
+    // With `other` being this tree, a node paired with itself yields each unordered pair of its leaves once, and each leaf with itself.
+    template<typename PairVisitor>
+    void TraverseOverlaps(const BVH &other, const glm::mat4 *other_to_this, NodePair root, PairVisitor &&visit_pair) const {
+        if (Nodes.empty() || other.Nodes.empty()) return;
+
+        // A self traversal pushes up to three pairs per level, so this may outgrow a fixed `MaxDepth` stack.
+        std::vector<NodePair> stack{root};
+        std::array<NodePair, 3> children;
+        while (!stack.empty()) {
+            const NodePair pair = stack.back();
+            stack.pop_back();
+            if (!IsSelfPair(other, pair) && !NodesOverlap(other, other_to_this, pair)) continue;
+
+            if (const uint child_count = SplitPair(other, pair, children); child_count > 0) {
+                stack.insert(stack.end(), children.begin(), children.begin() + child_count);
+            } else {
+                const Node &node = Nodes[pair.Node], &other_node = other.Nodes[pair.OtherNode];
+                if (visit_pair(node.Offset, node.Count, other_node.Offset, other_node.Count)) return;
+            }
+        }
+    }
+
+    // Expands the root pair of `TraverseOverlaps` breadth-first into at least `min_count` pairs (fewer for small trees), whose
+    // traversals are independent and together visit the same leaf pairs, for running them in parallel.
+    std::vector<NodePair> SplitOverlapTraversal(const BVH &other, const glm::mat4 *other_to_this, uint min_count) const;
+
+    bool IsSelfPair(const BVH &other, NodePair pair) const { return &other == this && pair.Node == pair.OtherNode; }
+
+    bool NodesOverlap(const BVH &other, const glm::mat4 *other_to_this, NodePair pair) const {
+        const BoundingBox other_box = other.Nodes[pair.OtherNode].Box();
+        return Nodes[pair.Node].Box().Overlaps(other_to_this ? other_box * *other_to_this : other_box);
+    }
+
+    // Child pairs to test after a pair of overlapping nodes, or none for a pair of leaves. Descends into the larger node first,
+    // and splits a self pair into the pairs of its children with themselves and with each other.
+    uint SplitPair(const BVH &other, NodePair pair, std::array<NodePair, 3> &children_out) const {
+        const Node &node = Nodes[pair.Node], &other_node = other.Nodes[pair.OtherNode];
+        if (IsSelfPair(other, pair)) {
+            if (node.IsLeaf()) return 0;
+            const uint left = pair.Node + 1, right = node.Offset;
+            children_out = {{{left, left}, {right, right}, {left, right}}};
+            return 3;
+        }
+        if (node.IsLeaf() && other_node.IsLeaf()) return 0;
+
+        if (other_node.IsLeaf() || (node.IsInternal() && node.Box().SurfaceArea() >= other_node.Box().SurfaceArea())) {
+            children_out[0] = {pair.Node + 1, pair.OtherNode};
+            children_out[1] = {node.Offset, pair.OtherNode};
+        } else {
+            children_out[0] = {pair.Node, pair.OtherNode + 1};
+            children_out[1] = {pair.Node, other_node.Offset};
+        }
+        return 2;
+    }
+
+    // Returns the mask of packet lanes entering the node's box within `[0, t_max]`, and their entry distances in `t_near_out`.
+    static uint IntersectPacket(const Node &node, const BVHRayPacket &packet, const FloatV &t_max, FloatV &t_near_out) {
+        static constexpr float ExitScale = 1 + 2 * std::numeric_limits<float>::epsilon();
+        const FloatV t0x = (FloatV(node.Min.x) - packet.OriginX) * packet.InvDirX, t1x = (FloatV(node.Max.x) - packet.OriginX) * packet.InvDirX;
+        const FloatV t0y = (FloatV(node.Min.y) - packet.OriginY) * packet.InvDirY, t1y = (FloatV(node.Max.y) - packet.OriginY) * packet.InvDirY;
+        const FloatV t0z = (FloatV(node.Min.z) - packet.OriginZ) * packet.InvDirZ, t1z = (FloatV(node.Max.z) - packet.OriginZ) * packet.InvDirZ;
+        t_near_out = Max(Max(Min(t0x, t1x), Min(t0y, t1y)), Max(Min(t0z, t1z), FloatV(0.f)));
+        const FloatV t_far = Min(Min(Max(t0x, t1x), Max(t0y, t1y)), Min(Max(t0z, t1z), t_max)) * FloatV(ExitScale);
+        return MoveMask(t_near_out <= t_far);
+    }
+
+    // Recomputes all node boxes bottom-up from updated leaf boxes (same count and order), keeping the tree topology.
+    // Much cheaper than a rebuild, but the tree degrades as primitives move away from their original neighbours (see `GetSAHDegradation`).
+    void Refit(std::vector<BoundingBox> leaf_boxes);
+    // Ratio of the current SAH cost to the SAH cost right after the build. Grows as refits degrade the tree.
+    float GetSAHDegradation() const { return BuildSAHCost > 0 ? Stats.SAHCost / BuildSAHCost : 1; }
+    float GetBuildSAHCost() const { return BuildSAHCost; }
+
     std::vector<BoundingBox> CreateInternalBoxes() const; // All non-leaf boxes, for debugging.
 
+    const BVHBuildOptions &GetOptions() const { return Options; }
+    const BVHStats &GetStats() const { return Stats; }
+    const std::vector<Node> &GetNodes() const { return Nodes; }
+    const std::vector<uint> &GetPrimitiveIndices() const { return PrimitiveIndices; }
+
 private:
-    std::vector<BoundingBox> LeafBoxes;
-    std::vector<Node> Nodes;
+    BVHBuildOptions Options;
+    std::vector<BoundingBox> LeafBoxes; // Empty for restored trees until their first refit.
+    std::vector<glm::vec3> Centers; // Leaf box centers, only kept during the build.
+    std::vector<uint> PrimitiveIndices; // Leaf box indices, ordered so that each leaf references a contiguous range.
+    std::vector<Node> Nodes; // Root is at index 0.
+    BVHStats Stats; // Computed after the build and after each refit.
+    float BuildSAHCost = 0;
 
-    uint Build(std::vector<uint>& indices);
-    std::optional<uint> IntersectNode(uint node_index, const Ray &ray, const std::function<bool(uint)> &callback) const;
+    void ParallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body) const;
+    uint Build(uint begin, uint end, uint depth, std::vector<Node> &nodes);
+    void ComputeBounds(uint begin, uint end, BoundingBox &box_out, BoundingBox &center_box_out) const;
+    // Partition `PrimitiveIndices[begin, end)` in place, and return the split position, or `end` to make a leaf.
+    uint SplitMedian(uint begin, uint end, const BoundingBox &box);
+    uint SplitSAH(uint begin, uint end, const BoundingBox &box, const BoundingBox &center_box);
+    BVHStats ComputeStats() const;
+    BoundingBox RefitNode(uint node_index);
 };
 
 LINK_EDITOR_NAMESPACE_END
\ No newline at end of file
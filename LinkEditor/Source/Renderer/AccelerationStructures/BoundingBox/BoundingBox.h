@@ -56,6 +56,12 @@ struct BoundingBox
     
     glm::vec3 Center() const { return (Min + Max) * 0.5f; }
     float DiagonalLength() const { return glm::length(Max - Min); }
+    float SurfaceArea() const
+    {
+        if (!IsValid()) return 0;
+        const glm::vec3 diff = Max - Min;
+        return 2 * (diff.x * diff.y + diff.y * diff.z + diff.z * diff.x);
+    }
     
     static BoundingBox UnionAll(std::vector<BoundingBox> boxes)
     {
@@ -65,6 +71,18 @@ struct BoundingBox
         });
     }
     
+    // Squared distance from the point to the box, zero inside.
+    float DistanceSquared(const glm::vec3 &p) const
+    {
+        const glm::vec3 d = glm::max(glm::max(Min - p, p - Max), glm::vec3(0));
+        return glm::dot(d, d);
+    }
+
+    bool Overlaps(const BoundingBox &o) const
+    {
+        return glm::all(glm::lessThanEqual(Min, o.Max)) && glm::all(glm::lessThanEqual(o.Min, Max));
+    }
+
     BoundingBox Union(const BoundingBox &o) const
     {
         return {glm::min(Min, o.Min), glm::max(Max, o.Max)};
@@ -87,20 +105,21 @@ struct BoundingBox
     // Returns the intersection distance of the ray with the box, or `std::nullopt` if there is no intersection.
     std::optional<float> Intersect(const Ray &ray) const
     {
-        float t0 = 0, t1 = std::numeric_limits<float>::max();
-        for (int i = 0; i < 3; ++i)
-        {
-            const float inv_ray_dir = 1.f / ray.Direction[i];
-            float t_near = (Min[i] - ray.Origin[i]) * inv_ray_dir;
-            float t_far = (Max[i] - ray.Origin[i]) * inv_ray_dir;
-            if (t_near > t_far) std::swap(t_near, t_far);
-            t_far *= 1 + 2 * std::numeric_limits<float>::epsilon();
-            
-            t0 = std::max(t0, t_near);
-            t1 = std::min(t1, t_far);
-            if (t0 > t1) return std::nullopt;
-        }
-        return t0;
+        float t_near;
+        if (!IntersectSlabs(Min, Max, ray.Origin, 1.f / ray.Direction, std::numeric_limits<float>::max(), t_near)) return std::nullopt;
+        return t_near;
+    }
+
+    // Branchless slab test against a precomputed inverse ray direction, for use in traversal loops.
+    // Returns true if the ray enters the box within `[0, t_max]`, and sets `t_near_out` to the entry distance.
+    static bool IntersectSlabs(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin, const glm::vec3 &inv_dir, float t_max, float &t_near_out)
+    {
+        const glm::vec3 t0 = (min - origin) * inv_dir;
+        const glm::vec3 t1 = (max - origin) * inv_dir;
+        const glm::vec3 t_near = glm::min(t0, t1), t_far = glm::max(t0, t1);
+        t_near_out = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.f));
+        const float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, t_max)) * (1 + 2 * std::numeric_limits<float>::epsilon());
+        return t_near_out <= t_exit;
     }
 };
 
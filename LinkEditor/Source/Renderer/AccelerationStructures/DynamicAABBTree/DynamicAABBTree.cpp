@@ -0,0 +1,182 @@
+﻿#include "DynamicAABBTree.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static bool Contains(const BoundingBox &outer, const BoundingBox &inner) {
+    return glm::all(glm::lessThanEqual(outer.Min, inner.Min)) && glm::all(glm::greaterThanEqual(outer.Max, inner.Max));
+}
+
+BoundingBox DynamicAABBTree::Fatten(const BoundingBox &box) {
+    const glm::vec3 margin(FatMargin * box.DiagonalLength());
+    return {box.Min - margin, box.Max + margin};
+}
+
+uint DynamicAABBTree::Insert(const BoundingBox &box, uint user_data) {
+    const uint leaf = AllocateNode();
+    auto &node = Nodes[leaf];
+    node.Box = Fatten(box);
+    node.UserData = user_data;
+    node.Height = 0;
+    InsertLeaf(leaf);
+    ++ProxyCount;
+    return leaf;
+}
+
+void DynamicAABBTree::Remove(uint proxy) {
+    LINK_EDITOR_CORE_ASSERT(proxy < Nodes.size() && Nodes[proxy].IsLeaf(), "Invalid proxy");
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --ProxyCount;
+}
+
+bool DynamicAABBTree::Move(uint proxy, const BoundingBox &box) {
+    LINK_EDITOR_CORE_ASSERT(proxy < Nodes.size() && Nodes[proxy].IsLeaf(), "Invalid proxy");
+    const BoundingBox fat_box = Fatten(box);
+    // Keep the leaf while its fat box still encloses the object and isn't much too large (e.g. after scaling down).
+    const auto &node = Nodes[proxy];
+    if (Contains(node.Box, box) && node.Box.SurfaceArea() <= 4 * fat_box.SurfaceArea()) return false;
+
+    RemoveLeaf(proxy);
+    Nodes[proxy].Box = fat_box;
+    InsertLeaf(proxy);
+    return true;
+}
+
+uint DynamicAABBTree::AllocateNode() {
+    if (FreeList == NullNode) {
+        Nodes.emplace_back();
+        return Nodes.size() - 1;
+    }
+    const uint index = FreeList;
+    FreeList = Nodes[index].Parent;
+    Nodes[index] = {};
+    return index;
+}
+
+void DynamicAABBTree::FreeNode(uint index) {
+    Nodes[index] = {};
+    Nodes[index].Parent = FreeList;
+    FreeList = index;
+}
+
+void DynamicAABBTree::InsertLeaf(uint leaf) {
+    if (Root == NullNode) {
+        Root = leaf;
+        Nodes[leaf].Parent = NullNode;
+        return;
+    }
+
+    // Descend towards the sibling with the least surface area increase (Box2D's heuristic), stopping when
+    // pairing with the current node costs less than pushing the leaf further down.
+    const BoundingBox leaf_box = Nodes[leaf].Box;
+    uint index = Root;
+    while (!Nodes[index].IsLeaf()) {
+        const auto &node = Nodes[index];
+        const float area = node.Box.SurfaceArea();
+        const float combined_area = node.Box.Union(leaf_box).SurfaceArea();
+        const float cost = 2 * combined_area; // Creating a new parent for this node and the leaf.
+        const float inheritance_cost = 2 * (combined_area - area); // Minimum cost of pushing the leaf further down.
+
+        const auto child_cost = [&](uint child) {
+            const auto &child_box = Nodes[child].Box;
+            const float union_area = child_box.Union(leaf_box).SurfaceArea();
+            return (Nodes[child].IsLeaf() ? union_area : union_area - child_box.SurfaceArea()) + inheritance_cost;
+        };
+        const float cost1 = child_cost(node.Child1), cost2 = child_cost(node.Child2);
+        if (cost < cost1 && cost < cost2) break;
+
+        index = cost1 < cost2 ? node.Child1 : node.Child2;
+    }
+
+    const uint sibling = index;
+    const uint old_parent = Nodes[sibling].Parent;
+    const uint new_parent = AllocateNode();
+    auto &parent_node = Nodes[new_parent];
+    parent_node.Parent = old_parent;
+    parent_node.Box = Nodes[sibling].Box.Union(leaf_box);
+    parent_node.Height = Nodes[sibling].Height + 1;
+    parent_node.Child1 = sibling;
+    parent_node.Child2 = leaf;
+    if (old_parent == NullNode) {
+        Root = new_parent;
+    } else if (Nodes[old_parent].Child1 == sibling) {
+        Nodes[old_parent].Child1 = new_parent;
+    } else {
+        Nodes[old_parent].Child2 = new_parent;
+    }
+    Nodes[sibling].Parent = new_parent;
+    Nodes[leaf].Parent = new_parent;
+
+    Refit(new_parent);
+}
+
+void DynamicAABBTree::RemoveLeaf(uint leaf) {
+    if (leaf == Root) {
+        Root = NullNode;
+        return;
+    }
+
+    const uint parent = Nodes[leaf].Parent;
+    const uint grand_parent = Nodes[parent].Parent;
+    const uint sibling = Nodes[parent].Child1 == leaf ? Nodes[parent].Child2 : Nodes[parent].Child1;
+    Nodes[sibling].Parent = grand_parent;
+    FreeNode(parent);
+    if (grand_parent == NullNode) {
+        Root = sibling;
+        return;
+    }
+
+    if (Nodes[grand_parent].Child1 == parent) Nodes[grand_parent].Child1 = sibling;
+    else Nodes[grand_parent].Child2 = sibling;
+    Refit(grand_parent);
+}
+
+void DynamicAABBTree::Refit(uint index) {
+    while (index != NullNode) {
+        index = Balance(index);
+        auto &node = Nodes[index];
+        node.Height = 1 + std::max(Nodes[node.Child1].Height, Nodes[node.Child2].Height);
+        node.Box = Nodes[node.Child1].Box.Union(Nodes[node.Child2].Box);
+        index = node.Parent;
+    }
+}
+
+uint DynamicAABBTree::Balance(uint a) {
+    auto &node_a = Nodes[a];
+    if (node_a.IsLeaf() || node_a.Height < 2) return a;
+
+    // Rotates `up` (a child of `a`) into the place of `a`, moving `a` down. `other` is the remaining child of `a`.
+    // The taller child of `up` stays under `up`, and the shorter one moves under `a`.
+    const auto rotate = [&](uint up, uint other) {
+        auto &node_up = Nodes[up];
+        const uint f = node_up.Child1, g = node_up.Child2;
+        const uint stay = Nodes[f].Height > Nodes[g].Height ? f : g;
+        const uint move = stay == f ? g : f;
+
+        node_up.Child1 = a;
+        node_up.Child2 = stay;
+        node_up.Parent = node_a.Parent;
+        node_a.Parent = up;
+        if (node_up.Parent == NullNode) Root = up;
+        else if (Nodes[node_up.Parent].Child1 == a) Nodes[node_up.Parent].Child1 = up;
+        else Nodes[node_up.Parent].Child2 = up;
+
+        if (node_a.Child1 == up) node_a.Child1 = move;
+        else node_a.Child2 = move;
+        Nodes[move].Parent = a;
+
+        node_a.Box = Nodes[other].Box.Union(Nodes[move].Box);
+        node_a.Height = 1 + std::max(Nodes[other].Height, Nodes[move].Height);
+        node_up.Box = node_a.Box.Union(Nodes[stay].Box);
+        node_up.Height = 1 + std::max(node_a.Height, Nodes[stay].Height);
+        return up;
+    };
+
+    const uint b = node_a.Child1, c = node_a.Child2;
+    const int balance = Nodes[c].Height - Nodes[b].Height;
+    if (balance > 1) return rotate(c, b);
+    if (balance < -1) return rotate(b, c);
+    return a;
+}
+
+LINK_EDITOR_NAMESPACE_END
@@ -0,0 +1,106 @@
+﻿#pragma once
+#include "pch.h"
+#include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Incrementally updated AABB tree over moving objects, e.g. scene entities.
+// Leaves store fattened boxes, so small moves don't touch the tree. Larger moves reinsert the leaf, which refits and
+// rebalances (with AVL-style rotations) only the nodes on its path to the root, so updates and ray queries are O(log n).
+struct DynamicAABBTree
+{
+    inline static constexpr uint NullNode = std::numeric_limits<uint>::max();
+    // Leaf boxes are grown by this fraction of their diagonal on each side.
+    inline static constexpr float FatMargin = 0.05f;
+
+    DynamicAABBTree() = default;
+    ~DynamicAABBTree() = default;
+
+    // Returns the proxy id of the new leaf, which stays valid until `Remove`.
+    uint Insert(const BoundingBox &box, uint user_data);
+    void Remove(uint proxy);
+    // Updates the leaf's box. Returns true if the leaf had to be reinserted.
+    bool Move(uint proxy, const BoundingBox &box);
+
+    uint GetUserData(uint proxy) const { return Nodes[proxy].UserData; }
+    const BoundingBox &GetFatBox(uint proxy) const { return Nodes[proxy].Box; }
+    uint GetProxyCount() const { return ProxyCount; }
+    uint GetHeight() const { return Root == NullNode ? 0 : Nodes[Root].Height + 1; }
+
+    // Visits the leaves whose fat box the ray enters within `[0, t_max]` front-to-back, calling
+    // `visit_leaf(uint user_data, float &t_max) -> bool`. Same contract as `BVH::TraverseLeaves`.
+    template<typename LeafVisitor>
+    void TraverseLeaves(const Ray &ray, float &t_max, LeafVisitor &&visit_leaf) const {
+        if (Root == NullNode) return;
+
+        struct StackEntry {
+            uint NodeIndex;
+            float TNear;
+        };
+
+        const glm::vec3 inv_dir = 1.f / ray.Direction;
+        float t_root;
+        if (!BoundingBox::IntersectSlabs(Nodes[Root].Box.Min, Nodes[Root].Box.Max, ray.Origin, inv_dir, t_max, t_root)) return;
+
+        std::vector<StackEntry> stack;
+        stack.reserve(GetHeight());
+        stack.push_back({Root, t_root});
+        while (!stack.empty()) {
+            const auto entry = stack.back();
+            stack.pop_back();
+            if (entry.TNear > t_max) continue;
+
+            uint node_index = entry.NodeIndex;
+            while (true) {
+                const auto &node = Nodes[node_index];
+                if (node.IsLeaf()) {
+                    if (visit_leaf(node.UserData, t_max)) return;
+                    break;
+                }
+
+                const uint child1 = node.Child1, child2 = node.Child2;
+                float t1, t2;
+                const bool hit1 = BoundingBox::IntersectSlabs(Nodes[child1].Box.Min, Nodes[child1].Box.Max, ray.Origin, inv_dir, t_max, t1);
+                const bool hit2 = BoundingBox::IntersectSlabs(Nodes[child2].Box.Min, Nodes[child2].Box.Max, ray.Origin, inv_dir, t_max, t2);
+                if (hit1 && hit2) {
+                    const bool first = t1 <= t2;
+                    stack.push_back(first ? StackEntry{child2, t2} : StackEntry{child1, t1});
+                    node_index = first ? child1 : child2;
+                } else if (hit1 || hit2) {
+                    node_index = hit1 ? child1 : child2;
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    struct Node {
+        BoundingBox Box;
+        uint Parent = NullNode; // Next free node, for nodes in the free list.
+        uint Child1 = NullNode, Child2 = NullNode;
+        int Height = -1; // Zero for leaves, -1 for free nodes.
+        uint UserData = 0;
+
+        bool IsLeaf() const { return Child1 == NullNode; }
+    };
+
+    std::vector<Node> Nodes;
+    uint Root = NullNode;
+    uint FreeList = NullNode;
+    uint ProxyCount = 0;
+
+    uint AllocateNode();
+    void FreeNode(uint index);
+    void InsertLeaf(uint leaf);
+    void RemoveLeaf(uint leaf);
+    // Recomputes boxes and heights from `index` up to the root, rebalancing on the way.
+    void Refit(uint index);
+    // Rotates the taller grandchild of `index` up if its children's heights differ by more than one. Returns the subtree's new root.
+    uint Balance(uint index);
+
+    static BoundingBox Fatten(const BoundingBox &box);
+};
+
+LINK_EDITOR_NAMESPACE_END
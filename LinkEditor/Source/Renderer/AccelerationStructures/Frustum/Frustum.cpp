@@ -0,0 +1,28 @@
+﻿#include "Frustum.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+Frustum Frustum::FromNDCRect(const glm::mat4 &inv_clip_transform, glm::vec2 ndc_min, glm::vec2 ndc_max) {
+    // Corner `i` is at `x = ndc_min/max.x` for bit 0, `y` for bit 1, and the near/far plane for bit 2.
+    std::array<glm::vec3, 8> corners;
+    for (uint i = 0; i < 8; ++i) {
+        const glm::vec4 ndc{i & 1 ? ndc_max.x : ndc_min.x, i & 2 ? ndc_max.y : ndc_min.y, i & 4 ? 1.f : -1.f, 1.f};
+        const glm::vec4 p = inv_clip_transform * ndc;
+        corners[i] = glm::vec3(p) / p.w;
+    }
+
+    // Each side is spanned by three of its corners. Orient each plane towards the frustum center, so that the
+    // result does not depend on the handedness of the transform.
+    static constexpr uint Sides[6][3] = {{0, 2, 4}, {1, 5, 3}, {0, 4, 1}, {2, 3, 6}, {0, 1, 2}, {4, 6, 5}};
+    const glm::vec3 center = std::accumulate(corners.begin(), corners.end(), glm::vec3(0)) / 8.f;
+    Frustum frustum;
+    for (uint i = 0; i < 6; ++i) {
+        const glm::vec3 &a = corners[Sides[i][0]], &b = corners[Sides[i][1]], &c = corners[Sides[i][2]];
+        glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+        if (glm::dot(normal, center - a) < 0) normal = -normal;
+        frustum.Planes[i] = {normal, -glm::dot(normal, a)};
+    }
+    return frustum;
+}
+
+LINK_EDITOR_NAMESPACE_END
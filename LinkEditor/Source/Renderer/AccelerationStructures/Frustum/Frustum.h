@@ -0,0 +1,50 @@
+﻿#pragma once
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Result of testing a box against a frustum.
+enum class FrustumContainment
+{
+    Outside,
+    Intersecting,
+    Inside,
+};
+
+// Convex region bounded by six planes, e.g. the part of the view volume behind a screen rectangle.
+struct Frustum
+{
+    // Plane `(n, d)` keeps the points `p` with `dot(n, p) + d >= 0`. Normals are unit length and point inward.
+    // Ordered left, right, bottom, top, near, far.
+    std::array<glm::vec4, 6> Planes;
+
+    // The frustum behind the NDC rectangle `[ndc_min, ndc_max]`, over the full depth range. `inv_clip_transform` maps clip space
+    // to the space the frustum is expressed in, e.g. `Camera::GetInvViewProjectionMatrix()` for a world-space frustum,
+    // and the inverse model matrix times it for an object-space one. Works for perspective and orthographic projections.
+    static Frustum FromNDCRect(const glm::mat4 &inv_clip_transform, glm::vec2 ndc_min, glm::vec2 ndc_max);
+
+    bool Contains(const glm::vec3 &p) const
+    {
+        for (const glm::vec4 &plane : Planes) {
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0) return false;
+        }
+        return true;
+    }
+
+    // Conservative box test: may report `Intersecting` for boxes just outside a frustum corner, but never `Outside` or `Inside` wrongly.
+    FrustumContainment Classify(const glm::vec3 &min, const glm::vec3 &max) const
+    {
+        const glm::vec3 center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+        FrustumContainment containment = FrustumContainment::Inside;
+        for (const glm::vec4 &plane : Planes) {
+            const glm::vec3 normal{plane};
+            const float distance = glm::dot(normal, center) + plane.w;
+            const float radius = glm::dot(extent, glm::abs(normal));
+            if (distance + radius < 0) return FrustumContainment::Outside;
+            if (distance - radius < 0) containment = FrustumContainment::Intersecting;
+        }
+        return containment;
+    }
+};
+
+LINK_EDITOR_NAMESPACE_END
@@ -0,0 +1,122 @@
+﻿#include "KDTree.h"
+#include "Core/Thread/ThreadPool.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+KDTree::KDTree(const float *positions, uint point_count) {
+    Points.resize(point_count);
+    PointIndices.resize(point_count);
+    for (uint i = 0; i < point_count; ++i) {
+        Points[i] = {positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]};
+        PointIndices[i] = i;
+    }
+    if (point_count == 0) return;
+
+    // Build over the indices, then copy the points into leaf order.
+    Nodes.resize(NodeCount(point_count));
+    Build(0, point_count, 0);
+    std::vector<glm::vec3> points(point_count);
+    ThreadPool::Get().ParallelFor(0, point_count, ParallelBuildThreshold, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) points[i] = Points[PointIndices[i]];
+    });
+    Points = std::move(points);
+}
+
+uint KDTree::NodeCount(uint count) {
+    if (count <= LeafSize) return 1;
+    return 1 + NodeCount(count / 2) + NodeCount(count - count / 2);
+}
+
+void KDTree::Build(uint begin, uint end, uint node_index) {
+    auto &node = Nodes[node_index];
+    const uint count = end - begin;
+    if (count <= LeafSize) {
+        node = {0, 0, begin, count};
+        return;
+    }
+
+    glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+    for (uint i = begin; i < end; ++i) {
+        min = glm::min(min, Points[PointIndices[i]]);
+        max = glm::max(max, Points[PointIndices[i]]);
+    }
+    const glm::vec3 extent = max - min;
+    const uint axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+
+    const uint mid = begin + count / 2;
+    std::nth_element(PointIndices.begin() + begin, PointIndices.begin() + mid, PointIndices.begin() + end, [&](uint a, uint b) {
+        return Points[a][axis] < Points[b][axis];
+    });
+
+    const uint right_index = node_index + 1 + NodeCount(mid - begin);
+    node = {Points[PointIndices[mid]][axis], axis, right_index, 0};
+    if (count >= ParallelBuildThreshold) {
+        TaskGroup tasks;
+        tasks.Run([this, begin, mid, node_index] { Build(begin, mid, node_index + 1); });
+        Build(mid, end, right_index);
+        tasks.Wait();
+    } else {
+        Build(begin, mid, node_index + 1);
+        Build(mid, end, right_index);
+    }
+}
+
+uint KDTree::FindNearest(const glm::vec3 &point, uint k, float max_distance_sq, uint *indices_out, float *distances_sq_out) const {
+    if (Nodes.empty() || k == 0) return 0;
+
+    struct StackEntry {
+        uint NodeIndex;
+        float DistanceSq; // Lower bound of the squared distance to the node's points.
+    };
+
+    // Found points are kept sorted by distance in the output arrays. Once `k` are found, the farthest one bounds the search.
+    uint found = 0;
+    const auto bound = [&] { return found == k ? distances_sq_out[k - 1] : max_distance_sq; };
+
+    std::array<StackEntry, MaxDepth> stack;
+    uint stack_size = 0;
+    stack[stack_size++] = {0, 0};
+    while (stack_size > 0) {
+        const auto entry = stack[--stack_size];
+        if (entry.DistanceSq > bound()) continue;
+
+        uint node_index = entry.NodeIndex;
+        while (true) {
+            const auto &node = Nodes[node_index];
+            if (node.IsLeaf()) {
+                for (uint i = node.Offset; i < node.Offset + node.Count; ++i) {
+                    const glm::vec3 diff = Points[i] - point;
+                    const float distance_sq = glm::dot(diff, diff);
+                    const bool accept = found < k ? distance_sq <= max_distance_sq : distance_sq < distances_sq_out[k - 1];
+                    if (!accept) continue;
+
+                    // Insertion into the sorted results, dropping the farthest one if full.
+                    uint j = found < k ? found++ : k - 1;
+                    for (; j > 0 && distances_sq_out[j - 1] > distance_sq; --j) {
+                        distances_sq_out[j] = distances_sq_out[j - 1];
+                        indices_out[j] = indices_out[j - 1];
+                    }
+                    distances_sq_out[j] = distance_sq;
+                    indices_out[j] = PointIndices[i];
+                }
+                break;
+            }
+
+            // Descend into the side of the split containing the point, and defer the other side.
+            const float diff = point[node.Axis] - node.Split;
+            const uint left = node_index + 1, right = node.Offset;
+            if (diff * diff <= bound()) stack[stack_size++] = {diff < 0 ? right : left, diff * diff};
+            node_index = diff < 0 ? left : right;
+        }
+    }
+    return found;
+}
+
+std::optional<uint> KDTree::FindNearest(const glm::vec3 &point, float max_distance_sq) const {
+    uint index;
+    float distance_sq;
+    if (FindNearest(point, 1, max_distance_sq, &index, &distance_sq) == 0) return std::nullopt;
+    return index;
+}
+
+LINK_EDITOR_NAMESPACE_END
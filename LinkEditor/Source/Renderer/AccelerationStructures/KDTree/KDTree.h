@@ -0,0 +1,46 @@
+﻿#pragma once
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Static KD-tree over a point set, for k-nearest-neighbour queries.
+// Points are split at the median along the widest axis down to leaves of at most `LeafSize` points.
+// Nodes are stored depth-first like `BVH::Node`, and points are copied in leaf order, so leaves are contiguous in memory.
+struct KDTree
+{
+    struct Node {
+        float Split; // Internal: points with a smaller coordinate along `Axis` are in the first child.
+        uint Axis;
+        uint Offset; // Leaf: index of the first point in `KDTree::Points`. Internal: index of the second child in `KDTree::Nodes`.
+        uint Count;  // Number of points in a leaf. Zero for internal nodes.
+
+        bool IsLeaf() const { return Count != 0; }
+    };
+
+    inline static constexpr uint LeafSize = 8;
+    inline static constexpr uint MaxDepth = 64; // Median splits halve the point count per level.
+    // Subtrees with at least this many points are built in parallel tasks.
+    inline static constexpr uint ParallelBuildThreshold = 16384;
+
+    // `positions` holds xyz per point.
+    KDTree(const float *positions, uint point_count);
+    ~KDTree() = default;
+
+    // Finds up to `k` points within `sqrt(max_distance_sq)` of `point`, nearest first.
+    // Writes their indices and squared distances to the first entries of `indices_out` and `distances_sq_out` (both of size `k`), and returns the number found.
+    uint FindNearest(const glm::vec3 &point, uint k, float max_distance_sq, uint *indices_out, float *distances_sq_out) const;
+    std::optional<uint> FindNearest(const glm::vec3 &point, float max_distance_sq = std::numeric_limits<float>::infinity()) const;
+
+    uint GetPointCount() const { return Points.size(); }
+
+private:
+    std::vector<Node> Nodes; // Root is at index 0.
+    std::vector<glm::vec3> Points; // In leaf order (in input order during the build).
+    std::vector<uint> PointIndices; // Original index of each point in `Points`.
+
+    void Build(uint begin, uint end, uint node_index);
+    // Number of nodes of a subtree over `count` points. The tree shape only depends on the point count, so parallel subtrees know their node ranges up front.
+    static uint NodeCount(uint count);
+};
+
+LINK_EDITOR_NAMESPACE_END
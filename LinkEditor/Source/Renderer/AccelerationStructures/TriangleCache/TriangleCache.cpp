@@ -0,0 +1,330 @@
+﻿#include "TriangleCache.h"
+#include "Renderer/Ray/Ray.h"
+#include "Core/Thread/ThreadPool.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+WatertightRay::WatertightRay(const Ray &ray) : Origin(ray.Origin) {
+    const glm::vec3 abs_dir = glm::abs(ray.Direction);
+    Kz = abs_dir.x > abs_dir.y ? (abs_dir.x > abs_dir.z ? 0 : 2) : (abs_dir.y > abs_dir.z ? 1 : 2);
+    Kx = (Kz + 1) % 3;
+    Ky = (Kx + 1) % 3;
+    if (ray.Direction[Kz] < 0) std::swap(Kx, Ky); // Keep the winding, so the sign of the edge functions is consistent.
+
+    Sx = ray.Direction[Kx] / ray.Direction[Kz];
+    Sy = ray.Direction[Ky] / ray.Direction[Kz];
+    Sz = 1.f / ray.Direction[Kz];
+}
+
+std::optional<WatertightRayPacket> WatertightRayPacket::Create(const WatertightRay *rays, uint count) {
+    for (uint i = 1; i < count; ++i) {
+        if (rays[i].Kx != rays[0].Kx || rays[i].Ky != rays[0].Ky || rays[i].Kz != rays[0].Kz) return std::nullopt;
+    }
+
+    static constexpr uint Width = FloatV::Width;
+    alignas(32) float lanes[6][Width];
+    for (uint i = 0; i < Width; ++i) {
+        const auto &ray = rays[i < count ? i : 0];
+        lanes[0][i] = ray.Origin[ray.Kx];
+        lanes[1][i] = ray.Origin[ray.Ky];
+        lanes[2][i] = ray.Origin[ray.Kz];
+        lanes[3][i] = ray.Sx;
+        lanes[4][i] = ray.Sy;
+        lanes[5][i] = ray.Sz;
+    }
+    return WatertightRayPacket{
+        rays[0].Kx, rays[0].Ky, rays[0].Kz,
+        FloatV::Load(lanes[0]), FloatV::Load(lanes[1]), FloatV::Load(lanes[2]),
+        FloatV::Load(lanes[3]), FloatV::Load(lanes[4]), FloatV::Load(lanes[5]),
+    };
+}
+
+// Watertight test on vertices already translated to the ray origins and sheared, shared by the block and packet variants.
+// Lanes are either different triangles against one ray, or one triangle against different rays.
+// Writes each lane's distance and barycentrics, and returns the lane mask of hits within `(0, t_max)`.
+static FloatV IntersectSheared(const FloatV (&x)[3], const FloatV (&y)[3], const FloatV (&z)[3], const FloatV &t_max, FloatV &t_out, FloatV &u_out, FloatV &v_out) {
+    static constexpr uint Width = FloatV::Width;
+
+    // Scaled barycentric coordinates (edge functions). The ray hits the triangle iff they all have the same sign.
+    FloatV u = x[2] * y[1] - y[2] * x[1];
+    FloatV v = x[0] * y[2] - y[0] * x[2];
+    FloatV w = x[1] * y[0] - y[1] * x[0];
+    const FloatV zero(0.f);
+    const uint on_edge = MoveMask((u == zero) | (v == zero) | (w == zero));
+    if (on_edge != 0) {
+        // The ray passes exactly through an edge or vertex in single precision. Recompute the edge functions of these lanes
+        // in double precision from the same sheared coordinates, so neighbouring triangles still agree on their shared edges.
+        alignas(32) float xs[3][Width], ys[3][Width], us[Width], vs[Width], ws[Width];
+        for (uint c = 0; c < 3; ++c) {
+            x[c].Store(xs[c]);
+            y[c].Store(ys[c]);
+        }
+        u.Store(us);
+        v.Store(vs);
+        w.Store(ws);
+        for (uint mask = on_edge; mask != 0; mask &= mask - 1) {
+            const uint i = FirstSetBit(mask);
+            us[i] = float(double(xs[2][i]) * double(ys[1][i]) - double(ys[2][i]) * double(xs[1][i]));
+            vs[i] = float(double(xs[0][i]) * double(ys[2][i]) - double(ys[0][i]) * double(xs[2][i]));
+            ws[i] = float(double(xs[1][i]) * double(ys[0][i]) - double(ys[1][i]) * double(xs[0][i]));
+        }
+        u = FloatV::Load(us);
+        v = FloatV::Load(vs);
+        w = FloatV::Load(ws);
+    }
+    const FloatV outside = ((u < zero) | (v < zero) | (w < zero)) & ((u > zero) | (v > zero) | (w > zero));
+
+    const FloatV det = u + v + w;
+    t_out = (u * z[0] + v * z[1] + w * z[2]) / det;
+    u_out = v / det;
+    v_out = w / det;
+    return AndNot(det != zero, outside) & (t_out > zero) & (t_out < t_max);
+}
+
+TriangleCache::TriangleCache(const BVH &bvh, const float *positions, const std::vector<uint> &face_offsets, const std::vector<uint> &face_vertices) {
+    const auto &primitives = bvh.GetPrimitiveIndices();
+    const uint primitive_count = primitives.size();
+    TriangleOffsets.resize(primitive_count + 1);
+    TriangleOffsets[0] = 0;
+    for (uint p = 0; p < primitive_count; ++p) {
+        const uint valence = face_offsets[primitives[p] + 1] - face_offsets[primitives[p]];
+        TriangleOffsets[p + 1] = TriangleOffsets[p] + (valence >= 3 ? valence - 2 : 0);
+    }
+
+    const uint triangle_count = TriangleOffsets.back();
+    for (auto &corner : Vertices) {
+        for (auto &axis : corner) axis.resize(triangle_count + FloatV::Width - 1, 0.f);
+    }
+    FaceIds.resize(triangle_count);
+    FanIndices.resize(triangle_count);
+
+    ThreadPool::Get().ParallelFor(0, primitive_count, BVH::ParallelGrainSize, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            const uint face = primitives[p];
+            const uint *polygon = face_vertices.data() + face_offsets[face];
+            const uint first = TriangleOffsets[p], count = TriangleOffsets[p + 1] - first;
+            for (uint i = 0; i < count; ++i) {
+                const uint triangle = first + i;
+                const std::array<uint, 3> corners{polygon[0], polygon[i + 1], polygon[i + 2]};
+                for (uint c = 0; c < 3; ++c) {
+                    for (uint axis = 0; axis < 3; ++axis) Vertices[c][axis][triangle] = positions[3 * corners[c] + axis];
+                }
+                FaceIds[triangle] = face;
+                FanIndices[triangle] = i;
+            }
+        }
+    });
+}
+
+glm::vec3 TriangleCache::GetVertex(uint triangle, uint corner) const {
+    return {Vertices[corner][0][triangle], Vertices[corner][1][triangle], Vertices[corner][2][triangle]};
+}
+
+uint TriangleCache::IntersectBlock(const WatertightRay &ray, uint first, float t_max, float *t_out, float *u_out, float *v_out) const {
+    const FloatV ox(ray.Origin[ray.Kx]), oy(ray.Origin[ray.Ky]), oz(ray.Origin[ray.Kz]);
+    const FloatV sx(ray.Sx), sy(ray.Sy), sz(ray.Sz);
+
+    // Translate the vertices to the ray origin and shear them, so the ray is the +z axis.
+    FloatV x[3], y[3], z[3];
+    for (uint c = 0; c < 3; ++c) {
+        const FloatV pz = FloatV::Load(&Vertices[c][ray.Kz][first]) - oz;
+        x[c] = FloatV::Load(&Vertices[c][ray.Kx][first]) - ox - sx * pz;
+        y[c] = FloatV::Load(&Vertices[c][ray.Ky][first]) - oy - sy * pz;
+        z[c] = sz * pz;
+    }
+
+    FloatV t, u, v;
+    const uint hit = MoveMask(IntersectSheared(x, y, z, FloatV(t_max), t, u, v));
+    t.Store(t_out);
+    u.Store(u_out);
+    v.Store(v_out);
+    return hit;
+}
+
+bool TriangleCache::IntersectNearest(const WatertightRay &ray, uint first, uint last, float &t_max, TriangleHit &hit_out) const {
+    static constexpr uint Width = FloatV::Width;
+    bool found = false;
+    alignas(32) float t[Width], u[Width], v[Width];
+    for (uint block = first; block < last; block += Width) {
+        const uint lanes = last - block >= Width ? (1u << Width) - 1 : (1u << (last - block)) - 1;
+        for (uint mask = IntersectBlock(ray, block, t_max, t, u, v) & lanes; mask != 0; mask &= mask - 1) {
+            const uint lane = FirstSetBit(mask);
+            if (t[lane] < t_max) {
+                t_max = t[lane];
+                hit_out = {t[lane], block + lane, u[lane], v[lane]};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+bool TriangleCache::IntersectAny(const WatertightRay &ray, uint first, uint last, float t_max) const {
+    static constexpr uint Width = FloatV::Width;
+    alignas(32) float t[Width], u[Width], v[Width];
+    for (uint block = first; block < last; block += Width) {
+        const uint lanes = last - block >= Width ? (1u << Width) - 1 : (1u << (last - block)) - 1;
+        if ((IntersectBlock(ray, block, t_max, t, u, v) & lanes) != 0) return true;
+    }
+    return false;
+}
+
+// Six times the signed volume of the tetrahedron `abcd`. Positive if `d` is on the side of the plane `abc` the normal `(b - a) x (c - a)` points to.
+static double Orient3D(const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c, const glm::dvec3 &d) {
+    return glm::dot(glm::cross(b - a, c - a), d - a);
+}
+
+static double Orient2D(const glm::dvec2 &a, const glm::dvec2 &b, const glm::dvec2 &c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static bool HaveSameSign(double a, double b, double c) { return (a >= 0 && b >= 0 && c >= 0) || (a <= 0 && b <= 0 && c <= 0); }
+static bool IsStrictlyOneSide(const double (&d)[3]) { return (d[0] > 0 && d[1] > 0 && d[2] > 0) || (d[0] < 0 && d[1] < 0 && d[2] < 0); }
+
+// Whether the segment `pq` touches the triangle `abc`. A segment in the triangle's plane is left to the coplanar test.
+static bool SegmentIntersectsTriangle(const glm::dvec3 &p, const glm::dvec3 &q, const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+    const double dp = Orient3D(a, b, c, p), dq = Orient3D(a, b, c, q);
+    if ((dp > 0 && dq > 0) || (dp < 0 && dq < 0) || (dp == 0 && dq == 0)) return false;
+    // The line `pq` passes through the triangle iff it turns the same way around all three edges.
+    return HaveSameSign(Orient3D(p, q, a, b), Orient3D(p, q, b, c), Orient3D(p, q, c, a));
+}
+
+static bool SegmentsIntersect2D(const glm::dvec2 &p1, const glm::dvec2 &p2, const glm::dvec2 &q1, const glm::dvec2 &q2) {
+    const double d1 = Orient2D(q1, q2, p1), d2 = Orient2D(q1, q2, p2), d3 = Orient2D(p1, p2, q1), d4 = Orient2D(p1, p2, q2);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) return true;
+
+    // Collinear endpoints touching the other segment.
+    const auto on_segment = [](const glm::dvec2 &a, const glm::dvec2 &b, const glm::dvec2 &p) {
+        return std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) && std::min(a.y, b.y) <= p.y && p.y <= std::max(a.y, b.y);
+    };
+    return (d1 == 0 && on_segment(q1, q2, p1)) || (d2 == 0 && on_segment(q1, q2, p2)) ||
+        (d3 == 0 && on_segment(p1, p2, q1)) || (d4 == 0 && on_segment(p1, p2, q2));
+}
+
+// Both triangles lie in the plane with normal `normal`. Projects them along its dominant axis and tests them in 2D.
+static bool CoplanarTrianglesIntersect(const std::array<glm::dvec3, 3> &a, const std::array<glm::dvec3, 3> &b, const glm::dvec3 &normal) {
+    const glm::dvec3 n = glm::abs(normal);
+    const uint drop = n.x >= n.y && n.x >= n.z ? 0 : n.y >= n.z ? 1 : 2;
+    const uint u = (drop + 1) % 3, v = (drop + 2) % 3;
+    std::array<glm::dvec2, 3> a2, b2;
+    for (uint i = 0; i < 3; ++i) {
+        a2[i] = {a[i][u], a[i][v]};
+        b2[i] = {b[i][u], b[i][v]};
+    }
+
+    for (uint i = 0; i < 3; ++i) {
+        for (uint j = 0; j < 3; ++j) {
+            if (SegmentsIntersect2D(a2[i], a2[(i + 1) % 3], b2[j], b2[(j + 1) % 3])) return true;
+        }
+    }
+    // No edges cross, so either triangle is inside the other, or they are disjoint.
+    const auto contains = [](const std::array<glm::dvec2, 3> &t, const glm::dvec2 &p) {
+        return HaveSameSign(Orient2D(t[0], t[1], p), Orient2D(t[1], t[2], p), Orient2D(t[2], t[0], p));
+    };
+    return contains(b2, a2[0]) || contains(a2, b2[0]);
+}
+
+bool TrianglesIntersect(const std::array<glm::vec3, 3> &a, const std::array<glm::vec3, 3> &b) {
+    for (uint axis = 0; axis < 3; ++axis) {
+        if (std::max({a[0][axis], a[1][axis], a[2][axis]}) < std::min({b[0][axis], b[1][axis], b[2][axis]})) return false;
+        if (std::max({b[0][axis], b[1][axis], b[2][axis]}) < std::min({a[0][axis], a[1][axis], a[2][axis]})) return false;
+    }
+
+    const std::array<glm::dvec3, 3> ad{glm::dvec3(a[0]), glm::dvec3(a[1]), glm::dvec3(a[2])};
+    const std::array<glm::dvec3, 3> bd{glm::dvec3(b[0]), glm::dvec3(b[1]), glm::dvec3(b[2])};
+    const double da[3] = {Orient3D(bd[0], bd[1], bd[2], ad[0]), Orient3D(bd[0], bd[1], bd[2], ad[1]), Orient3D(bd[0], bd[1], bd[2], ad[2])};
+    if (IsStrictlyOneSide(da)) return false;
+    const double db[3] = {Orient3D(ad[0], ad[1], ad[2], bd[0]), Orient3D(ad[0], ad[1], ad[2], bd[1]), Orient3D(ad[0], ad[1], ad[2], bd[2])};
+    if (IsStrictlyOneSide(db)) return false;
+
+    if (da[0] == 0 && da[1] == 0 && da[2] == 0) {
+        return CoplanarTrianglesIntersect(ad, bd, glm::cross(bd[1] - bd[0], bd[2] - bd[0]));
+    }
+    // Non-coplanar triangles intersect iff an edge of one passes through the other.
+    for (uint i = 0; i < 3; ++i) {
+        if (SegmentIntersectsTriangle(ad[i], ad[(i + 1) % 3], bd[0], bd[1], bd[2])) return true;
+        if (SegmentIntersectsTriangle(bd[i], bd[(i + 1) % 3], ad[0], ad[1], ad[2])) return true;
+    }
+    return false;
+}
+
+// Barycentrics of the point on triangle `abc` closest to `p`, from the Voronoi regions of its vertices and edges (Ericson, Real-Time Collision Detection, 5.1.5).
+static glm::vec2 ClosestPointBarycentrics(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) return {0, 0};
+
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) return {1, 0};
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return {d1 / (d1 - d3), 0};
+
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) return {0, 1};
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return {0, d2 / (d2 - d6)};
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return {1 - w, w};
+    }
+
+    const float inv_denom = 1.f / (va + vb + vc);
+    return {vb * inv_denom, vc * inv_denom};
+}
+
+bool TriangleCache::ClosestPoint(const glm::vec3 &point, uint first, uint last, float &max_distance_sq, TriangleHit &hit_out) const {
+    bool found = false;
+    for (uint triangle = first; triangle < last; ++triangle) {
+        const glm::vec3 a = GetVertex(triangle, 0), b = GetVertex(triangle, 1), c = GetVertex(triangle, 2);
+        const glm::vec2 uv = ClosestPointBarycentrics(point, a, b, c);
+        const glm::vec3 diff = a + uv.x * (b - a) + uv.y * (c - a) - point;
+        const float distance_sq = glm::dot(diff, diff);
+        if (distance_sq <= max_distance_sq) {
+            max_distance_sq = distance_sq;
+            hit_out = {std::sqrt(distance_sq), triangle, uv.x, uv.y};
+            found = true;
+        }
+    }
+    return found;
+}
+
+uint TriangleCache::IntersectNearest(const WatertightRayPacket &packet, uint first, uint last, FloatV &t_max, TriangleHit *hits_out) const {
+    static constexpr uint Width = FloatV::Width;
+    uint hit_lanes = 0;
+    alignas(32) float t[Width], u[Width], v[Width];
+    for (uint triangle = first; triangle < last; ++triangle) {
+        // Same operations as `IntersectBlock`, so packets and single rays produce identical hits.
+        FloatV x[3], y[3], z[3];
+        for (uint c = 0; c < 3; ++c) {
+            const FloatV pz = FloatV(Vertices[c][packet.Kz][triangle]) - packet.OriginZ;
+            x[c] = FloatV(Vertices[c][packet.Kx][triangle]) - packet.OriginX - packet.Sx * pz;
+            y[c] = FloatV(Vertices[c][packet.Ky][triangle]) - packet.OriginY - packet.Sy * pz;
+            z[c] = packet.Sz * pz;
+        }
+
+        FloatV t_triangle, u_triangle, v_triangle;
+        const FloatV hit = IntersectSheared(x, y, z, t_max, t_triangle, u_triangle, v_triangle);
+        const uint mask = MoveMask(hit);
+        if (mask == 0) continue;
+
+        // Every hit lane is closer than its current `t_max`.
+        t_triangle.Store(t);
+        u_triangle.Store(u);
+        v_triangle.Store(v);
+        for (uint lanes = mask; lanes != 0; lanes &= lanes - 1) {
+            const uint lane = FirstSetBit(lanes);
+            hits_out[lane] = {t[lane], triangle, u[lane], v[lane]};
+        }
+        hit_lanes |= mask;
+        t_max = Select(hit, t_triangle, t_max);
+    }
+    return hit_lanes;
+}
+
+LINK_EDITOR_NAMESPACE_END
@@ -0,0 +1,81 @@
+﻿#pragma once
+#include "pch.h"
+#include "Core/Math/SIMD.h"
+#include "Renderer/AccelerationStructures/BVH/BVH.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+struct Ray;
+
+// Per-ray setup of the watertight ray-triangle test (Woop, Benthin and Wald 2013).
+// Triangles are translated to the ray origin and sheared so the ray points along +z, and the edge functions are
+// evaluated in this space. Neighbouring triangles evaluate their shared edge identically, so rays can't slip through cracks.
+struct WatertightRay {
+    WatertightRay() = default;
+    WatertightRay(const Ray &ray);
+
+    glm::vec3 Origin;
+    uint Kx, Ky, Kz; // Permuted axes, with `Kz` the dominant direction axis.
+    float Sx, Sy, Sz; // Shear constants.
+};
+
+// Up to `FloatV::Width` watertight rays sharing the same axis permutation, so a triangle can be tested against all of them at once.
+// Lanes beyond the ray count repeat the first ray.
+struct WatertightRayPacket {
+    // Returns `std::nullopt` if the rays' dominant axes or direction signs differ (incoherent rays).
+    static std::optional<WatertightRayPacket> Create(const WatertightRay *rays, uint count);
+
+    uint Kx, Ky, Kz;
+    FloatV OriginX, OriginY, OriginZ; // Origin coordinates along `Kx`, `Ky` and `Kz`.
+    FloatV Sx, Sy, Sz;
+};
+
+struct TriangleHit {
+    float Distance;
+    uint Triangle; // Index in the `TriangleCache`.
+    float U, V;    // Barycentric coordinates of the triangle's second and third vertices.
+};
+
+// Fan triangulation of all mesh faces, stored in SoA form in the primitive order of a `BVH`, so the triangles of each leaf are
+// one contiguous range that can be tested `FloatV::Width` at a time without going back to the mesh.
+struct TriangleCache {
+    // `positions` holds xyz per vertex. Face `f` has the vertices `face_vertices[face_offsets[f], face_offsets[f + 1])`.
+    TriangleCache(const BVH &bvh, const float *positions, const std::vector<uint> &face_offsets, const std::vector<uint> &face_vertices);
+    ~TriangleCache() = default;
+
+    // Triangle range `[first, last)` of the primitives `[first, first + count)` in the BVH's primitive order (e.g. a leaf).
+    std::pair<uint, uint> GetTriangleRange(uint first, uint count) const { return {TriangleOffsets[first], TriangleOffsets[first + count]}; }
+
+    uint GetTriangleCount() const { return FaceIds.size(); }
+    uint GetFace(uint triangle) const { return FaceIds[triangle]; }
+    uint GetFanIndex(uint triangle) const { return FanIndices[triangle]; } // The triangle spans face vertices `0`, `i + 1` and `i + 2`.
+    glm::vec3 GetVertex(uint triangle, uint corner) const;
+
+    // Nearest hit with the triangles `[first, last)` within `(0, t_max)`. On a hit, shrinks `t_max`, sets `hit_out`, and returns true.
+    bool IntersectNearest(const WatertightRay &ray, uint first, uint last, float &t_max, TriangleHit &hit_out) const;
+    // Returns true if any of the triangles `[first, last)` is hit within `(0, t_max)`.
+    bool IntersectAny(const WatertightRay &ray, uint first, uint last, float t_max) const;
+    // Closest point on the triangles `[first, last)` within `sqrt(max_distance_sq)` of `point`. On success, shrinks `max_distance_sq`,
+    // sets `hit_out` (with the distance to the closest point and its barycentrics), and returns true.
+    bool ClosestPoint(const glm::vec3 &point, uint first, uint last, float &max_distance_sq, TriangleHit &hit_out) const;
+    // Packet variant of `IntersectNearest`, with per-lane `t_max` and hits. Returns the mask of lanes with a new nearest hit.
+    uint IntersectNearest(const WatertightRayPacket &packet, uint first, uint last, FloatV &t_max, TriangleHit *hits_out) const;
+
+private:
+    // Vertex coordinates by corner and axis, e.g. `Vertices[1][2][i]` is the z coordinate of the second vertex of triangle `i`.
+    // Each array is padded by `FloatV::Width - 1` elements, so SIMD loads of the last block stay in bounds.
+    std::array<std::array<std::vector<float>, 3>, 3> Vertices;
+    std::vector<uint> FaceIds;
+    std::vector<uint> FanIndices;
+    std::vector<uint> TriangleOffsets; // First triangle of each BVH primitive, with a trailing total.
+
+    // Tests the `FloatV::Width` triangles starting at `first`, and writes each lane's distance and barycentrics to the output arrays.
+    // Returns the bitmask of lanes hit within `(0, t_max)`.
+    uint IntersectBlock(const WatertightRay &ray, uint first, float t_max, float *t_out, float *u_out, float *v_out) const;
+};
+
+// Triangle-triangle overlap test on orientation predicates evaluated in double precision, so the result does not depend on
+// tolerances. Triangles that only touch (including at a shared vertex or edge) count as intersecting.
+bool TrianglesIntersect(const std::array<glm::vec3, 3> &a, const std::array<glm::vec3, 3> &b);
+
+LINK_EDITOR_NAMESPACE_END
@@ -0,0 +1,87 @@
+﻿#include "WideBVH.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+template<uint Width>
+WideBVH<Width>::WideBVH(const BVH &bvh) : PrimitiveIndices(bvh.GetPrimitiveIndices()) {
+    const auto start_time = std::chrono::high_resolution_clock::now();
+
+    const auto &binary_nodes = bvh.GetNodes();
+    if (!binary_nodes.empty()) {
+        Nodes.reserve(binary_nodes.size() / (Width - 1) + 1);
+        Collapse(binary_nodes, 0);
+        Nodes.shrink_to_fit();
+    }
+
+    BuildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+}
+
+template<uint Width>
+uint WideBVH<Width>::Collapse(const std::vector<BVH::Node> &binary_nodes, uint binary_index) {
+    const uint node_index = Nodes.size();
+    Nodes.emplace_back();
+
+    // Gather up to `Width` children by repeatedly opening the internal child with the largest surface area.
+    std::array<uint, Width> children;
+    uint child_count = 0;
+    const auto &binary_node = binary_nodes[binary_index];
+    if (binary_node.IsLeaf()) {
+        children[child_count++] = binary_index;
+    } else {
+        children[child_count++] = binary_index + 1;
+        children[child_count++] = binary_node.Offset;
+    }
+    while (child_count < Width) {
+        int open_child = -1;
+        float max_area = -1;
+        for (uint i = 0; i < child_count; ++i) {
+            const auto &child = binary_nodes[children[i]];
+            if (child.IsInternal() && child.Box().SurfaceArea() > max_area) {
+                max_area = child.Box().SurfaceArea();
+                open_child = i;
+            }
+        }
+        if (open_child < 0) break;
+
+        const uint opened = children[open_child];
+        children[open_child] = opened + 1;
+        children[child_count++] = binary_nodes[opened].Offset;
+    }
+
+    // `Nodes` may reallocate during recursion, so fill a copy and assign by index.
+    Node node{};
+    node.ChildCount = child_count;
+    for (uint i = 0; i < Width; ++i) {
+        const bool valid = i < child_count;
+        const auto &child = binary_nodes[children[valid ? i : 0]];
+        node.MinX[i] = child.Min.x, node.MinY[i] = child.Min.y, node.MinZ[i] = child.Min.z;
+        node.MaxX[i] = child.Max.x, node.MaxY[i] = child.Max.y, node.MaxZ[i] = child.Max.z;
+        if (!valid) continue;
+
+        if (child.IsLeaf()) {
+            node.Children[i] = child.Offset;
+            node.Counts[i] = child.Count;
+        } else {
+            node.Children[i] = Collapse(binary_nodes, children[i]);
+            node.Counts[i] = 0;
+        }
+    }
+    Nodes[node_index] = node;
+
+    return node_index;
+}
+
+template<uint Width>
+std::optional<uint> WideBVH<Width>::Intersect(const Ray &ray, const std::function<bool(uint)> &callback) const {
+    return Intersect<const std::function<bool(uint)> &>(ray, callback);
+}
+
+template<uint Width>
+std::optional<uint> WideBVH<Width>::IntersectNearest(const Ray &ray, const std::function<std::optional<float>(uint)> &callback, float *distance_out) const {
+    return IntersectNearest<const std::function<std::optional<float>(uint)> &>(ray, callback, distance_out);
+}
+
+template struct WideBVH<4>;
+template struct WideBVH<8>;
+
+LINK_EDITOR_NAMESPACE_END
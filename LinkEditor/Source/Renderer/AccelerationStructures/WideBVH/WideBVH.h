@@ -0,0 +1,181 @@
+﻿#pragma once
+#include "pch.h"
+#include "Renderer/AccelerationStructures/BVH/BVH.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define LINK_EDITOR_WIDE_BVH_SSE
+#include <immintrin.h>
+#endif
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Acceleration structure used by mesh ray queries.
+enum class BVHType
+{
+    Binary,
+    BVH4,
+    BVH8,
+};
+
+// Wide BVH collapsed from a binary `BVH`, testing `Width` (4 or 8) child boxes per step with SSE/AVX.
+// Child bounds are stored in SoA form, and leaves are stored inline in their parent's child slots,
+// referencing primitive ranges in the same order as the binary BVH.
+template<uint Width>
+struct WideBVH
+{
+    static_assert(Width == 4 || Width == 8, "WideBVH supports 4-wide and 8-wide nodes.");
+
+    struct alignas(32) Node {
+        float MinX[Width], MinY[Width], MinZ[Width];
+        float MaxX[Width], MaxY[Width], MaxZ[Width];
+        uint Children[Width]; // Internal child: index in `WideBVH::Nodes`. Leaf child: index of its first primitive in `WideBVH::PrimitiveIndices`.
+        uint Counts[Width];   // Number of primitives of leaf children. Zero for internal children.
+        uint ChildCount;      // Valid children are packed at the front.
+    };
+
+    // Each wide level collapses at least one binary level, so the binary depth bounds the wide depth.
+    inline static constexpr uint MaxStackSize = BVH::MaxDepth * (Width - 1) + 1;
+
+    WideBVH(const BVH &bvh);
+    ~WideBVH() = default;
+
+    // Same contracts as `BVH::Intersect`, `BVH::IntersectNearest` and `BVH::TraverseLeaves`.
+    template<typename Callback>
+    std::optional<uint> Intersect(const Ray &ray, Callback &&callback) const {
+        std::optional<uint> hit;
+        float t_max = std::numeric_limits<float>::max();
+        TraverseLeaves(ray, t_max, [&](uint first, uint count, float &) {
+            for (uint i = first; i < first + count; ++i) {
+                if (callback(PrimitiveIndices[i])) {
+                    hit = PrimitiveIndices[i];
+                    return true;
+                }
+            }
+            return false;
+        });
+        return hit;
+    }
+
+    template<typename Callback>
+    std::optional<uint> IntersectNearest(const Ray &ray, Callback &&callback, float *distance_out = nullptr) const {
+        std::optional<uint> nearest;
+        float t_max = std::numeric_limits<float>::max();
+        TraverseLeaves(ray, t_max, [&](uint first, uint count, float &leaf_t_max) {
+            for (uint i = first; i < first + count; ++i) {
+                if (const std::optional<float> distance = callback(PrimitiveIndices[i]); distance && *distance < leaf_t_max) {
+                    leaf_t_max = *distance;
+                    nearest = PrimitiveIndices[i];
+                }
+            }
+            return false;
+        });
+        if (nearest && distance_out) *distance_out = t_max;
+        return nearest;
+    }
+
+    std::optional<uint> Intersect(const Ray &, const std::function<bool(uint)> &callback) const;
+    std::optional<uint> IntersectNearest(const Ray &, const std::function<std::optional<float>(uint)> &callback, float *distance_out = nullptr) const;
+
+    template<typename LeafVisitor>
+    void TraverseLeaves(const Ray &ray, float &t_max, LeafVisitor &&visit_leaf) const {
+        if (Nodes.empty()) return;
+
+        struct StackEntry {
+            uint Index; // Node index, or first primitive index for leaves.
+            uint Count; // Number of primitives for leaves, zero for internal nodes.
+            float TNear;
+        };
+
+        const glm::vec3 inv_dir = 1.f / ray.Direction;
+        std::array<StackEntry, MaxStackSize> stack;
+        uint stack_size = 0;
+        stack[stack_size++] = {0, 0, 0};
+        alignas(32) float t_near[Width];
+        while (stack_size > 0) {
+            const auto entry = stack[--stack_size];
+            if (entry.TNear > t_max) continue;
+
+            if (entry.Count > 0) {
+                if (visit_leaf(entry.Index, entry.Count, t_max)) return;
+                continue;
+            }
+
+            // Push the hit children far-to-near, so the nearest child is popped first.
+            const auto &node = Nodes[entry.Index];
+            const uint mask = IntersectChildren(node, ray.Origin, inv_dir, t_max, t_near);
+            std::array<StackEntry, Width> hits;
+            uint hit_count = 0;
+            for (uint i = 0; i < Width; ++i) {
+                if ((mask & (1u << i)) == 0) continue;
+
+                // Insertion sort by descending entry distance.
+                const StackEntry hit{node.Children[i], node.Counts[i], t_near[i]};
+                uint j = hit_count++;
+                for (; j > 0 && hits[j - 1].TNear < hit.TNear; --j) hits[j] = hits[j - 1];
+                hits[j] = hit;
+            }
+            for (uint i = 0; i < hit_count; ++i) stack[stack_size++] = hits[i];
+        }
+    }
+
+    uint GetNodeCount() const { return Nodes.size(); }
+    float GetBuildTimeMs() const { return BuildTimeMs; }
+
+private:
+    std::vector<uint> PrimitiveIndices;
+    std::vector<Node> Nodes; // Root is at index 0.
+    float BuildTimeMs = 0;
+
+    uint Collapse(const std::vector<BVH::Node> &binary_nodes, uint binary_index);
+
+    // Returns a bitmask of the children entered by the ray within `[0, t_max]`, and writes their entry distances to `t_near_out`.
+    static uint IntersectChildren(const Node &node, const glm::vec3 &origin, const glm::vec3 &inv_dir, float t_max, float *t_near_out) {
+        static constexpr float ExitScale = 1 + 2 * std::numeric_limits<float>::epsilon();
+        uint mask = 0;
+#if defined(LINK_EDITOR_WIDE_BVH_SSE) && defined(__AVX__)
+        if constexpr (Width == 8) {
+            const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+            const __m256 idx = _mm256_set1_ps(inv_dir.x), idy = _mm256_set1_ps(inv_dir.y), idz = _mm256_set1_ps(inv_dir.z);
+            const __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MinX), ox), idx);
+            const __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MaxX), ox), idx);
+            const __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MinY), oy), idy);
+            const __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MaxY), oy), idy);
+            const __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MinZ), oz), idz);
+            const __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.MaxZ), oz), idz);
+            const __m256 t_near = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)), _mm256_max_ps(_mm256_min_ps(t0z, t1z), _mm256_setzero_ps()));
+            const __m256 t_far = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)), _mm256_min_ps(_mm256_max_ps(t0z, t1z), _mm256_set1_ps(t_max)));
+            mask = _mm256_movemask_ps(_mm256_cmp_ps(t_near, _mm256_mul_ps(t_far, _mm256_set1_ps(ExitScale)), _CMP_LE_OQ));
+            _mm256_storeu_ps(t_near_out, t_near);
+            return mask & ((1u << node.ChildCount) - 1);
+        }
+#endif
+#if defined(LINK_EDITOR_WIDE_BVH_SSE)
+        const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        const __m128 idx = _mm_set1_ps(inv_dir.x), idy = _mm_set1_ps(inv_dir.y), idz = _mm_set1_ps(inv_dir.z);
+        for (uint k = 0; k < Width; k += 4) {
+            const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinX + k), ox), idx);
+            const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxX + k), ox), idx);
+            const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinY + k), oy), idy);
+            const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxY + k), oy), idy);
+            const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MinZ + k), oz), idz);
+            const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaxZ + k), oz), idz);
+            const __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+            const __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(t_max)));
+            mask |= uint(_mm_movemask_ps(_mm_cmple_ps(t_near, _mm_mul_ps(t_far, _mm_set1_ps(ExitScale))))) << k;
+            _mm_storeu_ps(t_near_out + k, t_near);
+        }
+#else
+        for (uint i = 0; i < Width; ++i) {
+            if (BoundingBox::IntersectSlabs({node.MinX[i], node.MinY[i], node.MinZ[i]}, {node.MaxX[i], node.MaxY[i], node.MaxZ[i]}, origin, inv_dir, t_max, t_near_out[i])) {
+                mask |= 1u << i;
+            }
+        }
+#endif
+        return mask & ((1u << node.ChildCount) - 1);
+    }
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+LINK_EDITOR_NAMESPACE_END
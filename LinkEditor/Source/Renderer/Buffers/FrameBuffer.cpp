@@ -206,6 +206,17 @@ int FrameBuffer::ReadPixel(uint32_t AttachmentIndex, int X, int Y)
     return PixelData;
 }
 
+std::vector<float> FrameBuffer::ReadDepth() const
+{
+    LINK_EDITOR_CORE_ASSERT(DepthAttachment && Specification.Samples <= 1, "Depth read-back needs a single-sample depth attachment!");
+
+    std::vector<float> Depth(static_cast<size_t>(Specification.Width) * Specification.Height);
+    glBindFramebuffer(GL_FRAMEBUFFER, RendererID);
+    glReadPixels(0, 0, Specification.Width, Specification.Height, GL_DEPTH_COMPONENT, GL_FLOAT, Depth.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return Depth;
+}
+
 void FrameBuffer::ClearAttachment(uint32_t AttachmentIndex, int Value)
 {
     LINK_EDITOR_CORE_ASSERT(AttachmentIndex < ColorAttachments.size())
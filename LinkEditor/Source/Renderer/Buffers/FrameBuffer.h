@@ -59,6 +59,8 @@ public:
 
     void Resize(uint32_t Width, uint32_t Height);
     int ReadPixel(uint32_t AttachmentIndex, int X, int Y);
+    // Window-space depths in `[0, 1]`, `Width * Height` values with the bottom row first.
+    std::vector<float> ReadDepth() const;
 
     void ClearAttachment(uint32_t AttachmentIndex, int Value);
     uint32_t GetColorAttachmentRendererID(uint32_t Index = 0) const;
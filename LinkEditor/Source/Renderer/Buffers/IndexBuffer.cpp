@@ -2,7 +2,7 @@
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
-IndexBuffer::IndexBuffer(uint32_t* Indices, uint32_t Count)
+IndexBuffer::IndexBuffer(const uint32_t* Indices, uint32_t Count)
     : Count(Count)
 {
     glCreateBuffers(1, &RendererID);
@@ -13,6 +13,14 @@ IndexBuffer::IndexBuffer(uint32_t* Indices, uint32_t Count)
     glBufferData(GL_ARRAY_BUFFER, Count * sizeof(uint32_t), Indices, GL_STATIC_DRAW);
 }
 
+IndexBuffer::IndexBuffer(uint32_t Count)
+    : Count(Count)
+{
+    glCreateBuffers(1, &RendererID);
+    glBindBuffer(GL_ARRAY_BUFFER, RendererID);
+    glBufferData(GL_ARRAY_BUFFER, Count * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+}
+
 IndexBuffer::~IndexBuffer()
 {
     glDeleteBuffers(1, &RendererID);
@@ -28,4 +36,10 @@ void IndexBuffer::Unbind() const
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void IndexBuffer::SetData(const uint32_t* Indices, uint32_t InCount, uint32_t Offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, RendererID);
+    glBufferSubData(GL_ARRAY_BUFFER, Offset * sizeof(uint32_t), InCount * sizeof(uint32_t), Indices);
+}
+
 LINK_EDITOR_NAMESPACE_END
@@ -7,12 +7,15 @@ LINK_EDITOR_NAMESPACE_BEGIN
 class IndexBuffer
 {
 public:
-    IndexBuffer(uint32_t* Indices, uint32_t Count);
+    IndexBuffer(const uint32_t* Indices, uint32_t Count);
+    IndexBuffer(uint32_t Count); // Uninitialized indices, to be uploaded with `SetData`.
     ~IndexBuffer();
 
     void Bind() const;
     void Unbind() const;
 
+    void SetData(const uint32_t* Indices, uint32_t InCount, uint32_t Offset = 0); // `Offset` in indices.
+
     uint32_t GetCount() const { return Count; }
 private:
     uint32_t RendererID;
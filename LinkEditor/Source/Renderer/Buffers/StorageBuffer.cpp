@@ -0,0 +1,28 @@
+﻿#include "StorageBuffer.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+StorageBuffer::StorageBuffer(const void* Data, uint32_t Size, uint32_t Binding)
+    : Binding(Binding)
+{
+    glCreateBuffers(1, &RendererID);
+    glNamedBufferData(RendererID, Size, Data, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Binding, RendererID);
+}
+
+StorageBuffer::~StorageBuffer()
+{
+    glDeleteBuffers(1, &RendererID);
+}
+
+void StorageBuffer::Bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, Binding, RendererID);
+}
+
+void StorageBuffer::SetData(const void* Data, uint32_t Size, uint32_t Offset)
+{
+    glNamedBufferSubData(RendererID, Offset, Size, Data);
+}
+
+LINK_EDITOR_NAMESPACE_END
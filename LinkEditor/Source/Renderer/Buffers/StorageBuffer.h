@@ -0,0 +1,22 @@
+﻿#pragma once
+
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Shader storage buffer. Buffers sharing a binding (e.g. one per mesh) are bound before each draw with `Bind`.
+class StorageBuffer
+{
+public:
+    StorageBuffer(const void* Data, uint32_t Size, uint32_t Binding);
+    ~StorageBuffer();
+
+    void Bind() const;
+    void SetData(const void* Data, uint32_t Size, uint32_t Offset = 0);
+
+private:
+    uint32_t RendererID;
+    uint32_t Binding;
+};
+
+LINK_EDITOR_NAMESPACE_END
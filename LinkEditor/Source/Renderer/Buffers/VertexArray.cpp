@@ -19,6 +19,10 @@ static GLenum ShaderDataTypeToOpenGLBaseType(ShaderDataType type)
     case ShaderDataType::Int3:     return GL_INT;
     case ShaderDataType::Int4:     return GL_INT;
     case ShaderDataType::Bool:     return GL_BOOL;
+    case ShaderDataType::UByte4:   return GL_UNSIGNED_BYTE;
+    case ShaderDataType::Short2:   return GL_SHORT;
+    case ShaderDataType::UShort4:  return GL_UNSIGNED_SHORT;
+    case ShaderDataType::Half2:    return GL_HALF_FLOAT;
     }
 
     LINK_EDITOR_CORE_ASSERT(false, "Unknown ShaderDataType!")
@@ -59,6 +63,10 @@ void VertexArray::AddVertexBuffer(const std::shared_ptr<VertexBuffer>& InVertexB
         case ShaderDataType::Float2:
         case ShaderDataType::Float3:
         case ShaderDataType::Float4:
+        case ShaderDataType::UByte4:
+        case ShaderDataType::Short2:
+        case ShaderDataType::UShort4:
+        case ShaderDataType::Half2:
             {
                 glEnableVertexAttribArray(VertexBufferIndex);
                 glVertexAttribPointer(VertexBufferIndex,
@@ -31,10 +31,10 @@ void VertexBuffer::Unbind() const
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void VertexBuffer::SetData(const void* Data, uint32_t Size)
+void VertexBuffer::SetData(const void* Data, uint32_t Size, uint32_t Offset)
 {
     glBindBuffer(GL_ARRAY_BUFFER, RendererID);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, Size, Data);
+    glBufferSubData(GL_ARRAY_BUFFER, Offset, Size, Data);
 }
 
 LINK_EDITOR_NAMESPACE_END
@@ -6,7 +6,9 @@ LINK_EDITOR_NAMESPACE_BEGIN
 
 enum class ShaderDataType
 {
-    None = 0, Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4, Bool
+    None = 0, Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4, Bool,
+    // Read as floats by the shaders, in `[0, 1]` or `[-1, 1]` if the element is normalized.
+    UByte4, Short2, UShort4, Half2
 };
 
 static uint32_t ShaderDataTypeSize(ShaderDataType type)
@@ -24,6 +26,10 @@ static uint32_t ShaderDataTypeSize(ShaderDataType type)
     case ShaderDataType::Int3:     return 4 * 3;
     case ShaderDataType::Int4:     return 4 * 4;
     case ShaderDataType::Bool:     return 1;
+    case ShaderDataType::UByte4:   return 4;
+    case ShaderDataType::Short2:   return 2 * 2;
+    case ShaderDataType::UShort4:  return 2 * 4;
+    case ShaderDataType::Half2:    return 2 * 2;
     }
 
     LINK_EDITOR_CORE_ASSERT(false, "Unknown ShaderDataType!")
@@ -60,6 +66,10 @@ struct VertexBufferElement
         case ShaderDataType::Int3:    return 3;
         case ShaderDataType::Int4:    return 4;
         case ShaderDataType::Bool:    return 1;
+        case ShaderDataType::UByte4:  return 4;
+        case ShaderDataType::Short2:  return 2;
+        case ShaderDataType::UShort4: return 4;
+        case ShaderDataType::Half2:   return 2;
         }
 
         LINK_EDITOR_CORE_ASSERT(false, "Unknown ShaderDataType!")
@@ -114,7 +124,7 @@ public:
     void Bind() const;
     void Unbind() const;
 
-    void SetData(const void* Data, uint32_t Size);
+    void SetData(const void* Data, uint32_t Size, uint32_t Offset = 0);
 
     const VertexBufferLayout& GetLayout() const { return Layout; }
     void SetLayout(const VertexBufferLayout& InLayout) { Layout = InLayout; }
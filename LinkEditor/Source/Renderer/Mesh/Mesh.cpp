@@ -2,6 +2,10 @@
 #include "Renderer/Ray/Ray.h"
 #include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
 #include "Renderer/AccelerationStructures/BVH/BVH.h"
+#include "Renderer/AccelerationStructures/Frustum/Frustum.h"
+#include "Renderer/Mesh/VertexDeduplication.h"
+#include "Renderer/Mesh/MeshCache.h"
+#include "Core/Thread/ThreadPool.h"
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
@@ -15,22 +19,229 @@ static float SquaredDistanceToLineSegment(const glm::vec3 &v1, const glm::vec3 &
     return glm::dot(diff, diff);
 }
 
-Mesh::Mesh(const fs::path& InMeshFilePath)
+// Even-odd rule.
+static bool IsInsidePolygon(const std::vector<glm::vec2> &polygon, const glm::vec2 &p) {
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const glm::vec2 &a = polygon[i], &b = polygon[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y)) inside = !inside;
+    }
+    return inside;
+}
+
+MeshSelectionRegion MeshSelectionRegion::FromLasso(std::vector<glm::vec2> Polygon)
 {
-    Load(InMeshFilePath, M);
+    MeshSelectionRegion Region;
+    Region.Min = glm::vec2(std::numeric_limits<float>::max());
+    Region.Max = glm::vec2(-std::numeric_limits<float>::max());
+    for(const auto& Point : Polygon)
+    {
+        Region.Min = glm::min(Region.Min, Point);
+        Region.Max = glm::max(Region.Max, Point);
+    }
+    Region.Lasso = std::move(Polygon);
+    return Region;
+}
 
-    M = DeduplicateVertices();
+// Half-edge connectivity in OpenMesh's layout: edge `e` has the halfedges `2e` and `2e + 1`, and invalid handles are -1.
+struct HalfedgeConnectivity
+{
+    uint EdgeCount = 0;
+    std::vector<int> ToVertices, NextHalfedges, Faces; // Per halfedge.
+    std::vector<int> VertexHalfedges; // Outgoing halfedge of each vertex, a boundary one for boundary vertices.
+    std::vector<int> FaceHalfedges;
+};
 
-    M.request_vertex_normals();
-    M.request_face_normals();
-    M.request_face_colors();
-    M.request_vertex_texcoords2D();
+// Builds the connectivity of all faces at once: corners are grouped by vertex to find each halfedge's opposite, and edges and
+// boundary loops are numbered in parallel. Returns false for meshes OpenMesh's `add_face` handles specially: faces with repeated
+// vertices, edges with more than two faces or inconsistently oriented faces, and vertices with several face fans.
+static bool CreateHalfedgeConnectivity(const MeshData& Data, HalfedgeConnectivity& Out)
+{
+    static constexpr int Invalid = -1;
+    static constexpr size_t GrainSize = Mesh::ConnectivityGrainSize;
+    const uint VertexCount = Data.GetVertexCount(), FaceCount = Data.GetFaceCount();
+    const size_t CornerCount = Data.FaceVertices.size();
+    const auto& FaceVertices = Data.FaceVertices;
+    std::atomic<bool> bIsManifold = true;
+
+    // Corner `c` of face `f` is the halfedge from `FaceVertices[c]` to the vertex of the next corner.
+    std::vector<uint> NextCorners(CornerCount);
+    ThreadPool::Get().ParallelFor(0, FaceCount, GrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Face = Begin; Face < End; ++Face)
+        {
+            const uint First = Data.FaceOffsets[Face], Last = Data.FaceOffsets[Face + 1];
+            if(Last - First < 3) bIsManifold = false;
+            for(uint Corner = First; Corner < Last; ++Corner)
+            {
+                NextCorners[Corner] = Corner + 1 < Last ? Corner + 1 : First;
+                if(std::find(FaceVertices.begin() + First, FaceVertices.begin() + Corner, FaceVertices[Corner]) != FaceVertices.begin() + Corner) bIsManifold = false;
+            }
+        }
+    });
+    if(!bIsManifold) return false;
+
+    // Outgoing corners of each vertex.
+    std::vector<uint> OutgoingOffsets(VertexCount + 1, 0), OutgoingCorners(CornerCount);
+    for(const uint Vertex : FaceVertices) ++OutgoingOffsets[Vertex + 1];
+    std::partial_sum(OutgoingOffsets.begin(), OutgoingOffsets.end(), OutgoingOffsets.begin());
+    {
+        std::vector<uint> Fill(OutgoingOffsets.begin(), OutgoingOffsets.end() - 1);
+        for(uint Corner = 0; Corner < CornerCount; ++Corner) OutgoingCorners[Fill[FaceVertices[Corner]]++] = Corner;
+    }
+
+    // The opposite of corner `a -> b` is the corner `b -> a`. The corner with the lower index of each pair, and each corner without
+    // an opposite, owns an edge.
+    std::vector<int> OppositeCorners(CornerCount);
+    std::vector<uint> EdgeOffsets(CornerCount + 1, 0);
+    ThreadPool::Get().ParallelFor(0, CornerCount, GrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Corner = Begin; Corner < End; ++Corner)
+        {
+            const uint From = FaceVertices[Corner], To = FaceVertices[NextCorners[Corner]];
+            int Opposite = Invalid;
+            for(uint i = OutgoingOffsets[To]; i < OutgoingOffsets[To + 1]; ++i)
+            {
+                if(FaceVertices[NextCorners[OutgoingCorners[i]]] != From) continue;
+                if(Opposite != Invalid) bIsManifold = false;
+                Opposite = int(OutgoingCorners[i]);
+            }
+            for(uint i = OutgoingOffsets[From]; i < OutgoingOffsets[From + 1]; ++i)
+            {
+                if(OutgoingCorners[i] != Corner && FaceVertices[NextCorners[OutgoingCorners[i]]] == To) bIsManifold = false;
+            }
+            OppositeCorners[Corner] = Opposite;
+            EdgeOffsets[Corner + 1] = Opposite == Invalid || int(Corner) < Opposite;
+        }
+    });
+    if(!bIsManifold) return false;
+    std::partial_sum(EdgeOffsets.begin(), EdgeOffsets.end(), EdgeOffsets.begin());
+
+    Out.EdgeCount = EdgeOffsets.back();
+    const size_t HalfedgeCount = size_t(Out.EdgeCount) * 2;
+    Out.ToVertices.assign(HalfedgeCount, Invalid);
+    Out.NextHalfedges.assign(HalfedgeCount, Invalid);
+    Out.Faces.assign(HalfedgeCount, Invalid);
+    Out.VertexHalfedges.assign(VertexCount, Invalid);
+    Out.FaceHalfedges.resize(FaceCount);
+    const auto HalfedgeOf = [&](uint Corner)
+    {
+        const int Opposite = OppositeCorners[Corner];
+        return Opposite == Invalid || int(Corner) < Opposite ? int(EdgeOffsets[Corner]) * 2 : int(EdgeOffsets[Opposite]) * 2 + 1;
+    };
+    ThreadPool::Get().ParallelFor(0, FaceCount, GrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Face = Begin; Face < End; ++Face)
+        {
+            Out.FaceHalfedges[Face] = HalfedgeOf(Data.FaceOffsets[Face]);
+            for(uint Corner = Data.FaceOffsets[Face]; Corner < Data.FaceOffsets[Face + 1]; ++Corner)
+            {
+                const int Halfedge = HalfedgeOf(Corner);
+                Out.ToVertices[Halfedge] = int(FaceVertices[NextCorners[Corner]]);
+                Out.NextHalfedges[Halfedge] = HalfedgeOf(NextCorners[Corner]);
+                Out.Faces[Halfedge] = int(Face);
+                if(OppositeCorners[Corner] == Invalid) Out.ToVertices[Halfedge + 1] = int(FaceVertices[Corner]);
+            }
+        }
+    });
 
-    SetFaceColor(FaceColor);
+    // Boundary halfedges are the opposites of corners without one. Each boundary vertex has a single outgoing boundary halfedge,
+    // which the boundary halfedge entering it continues with.
+    for(uint Corner = 0; Corner < CornerCount; ++Corner)
+    {
+        if(OppositeCorners[Corner] != Invalid) continue;
+        int& BoundaryHalfedge = Out.VertexHalfedges[FaceVertices[NextCorners[Corner]]];
+        if(BoundaryHalfedge != Invalid) return false;
+        BoundaryHalfedge = HalfedgeOf(Corner) + 1;
+    }
+    ThreadPool::Get().ParallelFor(0, CornerCount, GrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Corner = Begin; Corner < End; ++Corner)
+        {
+            if(OppositeCorners[Corner] == Invalid) Out.NextHalfedges[HalfedgeOf(uint(Corner)) + 1] = Out.VertexHalfedges[FaceVertices[Corner]];
+        }
+    });
+
+    // Interior vertices start at any outgoing halfedge. Circulating around each vertex must then reach all of its outgoing halfedges.
+    ThreadPool::Get().ParallelFor(0, VertexCount, GrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Vertex = Begin; Vertex < End; ++Vertex)
+        {
+            const uint OutgoingCount = OutgoingOffsets[Vertex + 1] - OutgoingOffsets[Vertex];
+            if(OutgoingCount == 0) continue;
+
+            int& First = Out.VertexHalfedges[Vertex];
+            if(First == Invalid) First = HalfedgeOf(OutgoingCorners[OutgoingOffsets[Vertex]]);
+            uint FaceHalfedgeCount = 0, Steps = 0;
+            int Halfedge = First;
+            do
+            {
+                FaceHalfedgeCount += Out.Faces[Halfedge] != Invalid;
+                Halfedge = Out.NextHalfedges[Halfedge ^ 1];
+            } while(Halfedge != First && Halfedge != Invalid && ++Steps <= OutgoingCount);
+            if(Halfedge != First || FaceHalfedgeCount != OutgoingCount) bIsManifold = false;
+        }
+    });
+    return bIsManifold;
+}
+
+Mesh::Mesh(const fs::path& InMeshFilePath, MeshLoadProgress* Progress)
+    : Mesh(InMeshFilePath, GetLoadOptions(), Progress)
+{
+}
+
+Mesh::Mesh(const fs::path& InMeshFilePath, const MeshLoadOptions& Options, MeshLoadProgress* Progress)
+{
+    const auto SetProgress = [Progress](const char* Stage, float Fraction)
+    {
+        if (Progress) Progress->Set(Stage, Fraction);
+    };
+
+    SetProgress("Reading cache", 0);
+    const std::optional<MeshCacheKey> CacheKey = Options.bUseMeshCache ?
+        CreateMeshCacheKey(InMeshFilePath, Options.VertexWeldTolerance, Options.BVHOptions, Options.CacheCompression) : std::nullopt;
+    const fs::path CachePath = GetMeshCachePath(InMeshFilePath, Options.MeshCacheDirectory);
+    if (CacheKey && LoadCache(CachePath, InMeshFilePath, *CacheKey, Options)) {
+        SetProgress("Done", 1);
+        return;
+    }
+
+    SetProgress("Reading", 0.05f);
+    MeshData Data;
+    const bool bIsLoaded = Load(InMeshFilePath, Data);
+    SetProgress("Merging vertices", 0.35f);
+    DeduplicateVertices(Data, Options.VertexWeldTolerance);
+    SetProgress("Building half-edges", 0.45f);
+    CreatePolyMesh(Data, M);
+
+    SetProgress("Computing normals", 0.6f);
+    RequestProperties();
+    SetFaceColor(Options.FaceColor);
     M.update_normals();
 
+    SetProgress("Building BVH", 0.7f);
     MeshBBox = ComputeBbox();
-    MeshBVH = std::make_shared<BVH>(CreateFaceBoundingBoxes());
+    RebuildBVH(Options.BVHOptions, Options.BVHQueryType);
+
+    if (CacheKey && bIsLoaded) {
+        SetProgress("Saving cache", 0.9f);
+        SaveCache(CachePath, InMeshFilePath, *CacheKey);
+    }
+    SetProgress("Done", 1);
+}
+
+MeshLoadOptions Mesh::GetLoadOptions()
+{
+    MeshLoadOptions Options;
+    Options.VertexWeldTolerance = VertexWeldTolerance;
+    Options.BVHOptions = BVHOptions;
+    Options.BVHRebuildThreshold = BVHRebuildThreshold;
+    Options.BVHQueryType = BVHQueryType;
+    Options.bUseMeshCache = bUseMeshCache;
+    Options.MeshCacheDirectory = MeshCacheDirectory;
+    if (bCompressMeshCache) Options.CacheCompression = MeshCacheCodecOptions;
+    Options.FaceColor = FaceColor;
+    return Options;
 }
 
 Mesh::~Mesh()
@@ -40,141 +251,507 @@ Mesh::~Mesh()
     M.release_face_colors();
 }
 
-bool Mesh::Load(const fs::path& InMeshFilePath, PolyMesh& OutMesh)
+bool Mesh::Load(const fs::path& InMeshFilePath, MeshData& OutData)
 {
+    const auto StartTime = std::chrono::steady_clock::now();
+    if (ReadMeshFile(InMeshFilePath, OutData)) {
+        const auto ElapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+        LOG_INFO("Read {0} vertices and {1} faces in {2} ms", OutData.GetVertexCount(), OutData.GetFaceCount(), ElapsedMs);
+        return true;
+    }
+
+    PolyMesh FileMesh;
     OpenMesh::IO::Options ReadOptions;
-    if (!OpenMesh::IO::read_mesh(OutMesh, InMeshFilePath.string(), ReadOptions)) {
+    if (!OpenMesh::IO::read_mesh(FileMesh, InMeshFilePath.string(), ReadOptions)) {
         std::cerr << "Error loading mesh: " << InMeshFilePath << "\n";
         return false;
     }
+
+    OutData.Positions.assign(reinterpret_cast<const glm::vec3*>(FileMesh.points()), reinterpret_cast<const glm::vec3*>(FileMesh.points()) + FileMesh.n_vertices());
+    OutData.FaceOffsets.reserve(FileMesh.n_faces() + 1);
+    for (const auto& FaceHandle : FileMesh.faces())
+    {
+        for (const auto& VertexHandle : FileMesh.fv_range(FaceHandle)) OutData.FaceVertices.emplace_back(VertexHandle.idx());
+        OutData.FaceOffsets.emplace_back(static_cast<uint>(OutData.FaceVertices.size()));
+    }
     return true;
 }
 
-struct VertexHash {
-    size_t operator()(const Point& p) const
+void Mesh::DeduplicateVertices(MeshData& Data, float WeldTolerance)
+{
+    if (WeldTolerance <= 0) {
+        RemapVertices(CreateExactVertexRemap(Data.Positions.data(), Data.Positions.size()), Data);
+        return;
+    }
+
+    BoundingBox Bounds;
+    for (const auto& Position : Data.Positions)
     {
-        return std::hash<float>{}(p[0]) ^ std::hash<float>{}(p[1]) ^ std::hash<float>{}(p[2]);
+        Bounds.Min = glm::min(Bounds.Min, Position);
+        Bounds.Max = glm::max(Bounds.Max, Position);
     }
-};
+    RemapVertices(CreateWeldVertexRemap(Data.Positions.data(), Data.Positions.size(), WeldTolerance * Bounds.DiagonalLength(), Bounds), Data);
+}
 
-Mesh::PolyMesh Mesh::DeduplicateVertices()
+void Mesh::RemapVertices(const VertexRemap& Remap, MeshData& Data)
 {
-    PolyMesh Deduped;
-    
-    std::unordered_map<Point, VH, VertexHash> UniqueVertices;
-    // Add unique vertices.
-    for (auto VertexIter = M.vertices_begin(); VertexIter != M.vertices_end(); ++VertexIter)
+    // Keep unique vertices, at the position of their first occurrence. New indices never exceed old ones, so this works in place.
+    const uint VertexCount = Data.GetVertexCount();
+    for (uint Vertex = 0, UniqueCount = 0; Vertex < VertexCount; ++Vertex)
     {
-        const auto Point = M.point(*VertexIter);
-        if (auto [Iter, bIsInserted] = UniqueVertices.try_emplace(Point, VH()); bIsInserted) {
-            Iter->second = Deduped.add_vertex(Point);
-        }
+        if (Remap.NewIndices[Vertex] == UniqueCount) Data.Positions[UniqueCount++] = Data.Positions[Vertex];
     }
-    
-    // Add faces.
-    for (const auto& FaceHandle : M.faces())
+    Data.Positions.resize(Remap.UniqueCount);
+
+    // Merged neighbouring corners (e.g. a welded short edge) become one corner, so faces can only shrink.
+    uint FaceCount = 0, CornerCount = 0, DegenerateFaceCount = 0;
+    for (uint Face = 0; Face < Data.GetFaceCount(); ++Face)
     {
-        std::vector<VH> NewFace;
-        
-        NewFace.reserve(M.valence(FaceHandle));
-        for (const auto& VertexHandle : M.fv_range(FaceHandle))
+        const uint First = CornerCount;
+        for (uint Corner = Data.FaceOffsets[Face]; Corner < Data.FaceOffsets[Face + 1]; ++Corner)
         {
-            NewFace.emplace_back(UniqueVertices.at(M.point(VertexHandle)));
+            const uint NewVertex = Remap.NewIndices[Data.FaceVertices[Corner]];
+            if (CornerCount == First || Data.FaceVertices[CornerCount - 1] != NewVertex) Data.FaceVertices[CornerCount++] = NewVertex;
         }
-        
-        Deduped.add_face(NewFace);
+        while (CornerCount - First > 1 && Data.FaceVertices[CornerCount - 1] == Data.FaceVertices[First]) --CornerCount;
+
+        if (CornerCount - First < 3) {
+            CornerCount = First;
+            ++DegenerateFaceCount;
+            continue;
+        }
+        Data.FaceOffsets[++FaceCount] = CornerCount;
+    }
+    Data.FaceOffsets.resize(FaceCount + 1);
+    Data.FaceVertices.resize(CornerCount);
+
+    if (Remap.UniqueCount < VertexCount) {
+        LOG_INFO("Merged {0} vertices into {1}, dropped {2} degenerate faces", VertexCount, Remap.UniqueCount, DegenerateFaceCount);
     }
-    
-    return Deduped;
 }
 
-struct VerticesHandle {
-    Mesh::ElementIndex Parent; // A vertex can belong to itself, an edge, or a face.
-    std::vector<Mesh::VH> VHs;
-};
+void Mesh::CreatePolyMesh(const MeshData& Data, PolyMesh& OutMesh)
+{
+    OutMesh.clean();
+    HalfedgeConnectivity Connectivity;
+    if (!CreateHalfedgeConnectivity(Data, Connectivity)) {
+        // Let OpenMesh resolve (or skip) non-manifold faces.
+        LOG_WARN("Mesh is not manifold, adding its faces one by one");
+        OutMesh.reserve(Data.GetVertexCount(), Data.FaceVertices.size() / 2, Data.GetFaceCount());
+        for (const auto& Position : Data.Positions) OutMesh.add_vertex(ToOpenMesh(Position));
 
-std::vector<MeshVertex> Mesh::CreateVertices(MeshElementType RenderElementType, const ElementIndex& Highlight) const
+        std::vector<VH> FaceVertexHandles;
+        for (uint Face = 0; Face < Data.GetFaceCount(); ++Face)
+        {
+            FaceVertexHandles.clear();
+            for (uint Corner = Data.FaceOffsets[Face]; Corner < Data.FaceOffsets[Face + 1]; ++Corner) FaceVertexHandles.emplace_back(int(Data.FaceVertices[Corner]));
+            OutMesh.add_face(FaceVertexHandles);
+        }
+        return;
+    }
+
+    OutMesh.resize(Data.GetVertexCount(), Connectivity.EdgeCount, Data.GetFaceCount());
+    SetHalfedgeConnectivity(OutMesh, Data.Positions.data(), Connectivity.VertexHalfedges.data(), Connectivity.FaceHalfedges.data(),
+                            Connectivity.ToVertices.data(), Connectivity.NextHalfedges.data(), Connectivity.Faces.data());
+}
+
+MeshData Mesh::CreateMeshData() const
 {
-    std::vector<VerticesHandle> Handles;
-    
-    if (RenderElementType == MeshElementType::Vertex)
+    MeshData Data;
+    Data.Positions.resize(M.n_vertices());
+    Data.FaceOffsets.assign(M.n_faces() + 1, 0);
+    ThreadPool::Get().ParallelFor(0, M.n_vertices(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Vertex = Begin; Vertex < End; ++Vertex) Data.Positions[Vertex] = GetPosition(VH{int(Vertex)});
+    });
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face) Data.FaceOffsets[Face + 1] = M.valence(FH{int(Face)});
+    });
+    std::partial_sum(Data.FaceOffsets.begin(), Data.FaceOffsets.end(), Data.FaceOffsets.begin());
+
+    Data.FaceVertices.resize(Data.FaceOffsets.back());
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
     {
-        Handles.reserve(M.n_vertices());
-        for (const auto& VertexHandle : M.vertices())
+        for (size_t Face = Begin; Face < End; ++Face)
         {
-            VerticesHandle VerticesHandle = {VertexHandle, std::vector<VH>{VertexHandle}};
-            Handles.emplace_back(VerticesHandle);
+            uint Corner = Data.FaceOffsets[Face];
+            for (const auto& VertexHandle : M.fv_range(FH{int(Face)})) Data.FaceVertices[Corner++] = VertexHandle.idx();
         }
+    });
+    return Data;
+}
+
+std::vector<std::array<uint8_t, 3>> Mesh::CreateFaceColors() const
+{
+    std::vector<std::array<uint8_t, 3>> Colors(M.n_faces());
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face)
+        {
+            const auto& Color = M.color(FH{int(Face)});
+            Colors[Face] = {Color[0], Color[1], Color[2]};
+        }
+    });
+    return Colors;
+}
+
+void Mesh::SetHalfedgeConnectivity(PolyMesh& OutMesh, const glm::vec3* Positions, const int* VertexHalfedges, const int* FaceHalfedges,
+                                   const int* ToVertices, const int* NextHalfedges, const int* HalfedgeFaces)
+{
+    ThreadPool::Get().ParallelFor(0, OutMesh.n_vertices(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Vertex = Begin; Vertex < End; ++Vertex)
+        {
+            const VH VertexHandle{int(Vertex)};
+            OutMesh.set_point(VertexHandle, ToOpenMesh(Positions[Vertex]));
+            if (VertexHalfedges[Vertex] >= 0) OutMesh.set_halfedge_handle(VertexHandle, HH{VertexHalfedges[Vertex]});
+        }
+    });
+    // `set_next_halfedge_handle` also sets the previous halfedge of the next one, which is a distinct halfedge for each call.
+    ThreadPool::Get().ParallelFor(0, OutMesh.n_halfedges(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Halfedge = Begin; Halfedge < End; ++Halfedge)
+        {
+            const HH HalfedgeHandle{int(Halfedge)};
+            OutMesh.set_vertex_handle(HalfedgeHandle, VH{ToVertices[Halfedge]});
+            OutMesh.set_next_halfedge_handle(HalfedgeHandle, HH{NextHalfedges[Halfedge]});
+            if (HalfedgeFaces[Halfedge] >= 0) OutMesh.set_face_handle(HalfedgeHandle, FH{HalfedgeFaces[Halfedge]});
+        }
+    });
+    ThreadPool::Get().ParallelFor(0, OutMesh.n_faces(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face) OutMesh.set_halfedge_handle(FH{int(Face)}, HH{FaceHalfedges[Face]});
+    });
+}
+
+bool Mesh::LoadCache(const fs::path& InCachePath, const fs::path& InSourcePath, const MeshCacheKey& Key, const MeshLoadOptions& Options)
+{
+    const auto StartTime = std::chrono::steady_clock::now();
+    const MeshCacheReader Cache(InCachePath, InSourcePath, Key);
+    if (!Cache.IsValid()) return false;
+
+    const MeshCacheHeader& Header = Cache.GetHeader();
+    const size_t VertexCount = Header.VertexCount, FaceCount = Header.FaceCount, HalfedgeCount = size_t(Header.EdgeCount) * 2;
+    const auto* Positions = Cache.GetSection<glm::vec3>(MeshCacheSection::Positions, VertexCount);
+    const auto* VertexNormals = Cache.GetSection<glm::vec3>(MeshCacheSection::VertexNormals, VertexCount);
+    const auto* TexCoords = Cache.GetSection<glm::vec2>(MeshCacheSection::TexCoords, VertexCount);
+    const auto* FaceNormals = Cache.GetSection<glm::vec3>(MeshCacheSection::FaceNormals, FaceCount);
+    const auto* VertexHalfedges = Cache.GetSection<int>(MeshCacheSection::VertexHalfedges, VertexCount);
+    const auto* FaceHalfedges = Cache.GetSection<int>(MeshCacheSection::FaceHalfedges, FaceCount);
+    const auto* ToVertices = Cache.GetSection<int>(MeshCacheSection::HalfedgeToVertices, HalfedgeCount);
+    const auto* NextHalfedges = Cache.GetSection<int>(MeshCacheSection::HalfedgeNextHalfedges, HalfedgeCount);
+    const auto* HalfedgeFaces = Cache.GetSection<int>(MeshCacheSection::HalfedgeFaces, HalfedgeCount);
+    const auto* BVHNodes = Cache.GetSection<BVH::Node>(MeshCacheSection::BVHNodes, Header.BVHNodeCount);
+    const auto* BVHPrimitiveIndices = Cache.GetSection<uint>(MeshCacheSection::BVHPrimitiveIndices, FaceCount);
+    if (!Positions || !VertexNormals || !TexCoords || !FaceNormals || !VertexHalfedges || !FaceHalfedges || !ToVertices || !NextHalfedges ||
+        !HalfedgeFaces || !BVHNodes || !BVHPrimitiveIndices) {
+        return false;
+    }
+
+    M.resize(VertexCount, Header.EdgeCount, FaceCount);
+    SetHalfedgeConnectivity(M, Positions, VertexHalfedges, FaceHalfedges, ToVertices, NextHalfedges, HalfedgeFaces);
+    RequestProperties();
+    ThreadPool::Get().ParallelFor(0, VertexCount, ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Vertex = Begin; Vertex < End; ++Vertex)
+        {
+            M.set_normal(VH{int(Vertex)}, ToOpenMesh(VertexNormals[Vertex]));
+            M.set_texcoord2D(VH{int(Vertex)}, {TexCoords[Vertex].x, TexCoords[Vertex].y});
+        }
+    });
+    ThreadPool::Get().ParallelFor(0, FaceCount, ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face) M.set_normal(FH{int(Face)}, ToOpenMesh(FaceNormals[Face]));
+    });
+    SetFaceColor(Options.FaceColor);
+
+    MeshBBox = {Header.BoundsMin, Header.BoundsMax};
+    const BVHBuildOptions CachedBVHOptions{BVHBuilder(Key.BVHBuilder), Key.BVHMaxLeafSize, Key.BVHBinCount, Options.BVHOptions.Parallel};
+    MeshBVH = std::make_shared<BVH>(std::vector<BVH::Node>(BVHNodes, BVHNodes + Header.BVHNodeCount),
+                                    std::vector<uint>(BVHPrimitiveIndices, BVHPrimitiveIndices + FaceCount), CachedBVHOptions, Header.BVHBuildSAHCost);
+    if (Header.Key.bIsCompressed && Header.Key.PositionBits > 0) {
+        // Quantization moved the positions by up to half a step, so the cached bounds may no longer contain them.
+        MeshBBox = ComputeBbox();
+        RefitBVH(CachedBVHOptions, Options.BVHRebuildThreshold, Options.BVHQueryType);
+    } else {
+        RebuildTriangleCache();
+        UpdateWideBVH(Options.BVHQueryType);
+    }
+
+    const auto ElapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+    LOG_INFO("Loaded {0} vertices and {1} faces from {2} in {3} ms", VertexCount, FaceCount, InCachePath.filename().string(), ElapsedMs);
+    return true;
+}
+
+void Mesh::SaveCache(const fs::path& InCachePath, const fs::path& InSourcePath, MeshCacheKey Key) const
+{
+    Key.SourceHash = HashFileContents(InSourcePath);
+
+    const size_t HalfedgeCount = M.n_halfedges();
+    std::vector<int> VertexHalfedges(M.n_vertices()), FaceHalfedges(M.n_faces());
+    std::vector<int> ToVertices(HalfedgeCount), NextHalfedges(HalfedgeCount), HalfedgeFaces(HalfedgeCount);
+    std::vector<glm::vec3> FaceNormals(M.n_faces());
+    std::vector<glm::vec2> TexCoords(M.n_vertices(), glm::vec2{0});
+    ThreadPool::Get().ParallelFor(0, M.n_vertices(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Vertex = Begin; Vertex < End; ++Vertex)
+        {
+            VertexHalfedges[Vertex] = M.halfedge_handle(VH{int(Vertex)}).idx();
+            if (M.has_vertex_texcoords2D()) TexCoords[Vertex] = {M.texcoord2D(VH{int(Vertex)})[0], M.texcoord2D(VH{int(Vertex)})[1]};
+        }
+    });
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face)
+        {
+            FaceHalfedges[Face] = M.halfedge_handle(FH{int(Face)}).idx();
+            FaceNormals[Face] = ToGlm(M.normal(FH{int(Face)}));
+        }
+    });
+    ThreadPool::Get().ParallelFor(0, HalfedgeCount, ConnectivityGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Halfedge = Begin; Halfedge < End; ++Halfedge)
+        {
+            const HH HalfedgeHandle{int(Halfedge)};
+            ToVertices[Halfedge] = M.to_vertex_handle(HalfedgeHandle).idx();
+            NextHalfedges[Halfedge] = M.next_halfedge_handle(HalfedgeHandle).idx();
+            HalfedgeFaces[Halfedge] = M.face_handle(HalfedgeHandle).idx();
+        }
+    });
+
+    MeshCacheHeader Header;
+    Header.Key = Key;
+    Header.VertexCount = M.n_vertices();
+    Header.EdgeCount = M.n_edges();
+    Header.FaceCount = M.n_faces();
+    Header.BVHNodeCount = static_cast<uint>(MeshBVH->GetNodes().size());
+    Header.BoundsMin = MeshBBox.Min;
+    Header.BoundsMax = MeshBBox.Max;
+    Header.BVHBuildSAHCost = MeshBVH->GetBuildSAHCost();
+
+    std::array<std::string_view, MeshCacheSectionCount> Sections;
+    const auto SetSection = [&Sections](MeshCacheSection Section, std::string_view Bytes) { Sections[static_cast<size_t>(Section)] = Bytes; };
+    SetSection(MeshCacheSection::Positions, AsBytes(M.points(), M.n_vertices()));
+    SetSection(MeshCacheSection::VertexNormals, AsBytes(M.vertex_normals(), M.n_vertices()));
+    SetSection(MeshCacheSection::TexCoords, AsBytes(TexCoords.data(), TexCoords.size()));
+    SetSection(MeshCacheSection::FaceNormals, AsBytes(FaceNormals.data(), FaceNormals.size()));
+    SetSection(MeshCacheSection::VertexHalfedges, AsBytes(VertexHalfedges.data(), VertexHalfedges.size()));
+    SetSection(MeshCacheSection::FaceHalfedges, AsBytes(FaceHalfedges.data(), FaceHalfedges.size()));
+    SetSection(MeshCacheSection::HalfedgeToVertices, AsBytes(ToVertices.data(), ToVertices.size()));
+    SetSection(MeshCacheSection::HalfedgeNextHalfedges, AsBytes(NextHalfedges.data(), NextHalfedges.size()));
+    SetSection(MeshCacheSection::HalfedgeFaces, AsBytes(HalfedgeFaces.data(), HalfedgeFaces.size()));
+    SetSection(MeshCacheSection::BVHNodes, AsBytes(MeshBVH->GetNodes().data(), MeshBVH->GetNodes().size()));
+    SetSection(MeshCacheSection::BVHPrimitiveIndices, AsBytes(MeshBVH->GetPrimitiveIndices().data(), MeshBVH->GetPrimitiveIndices().size()));
+    if (!WriteMeshCache(InCachePath, Header, Sections)) {
+        LOG_WARN("Could not write mesh cache {0}", InCachePath.string());
+    }
+}
+
+void Mesh::RequestProperties()
+{
+    M.request_vertex_normals();
+    M.request_face_normals();
+    M.request_face_colors();
+    M.request_vertex_texcoords2D();
+}
+
+std::vector<Mesh::ElementIndex> Mesh::GetElementsHighlightedWith(const ElementIndex& Highlight) const
+{
+    std::vector<ElementIndex> Elements;
+    if (const VH VertexHandle = Highlight; VertexHandle.is_valid() && size_t(VertexHandle.idx()) < M.n_vertices())
+    {
+        Elements.emplace_back(VertexHandle);
     }
-    else if (RenderElementType == MeshElementType::Edge)
+    else if (const FH FaceHandle = Highlight; FaceHandle.is_valid() && size_t(FaceHandle.idx()) < M.n_faces())
     {
-        Handles.reserve(M.n_edges() * 2);
-        for (const auto& EdgeHandle : M.edges())
+        Elements.emplace_back(FaceHandle);
+        for (const auto& HalfedgeHandle : M.fh_range(FaceHandle))
         {
-            const auto HalfEdgeHandle = M.halfedge_handle(EdgeHandle, 0);
-            VerticesHandle VerticesHandle = {EdgeHandle, std::vector<VH>{M.from_vertex_handle(HalfEdgeHandle), M.to_vertex_handle(HalfEdgeHandle)}};
-            Handles.emplace_back(VerticesHandle);
+            Elements.emplace_back(M.to_vertex_handle(HalfedgeHandle));
+            Elements.emplace_back(M.edge_handle(HalfedgeHandle));
         }
     }
-    else if (RenderElementType == MeshElementType::Face)
+    else if (const EH EdgeHandle = Highlight; EdgeHandle.is_valid() && size_t(EdgeHandle.idx()) < M.n_edges())
     {
-        Handles.reserve(M.n_faces() * 3); // Lower bound assuming all faces are triangles.
-        for (const auto& FaceHandle : M.faces())
+        const HH HalfedgeHandle = M.halfedge_handle(EdgeHandle, 0);
+        Elements.insert(Elements.end(), {ElementIndex{EdgeHandle}, ElementIndex{M.from_vertex_handle(HalfedgeHandle)}, ElementIndex{M.to_vertex_handle(HalfedgeHandle)}});
+    }
+    return Elements;
+}
+
+std::vector<char> Mesh::CreateVertices(MeshElementType RenderElementType, MeshVertexFormat Format) const
+{
+    switch (RenderElementType) {
+    case MeshElementType::Vertex: return CreateVertexStreamVertices(Format);
+    case MeshElementType::Edge: return CreateEdgeStreamVertices(Format);
+    case MeshElementType::Face: {
+        std::vector<char> VertexData;
+        CreateFaceStreams(Format, &VertexData, nullptr, nullptr);
+        return VertexData;
+    }
+    case MeshElementType::None: return {};
+    }
+    return {};
+}
+
+std::vector<char> Mesh::CreateVertexStreamVertices(MeshVertexFormat Format) const
+{
+    std::vector<char> VertexData(size_t(M.n_vertices()) * GetMeshVertexSize(Format));
+    const MeshVertexWriter Writer(Format, MeshBBox, VertexData.data());
+    ThreadPool::Get().ParallelFor(0, M.n_vertices(), RenderBufferGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Vertex = Begin; Vertex < End; ++Vertex)
         {
-            for (const auto& VertexHandle : M.fv_range(FaceHandle))
+            const VH VertexHandle{int(Vertex)};
+            Writer.Write(Vertex, GetPosition(VertexHandle), VertexColor, ToGlm(M.normal(VertexHandle)));
+        }
+    });
+    return VertexData;
+}
+
+std::vector<char> Mesh::CreateEdgeStreamVertices(MeshVertexFormat Format) const
+{
+    std::vector<char> VertexData(size_t(M.n_edges()) * 2 * GetMeshVertexSize(Format));
+    const MeshVertexWriter Writer(Format, MeshBBox, VertexData.data());
+    ThreadPool::Get().ParallelFor(0, M.n_edges(), RenderBufferGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Edge = Begin; Edge < End; ++Edge)
+        {
+            const HH HalfedgeHandle = M.halfedge_handle(EH{int(Edge)}, 0);
+            size_t Vertex = 2 * Edge;
+            for (const VH VertexHandle : {M.from_vertex_handle(HalfedgeHandle), M.to_vertex_handle(HalfedgeHandle)})
             {
-                VerticesHandle VerticesHandle = {FaceHandle, std::vector<VH>{VertexHandle}};
-                Handles.emplace_back(VerticesHandle);
+                Writer.Write(Vertex++, GetPosition(VertexHandle), EdgeColor, ToGlm(M.normal(VertexHandle)));
             }
         }
+    });
+    return VertexData;
+}
+
+std::shared_ptr<const std::vector<uint>> Mesh::GetFaceOffsets() const
+{
+    // Concurrent first uses may both compute the offsets, which is wasteful but harmless.
+    auto Offsets = std::atomic_load(&MeshFaceOffsets);
+    if (!Offsets)
+    {
+        auto NewOffsets = std::make_shared<std::vector<uint>>(size_t(M.n_faces()) + 1, 0);
+        ThreadPool::Get().ParallelFor(0, M.n_faces(), RenderBufferGrainSize, [&](size_t Begin, size_t End)
+        {
+            for (size_t Face = Begin; Face < End; ++Face) (*NewOffsets)[Face + 1] = M.valence(FH{int(Face)});
+        });
+        std::partial_sum(NewOffsets->begin(), NewOffsets->end(), NewOffsets->begin());
+        Offsets = std::move(NewOffsets);
+        std::atomic_store(&MeshFaceOffsets, Offsets);
     }
+    return Offsets;
+}
 
-    static std::unordered_set<ElementIndex, MeshElementIndexHash> AllHighlights;
-    AllHighlights.clear();
-    AllHighlights.insert(HighlightedElements.begin(), HighlightedElements.end());
-    AllHighlights.emplace(Highlight);
+void Mesh::CreateFaceStreams(MeshVertexFormat Format, std::vector<char>* VertexData, std::vector<uint>* TriangleIndices, std::vector<uint>* TriangulatedFaceIndices) const
+{
+    const auto OffsetsPtr = GetFaceOffsets();
+    const std::vector<uint>& Offsets = *OffsetsPtr;
+    const size_t FaceCount = M.n_faces();
+    // Each face is a fan of `valence - 2` triangles, so a face's first triangle index follows from its first corner.
+    const size_t TriangleIndexCount = 3 * (size_t(Offsets.back()) - 2 * FaceCount);
+    if (VertexData) VertexData->resize(size_t(Offsets.back()) * GetMeshVertexSize(Format));
+    const MeshVertexWriter Writer(Format, MeshBBox, VertexData ? VertexData->data() : nullptr);
+    if (TriangleIndices) TriangleIndices->resize(TriangleIndexCount);
+    if (TriangulatedFaceIndices) TriangulatedFaceIndices->resize(TriangleIndexCount);
 
-    std::vector<MeshVertex> Vertices;
-    for (const auto& Handle : Handles)
+    ThreadPool::Get().ParallelFor(0, FaceCount, RenderBufferGrainSize, [&](size_t Begin, size_t End)
     {
-        const auto& Parent = Handle.Parent;
-        const auto Normal = ToGlm(RenderElementType == MeshElementType::Vertex || RenderElementType == MeshElementType::Edge ? M.normal(Handle.VHs[0]) : M.normal(FH(Handle.Parent)));
-        
-        for(const auto& VertexHandle : Handle.VHs)
+        for (size_t Face = Begin; Face < End; ++Face)
         {
-            const bool bIsHighLight = AllHighlights.find(VertexHandle) != AllHighlights.end()
-                || AllHighlights.find(Parent) != AllHighlights.end()
-                || (RenderElementType == MeshElementType::Face && VertexBelongsToFaceEdge(VertexHandle, Parent, Highlight))
-                || (RenderElementType == MeshElementType::Vertex && (VertexBelongsToFace(Parent, Highlight) || VertexBelongsToEdge(Parent, Highlight)))
-                || (RenderElementType == MeshElementType::Edge && EdgeBelongsToFace(Parent, Highlight));
-
-            glm::vec4 Color;
-            if(bIsHighLight)
+            const FH FaceHandle{int(Face)};
+            const uint FirstCorner = Offsets[Face], CornerCount = Offsets[Face + 1] - FirstCorner;
+            const size_t FirstIndex = 3 * (size_t(FirstCorner) - 2 * Face);
+            if (VertexData)
             {
-                Color = HighlightColor;
+                const glm::vec3 Normal = ToGlm(M.normal(FaceHandle));
+                size_t Corner = FirstCorner;
+                for (const auto& VertexHandle : M.fv_range(FaceHandle)) Writer.Write(Corner++, GetPosition(VertexHandle), FaceColor, Normal);
             }
-            else
+            if (TriangulatedFaceIndices)
             {
-                if(RenderElementType == MeshElementType::Vertex)
+                uint* Index = TriangulatedFaceIndices->data() + FirstIndex;
+                for (uint i = 1; i + 1 < CornerCount; ++i)
                 {
-                    Color = VertexColor;
+                    *Index++ = FirstCorner;
+                    *Index++ = FirstCorner + i;
+                    *Index++ = FirstCorner + i + 1;
                 }
-                else if(RenderElementType == MeshElementType::Edge)
-                {
-                    Color = EdgeColor;
-                }
-                else
+            }
+            if (TriangleIndices)
+            {
+                uint* Index = TriangleIndices->data() + FirstIndex;
+                auto FaceVertexIter = M.cfv_iter(FaceHandle);
+                const uint V0 = FaceVertexIter->idx();
+                uint V1 = (++FaceVertexIter)->idx();
+                for (++FaceVertexIter; FaceVertexIter.is_valid(); ++FaceVertexIter)
                 {
-                    Color = FaceColor;
+                    const uint V2 = FaceVertexIter->idx();
+                    *Index++ = V0;
+                    *Index++ = V1;
+                    *Index++ = V2;
+                    V1 = V2;
                 }
             }
-            
-            MeshVertex CurrentVertex = {GetPosition(VertexHandle), Color, Normal};
-            Vertices.emplace_back(CurrentVertex);
         }
-    }
+    });
+}
 
-    return Vertices;
+std::vector<uint> Mesh::CreateTriangleFaces() const
+{
+    const auto Offsets = GetFaceOffsets();
+    std::vector<uint> TriangleFaces(size_t(Offsets->back()) - 2 * size_t(M.n_faces()));
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), RenderBufferGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face)
+        {
+            std::fill(TriangleFaces.begin() + ((*Offsets)[Face] - 2 * Face), TriangleFaces.begin() + ((*Offsets)[Face + 1] - 2 * (Face + 1)), uint(Face));
+        }
+    });
+    return TriangleFaces;
+}
+
+std::vector<uint> Mesh::CreateFaceNormals() const
+{
+    std::vector<uint> FaceNormals(M.n_faces());
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), RenderBufferGrainSize, [&](size_t Begin, size_t End)
+    {
+        for (size_t Face = Begin; Face < End; ++Face) FaceNormals[Face] = PackNormal(ToGlm(M.normal(FH{int(Face)})));
+    });
+    return FaceNormals;
+}
+
+std::vector<MeshElementBuffers> Mesh::CreateElementBuffers(MeshVertexFormat Format, bool bShareFaces) const
+{
+    std::vector<MeshElementBuffers> Buffers;
+    Buffers.reserve(AllMeshElementTypes.size());
+    for (const auto ElementType : AllMeshElementTypes) Buffers.push_back({ElementType, Format, {}, {}});
+
+    const auto GetBuffers = [&](MeshElementType ElementType) -> MeshElementBuffers&
+    {
+        return *std::find_if(Buffers.begin(), Buffers.end(), [&](const auto& Element) { return Element.ElementType == ElementType; });
+    };
+    auto& VertexBuffers = GetBuffers(MeshElementType::Vertex);
+    auto& EdgeBuffers = GetBuffers(MeshElementType::Edge);
+    auto& FaceBuffers = GetBuffers(MeshElementType::Face);
+    VertexBuffers.VertexData = CreateVertexStreamVertices(Format);
+    EdgeBuffers.VertexData = CreateEdgeStreamVertices(Format);
+    EdgeBuffers.Indices = CreateEdgeIndices();
+    if (bShareFaces)
+    {
+        // Faces and vertices are both drawn as the triangles of the shared vertices, and only differ in shading.
+        FaceBuffers.bSharesVertexBuffers = true;
+        CreateFaceStreams(Format, nullptr, &VertexBuffers.Indices, nullptr);
+    }
+    else
+    {
+        CreateFaceStreams(Format, &FaceBuffers.VertexData, &VertexBuffers.Indices, &FaceBuffers.Indices);
+    }
+    return Buffers;
 }
 
 std::vector<uint> Mesh::CreateIndices(MeshElementType RenderElementType) const
@@ -187,6 +764,24 @@ std::vector<uint> Mesh::CreateIndices(MeshElementType RenderElementType) const
     }
 }
 
+void Mesh::SetPositions(const std::vector<glm::vec3>& Positions)
+{
+    if (Positions.size() != M.n_vertices())
+    {
+        throw std::runtime_error("Positions count does not match vertex count");
+    }
+
+    for (const auto& VertexHandle : M.vertices())
+    {
+        M.set_point(VertexHandle, ToOpenMesh(Positions[VertexHandle.idx()]));
+    }
+    M.update_normals();
+
+    MeshBBox = ComputeBbox();
+    std::atomic_store(&MeshVertexTree, std::shared_ptr<const KDTree>{});
+    RefitBVH();
+}
+
 void Mesh::SetTextureCoordinates(const std::vector<glm::vec2>& InTexCoords)
 {
     if (InTexCoords.size() != M.n_vertices())
@@ -205,54 +800,21 @@ void Mesh::SetTextureCoordinates(const std::vector<glm::vec2>& InTexCoords)
 std::vector<uint> Mesh::CreateTriangleIndices() const
 {
     std::vector<uint> Indices;
-    
-    for (const auto& FaceHandle : M.faces())
-    {
-        auto FaceVertexIter = M.cfv_iter(FaceHandle);
-        const VH V0 = *FaceVertexIter++;
-        VH V1 = *FaceVertexIter++;
-        VH V2;
-        for (; FaceVertexIter.is_valid(); ++FaceVertexIter)
-        {
-            V2 = *FaceVertexIter;
-            Indices.insert(Indices.end(), {static_cast<uint>(V0.idx()), static_cast<uint>(V1.idx()), static_cast<uint>(V2.idx())});
-            V1 = V2;
-        }
-    }
-    
+    CreateFaceStreams(MeshVertexFormat::Float, nullptr, &Indices, nullptr);
     return Indices;
 }
 
 std::vector<uint> Mesh::CreateTriangulatedFaceIndices() const
 {
     std::vector<uint> Indices;
-    
-    uint Index = 0;
-    for (const auto& FaceHandle : M.faces())
-    {
-        const auto Valence = M.valence(FaceHandle);
-        for (uint i = 0; i < Valence - 2; ++i)
-        {
-            Indices.insert(Indices.end(), {Index, Index + i + 1, Index + i + 2});
-        }
-        
-        Index += Valence;
-    }
-    
+    CreateFaceStreams(MeshVertexFormat::Float, nullptr, nullptr, &Indices);
     return Indices;
 }
 
 std::vector<uint> Mesh::CreateEdgeIndices() const
 {
-    std::vector<uint> Indices;
-    
-    Indices.reserve(M.n_edges() * 2);
-    for (uint i = 0; i < M.n_edges(); ++i)
-    {
-        Indices.push_back(2 * i);
-        Indices.push_back(2 * i + 1);
-    }
-    
+    std::vector<uint> Indices(size_t(M.n_edges()) * 2);
+    std::iota(Indices.begin(), Indices.end(), 0u);
     return Indices;
 }
 
@@ -267,18 +829,139 @@ BoundingBox Mesh::ComputeBbox() const
     return bbox;
 }
 
-std::vector<BoundingBox> Mesh::CreateFaceBoundingBoxes() const {
-    std::vector<BoundingBox> boxes;
-    boxes.reserve(M.n_faces());
-    for (const auto &fh : M.faces()) {
-        BoundingBox box;
-        for (const auto &vh : M.fv_range(fh)) {
-            const auto &point = M.point(vh);
-            box.Min = glm::min(box.Min, ToGlm(point));
-            box.Max = glm::max(box.Max, ToGlm(point));
+void Mesh::RebuildBVH(const BVHBuildOptions& Options, BVHType QueryType)
+{
+    MeshBVH = std::make_shared<BVH>(CreateFaceBoundingBoxes(), Options);
+    RebuildTriangleCache();
+    MeshBVH4.reset();
+    MeshBVH8.reset();
+    UpdateWideBVH(QueryType);
+}
+
+bool Mesh::RefitBVH(const BVHBuildOptions& Options, float RebuildThreshold, BVHType QueryType)
+{
+    // Mesh copies share their acceleration structures, so refit a private copy.
+    if(MeshBVH.use_count() > 1)
+    {
+        MeshBVH = std::make_shared<BVH>(*MeshBVH);
+    }
+    MeshBVH->Refit(CreateFaceBoundingBoxes());
+    if(MeshBVH->GetSAHDegradation() > RebuildThreshold)
+    {
+        LOG_INFO("BVH SAH cost grew by {0}x after refit, rebuilding", MeshBVH->GetSAHDegradation());
+        RebuildBVH(Options, QueryType);
+        return true;
+    }
+
+    // Triangle order follows the unchanged BVH primitive order, and wide BVHs are cheap to collapse again.
+    RebuildTriangleCache();
+    MeshBVH4.reset();
+    MeshBVH8.reset();
+    UpdateWideBVH(QueryType);
+    return false;
+}
+
+void Mesh::RebuildTriangleCache()
+{
+    // Face vertex lists, for fan-triangulating each face into the cache.
+    std::vector<uint> FaceOffsets(M.n_faces() + 1, 0);
+    for(const auto& FaceHandle : M.faces()) FaceOffsets[FaceHandle.idx() + 1] = FaceOffsets[FaceHandle.idx()] + M.valence(FaceHandle);
+    std::vector<uint> FaceVertices(FaceOffsets.back());
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), BVH::ParallelGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t FaceIndex = Begin; FaceIndex < End; ++FaceIndex)
+        {
+            uint Index = FaceOffsets[FaceIndex];
+            for(const auto& VertexHandle : M.fv_range(FH(int(FaceIndex)))) FaceVertices[Index++] = VertexHandle.idx();
         }
-        boxes.push_back(box);
+    });
+    MeshTriangles = std::make_shared<TriangleCache>(*MeshBVH, reinterpret_cast<const float*>(M.points()), FaceOffsets, FaceVertices);
+}
+
+std::shared_ptr<const KDTree> Mesh::GetVertexTree() const
+{
+    // Concurrent first uses may both build the tree, which is wasteful but harmless.
+    auto Tree = std::atomic_load(&MeshVertexTree);
+    if(!Tree)
+    {
+        Tree = std::make_shared<const KDTree>(reinterpret_cast<const float*>(M.points()), M.n_vertices());
+        std::atomic_store(&MeshVertexTree, Tree);
+    }
+    return Tree;
+}
+
+void Mesh::UpdateWideBVH(BVHType QueryType)
+{
+    if(QueryType == BVHType::BVH4)
+    {
+        if(!MeshBVH4) MeshBVH4 = std::make_shared<BVH4>(*MeshBVH);
     }
+    else
+    {
+        MeshBVH4.reset();
+    }
+
+    if(QueryType == BVHType::BVH8)
+    {
+        if(!MeshBVH8) MeshBVH8 = std::make_shared<BVH8>(*MeshBVH);
+    }
+    else
+    {
+        MeshBVH8.reset();
+    }
+}
+
+std::vector<BVHBenchmarkResult> Mesh::BenchmarkBVH(uint RayCount) const
+{
+    // Rays from random points on the bounding sphere towards random points inside the bounds, with a fixed seed for comparable runs.
+    std::mt19937 Random(0);
+    std::uniform_real_distribution<float> Uniform(0.f, 1.f);
+    const glm::vec3 Center = MeshBBox.Center();
+    const float Radius = MeshBBox.DiagonalLength();
+    std::vector<Ray> Rays;
+    Rays.reserve(RayCount);
+    for(uint i = 0; i < RayCount; ++i)
+    {
+        const float Z = 2 * Uniform(Random) - 1, Phi = 2 * glm::pi<float>() * Uniform(Random);
+        const glm::vec3 Origin = Center + Radius * glm::vec3(std::sqrt(1 - Z * Z) * std::cos(Phi), std::sqrt(1 - Z * Z) * std::sin(Phi), Z);
+        const glm::vec3 Target = glm::mix(MeshBBox.Min, MeshBBox.Max, glm::vec3(Uniform(Random), Uniform(Random), Uniform(Random)));
+        Rays.emplace_back(Origin, glm::normalize(Target - Origin));
+    }
+
+    const auto Run = [&](BVHType Type, float BuildTimeMs, const auto& AccelerationStructure)
+    {
+        const auto StartTime = std::chrono::high_resolution_clock::now();
+        uint HitCount = 0;
+        for(const auto& LocalRay : Rays)
+        {
+            if(IntersectTriangles(AccelerationStructure, LocalRay)) ++HitCount;
+        }
+        const float QueryTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+        return BVHBenchmarkResult{Type, BuildTimeMs, QueryTimeMs, HitCount};
+    };
+
+    const BVH4 Wide4(*MeshBVH);
+    const BVH8 Wide8(*MeshBVH);
+    return {
+        Run(BVHType::Binary, MeshBVH->GetStats().BuildTimeMs, *MeshBVH),
+        Run(BVHType::BVH4, Wide4.GetBuildTimeMs(), Wide4),
+        Run(BVHType::BVH8, Wide8.GetBuildTimeMs(), Wide8),
+    };
+}
+
+std::vector<BoundingBox> Mesh::CreateFaceBoundingBoxes() const {
+    std::vector<BoundingBox> boxes(M.n_faces());
+    ThreadPool::Get().ParallelFor(0, M.n_faces(), BVH::ParallelGrainSize, [&](size_t begin, size_t end) {
+        for (size_t fi = begin; fi < end; ++fi) {
+            BoundingBox box;
+            for (const auto &vh : M.fv_range(FH(int(fi)))) {
+                const auto &point = M.point(vh);
+                box.Min = glm::min(box.Min, ToGlm(point));
+                box.Max = glm::max(box.Max, ToGlm(point));
+            }
+            boxes[fi] = box;
+        }
+    });
     return boxes;
 }
 
@@ -326,19 +1009,248 @@ bool Mesh::RayIntersectsFace(const Ray &ray, FH fh, float *distance_out, glm::ve
     return false;
 }
 
+std::optional<TriangleHit> Mesh::IntersectTriangles(const Ray &local_ray) const {
+    if (BVHQueryType == BVHType::BVH4 && MeshBVH4) return IntersectTriangles(*MeshBVH4, local_ray);
+    if (BVHQueryType == BVHType::BVH8 && MeshBVH8) return IntersectTriangles(*MeshBVH8, local_ray);
+    return IntersectTriangles(*MeshBVH, local_ray);
+}
+
+MeshRayHit Mesh::ToMeshRayHit(const TriangleHit &hit) const {
+    return {hit.Distance, int(MeshTriangles->GetFace(hit.Triangle)), MeshTriangles->GetFanIndex(hit.Triangle), {hit.U, hit.V}};
+}
+
+void Mesh::IntersectBatch(const glm::vec3 *origins, const glm::vec3 *directions, size_t ray_count, MeshRayHit *hits_out) const {
+    static constexpr uint Width = FloatV::Width;
+    ThreadPool::Get().ParallelFor(0, ray_count, RayBatchGrainSize, [&](size_t begin, size_t end) {
+        for (size_t first = begin; first < end; first += Width) {
+            IntersectPacket(origins + first, directions + first, uint(std::min<size_t>(Width, end - first)), hits_out + first);
+        }
+    });
+}
+
+std::vector<MeshRayHit> Mesh::IntersectBatch(const std::vector<glm::vec3> &origins, const std::vector<glm::vec3> &directions) const {
+    LINK_EDITOR_CORE_ASSERT(origins.size() == directions.size(), "Ray origin and direction counts differ");
+    std::vector<MeshRayHit> hits(origins.size());
+    IntersectBatch(origins.data(), directions.data(), origins.size(), hits.data());
+    return hits;
+}
+
+void Mesh::IntersectPacket(const glm::vec3 *origins, const glm::vec3 *directions, uint ray_count, MeshRayHit *hits_out) const {
+    static constexpr uint Width = FloatV::Width;
+    std::array<WatertightRay, Width> rays;
+    for (uint i = 0; i < ray_count; ++i) rays[i] = WatertightRay({origins[i], directions[i]});
+
+    const auto packet = ray_count > 1 ? WatertightRayPacket::Create(rays.data(), ray_count) : std::nullopt;
+    if (!packet) {
+        for (uint i = 0; i < ray_count; ++i) {
+            const auto hit = IntersectTriangles(Ray{origins[i], directions[i]});
+            hits_out[i] = hit ? ToMeshRayHit(*hit) : MeshRayHit{};
+        }
+        return;
+    }
+
+    // Inactive lanes repeat the first ray with a negative `t_max`, so they never enter a box or hit a triangle.
+    alignas(32) float lanes[7][Width];
+    for (uint i = 0; i < Width; ++i) {
+        const uint ray = i < ray_count ? i : 0;
+        const glm::vec3 inv_dir = 1.f / directions[ray];
+        for (uint axis = 0; axis < 3; ++axis) {
+            lanes[axis][i] = origins[ray][axis];
+            lanes[3 + axis][i] = inv_dir[axis];
+        }
+        lanes[6][i] = i < ray_count ? std::numeric_limits<float>::max() : -1.f;
+    }
+    const BVHRayPacket box_packet{
+        FloatV::Load(lanes[0]), FloatV::Load(lanes[1]), FloatV::Load(lanes[2]),
+        FloatV::Load(lanes[3]), FloatV::Load(lanes[4]), FloatV::Load(lanes[5]),
+    };
+    FloatV t_max = FloatV::Load(lanes[6]);
+    std::array<TriangleHit, Width> hits;
+    uint hit_lanes = 0;
+    MeshBVH->TraversePacketLeaves(box_packet, t_max, [&](uint first, uint count, FloatV &leaf_t_max) {
+        const auto [first_triangle, last_triangle] = MeshTriangles->GetTriangleRange(first, count);
+        hit_lanes |= MeshTriangles->IntersectNearest(*packet, first_triangle, last_triangle, leaf_t_max, hits.data());
+        return false;
+    });
+    for (uint i = 0; i < ray_count; ++i) {
+        hits_out[i] = (hit_lanes & (1u << i)) != 0 ? ToMeshRayHit(hits[i]) : MeshRayHit{};
+    }
+}
+
 FH Mesh::FindNearestIntersectingFace(const Ray &local_ray, glm::vec3 *nearest_intersect_point_out) const {
-    float distance = 0, min_distance = std::numeric_limits<float>::max();
-    glm::vec3 intersect_point;
-    FH nearest_face{};
-    MeshBVH->Intersect(local_ray, [&](uint fi) {
-        if (RayIntersectsFace(local_ray, FH{int(fi)}, &distance, &intersect_point) && distance < min_distance) {
-            min_distance = distance;
-            nearest_face = FH{int(fi)};
-            if (nearest_intersect_point_out) *nearest_intersect_point_out = intersect_point;
+    const auto nearest = IntersectTriangles(local_ray);
+    if (!nearest) return FH{};
+
+    if (nearest_intersect_point_out) *nearest_intersect_point_out = local_ray(nearest->Distance);
+    return FH{int(MeshTriangles->GetFace(nearest->Triangle))};
+}
+
+std::vector<Mesh::ElementIndex> Mesh::FindElementsInRegion(MeshElementType ElementType, const glm::mat4& LocalToClip, const MeshSelectionRegion& Region) const
+{
+    if(ElementType == MeshElementType::None || !(Region.Min.x < Region.Max.x && Region.Min.y < Region.Max.y))
+    {
+        return {};
+    }
+
+    const Frustum RegionFrustum = Frustum::FromNDCRect(glm::inverse(LocalToClip), Region.Min, Region.Max);
+    const auto IsPointInRegion = [&](const glm::vec3& Point)
+    {
+        if(!RegionFrustum.Contains(Point)) return false;
+        if(Region.IsRectangle()) return true;
+
+        const glm::vec4 Clip = LocalToClip * glm::vec4(Point, 1);
+        const glm::vec3 NDC = glm::vec3(Clip) / Clip.w;
+        if(!Region.Lasso.empty() && !IsInsidePolygon(Region.Lasso, glm::vec2(NDC))) return false;
+        if(Region.Depth)
+        {
+            const int X = glm::clamp(int((NDC.x * 0.5f + 0.5f) * Region.DepthWidth), 0, int(Region.DepthWidth) - 1);
+            const int Y = glm::clamp(int((NDC.y * 0.5f + 0.5f) * Region.DepthHeight), 0, int(Region.DepthHeight) - 1);
+            return NDC.z * 0.5f + 0.5f <= Region.Depth[size_t(Y) * Region.DepthWidth + X] + Region.DepthBias;
+        }
+        return true;
+    };
+
+    // Vertices are shared by several faces, so each one is tested once, on first use.
+    enum : uint8_t { Untested, Outside, Inside };
+    std::vector<uint8_t> VertexStates(M.n_vertices(), Untested);
+    const auto IsVertexSelected = [&](VH VertexHandle)
+    {
+        auto& State = VertexStates[VertexHandle.idx()];
+        if(State == Untested)
+        {
+            State = IsPointInRegion(GetPosition(VertexHandle)) ? Inside : Outside;
+        }
+        return State == Inside;
+    };
+
+    std::vector<ElementIndex> Elements;
+    std::vector<bool> IsVisited(ElementType == MeshElementType::Vertex ? M.n_vertices() : ElementType == MeshElementType::Edge ? M.n_edges() : 0);
+    const auto& FaceIndices = MeshBVH->GetPrimitiveIndices();
+    MeshBVH->TraverseFrustum(RegionFrustum, [&](uint First, uint Count, bool bIsInside)
+    {
+        for(uint i = First; i < First + Count; ++i)
+        {
+            const FH FaceHandle{int(FaceIndices[i])};
+            if(bIsInside && Region.IsRectangle())
+            {
+                // The face's box is inside the frustum, so all its vertices are.
+                for(const auto& VertexHandle : M.fv_range(FaceHandle)) VertexStates[VertexHandle.idx()] = Inside;
+            }
+
+            if(ElementType == MeshElementType::Face)
+            {
+                const auto FaceVertices = M.fv_range(FaceHandle);
+                if(std::all_of(FaceVertices.begin(), FaceVertices.end(), IsVertexSelected)) Elements.emplace_back(FaceHandle);
+            }
+            else if(ElementType == MeshElementType::Vertex)
+            {
+                for(const auto& VertexHandle : M.fv_range(FaceHandle))
+                {
+                    if(IsVisited[VertexHandle.idx()]) continue;
+                    IsVisited[VertexHandle.idx()] = true;
+                    if(IsVertexSelected(VertexHandle)) Elements.emplace_back(VH(VertexHandle));
+                }
+            }
+            else if(ElementType == MeshElementType::Edge)
+            {
+                for(const auto& EdgeHandle : M.fe_range(FaceHandle))
+                {
+                    if(IsVisited[EdgeHandle.idx()]) continue;
+                    IsVisited[EdgeHandle.idx()] = true;
+                    const auto HalfEdgeHandle = M.halfedge_handle(EdgeHandle, 0);
+                    if(IsVertexSelected(M.from_vertex_handle(HalfEdgeHandle)) && IsVertexSelected(M.to_vertex_handle(HalfEdgeHandle)))
+                    {
+                        Elements.emplace_back(EH(EdgeHandle));
+                    }
+                }
+            }
+        }
+    });
+
+    std::sort(Elements.begin(), Elements.end());
+    return Elements;
+}
+
+std::vector<std::pair<FH, FH>> Mesh::FindIntersectingFaces(const Mesh& Other, const glm::mat4& OtherToLocal) const
+{
+    return FindIntersectingFacePairs(Other, &OtherToLocal);
+}
+
+std::vector<std::pair<FH, FH>> Mesh::FindSelfIntersectingFaces() const
+{
+    return FindIntersectingFacePairs(*this, nullptr);
+}
+
+std::vector<std::pair<FH, FH>> Mesh::FindIntersectingFacePairs(const Mesh& Other, const glm::mat4* OtherToLocal) const
+{
+    const bool bIsSelf = &Other == this;
+    const TriangleCache& OtherTriangles = *Other.MeshTriangles;
+    const auto RootPairs = MeshBVH->SplitOverlapTraversal(*Other.MeshBVH, OtherToLocal, ThreadPool::Get().GetThreadCount() * OverlapTasksPerThread);
+
+    std::vector<std::pair<FH, FH>> FacePairs;
+    std::mutex FacePairsMutex;
+    ThreadPool::Get().ParallelFor(0, RootPairs.size(), 1, [&](size_t Begin, size_t End)
+    {
+        std::vector<std::pair<FH, FH>> TaskFacePairs;
+        std::vector<std::array<glm::vec3, 3>> OtherLeafTriangles;
+        for(size_t i = Begin; i < End; ++i)
+        {
+            MeshBVH->TraverseOverlaps(*Other.MeshBVH, OtherToLocal, RootPairs[i], [&](uint First, uint Count, uint OtherFirst, uint OtherCount)
+            {
+                const auto [FirstTriangle, LastTriangle] = MeshTriangles->GetTriangleRange(First, Count);
+                const auto [OtherFirstTriangle, OtherLastTriangle] = OtherTriangles.GetTriangleRange(OtherFirst, OtherCount);
+                // Transform the other leaf's triangles once, rather than for each pair.
+                OtherLeafTriangles.resize(OtherLastTriangle - OtherFirstTriangle);
+                for(uint Triangle = OtherFirstTriangle; Triangle < OtherLastTriangle; ++Triangle)
+                {
+                    for(uint Corner = 0; Corner < 3; ++Corner)
+                    {
+                        const glm::vec3 Vertex = OtherTriangles.GetVertex(Triangle, Corner);
+                        OtherLeafTriangles[Triangle - OtherFirstTriangle][Corner] = OtherToLocal ? glm::vec3(*OtherToLocal * glm::vec4(Vertex, 1)) : Vertex;
+                    }
+                }
+
+                // A leaf paired with itself only needs each unordered triangle pair once.
+                const bool bIsSameLeaf = bIsSelf && First == OtherFirst;
+                for(uint Triangle = FirstTriangle; Triangle < LastTriangle; ++Triangle)
+                {
+                    const std::array<glm::vec3, 3> Vertices{MeshTriangles->GetVertex(Triangle, 0), MeshTriangles->GetVertex(Triangle, 1), MeshTriangles->GetVertex(Triangle, 2)};
+                    const FH FaceHandle{int(MeshTriangles->GetFace(Triangle))};
+                    for(uint OtherTriangle = bIsSameLeaf ? Triangle + 1 : OtherFirstTriangle; OtherTriangle < OtherLastTriangle; ++OtherTriangle)
+                    {
+                        const FH OtherFaceHandle{int(OtherTriangles.GetFace(OtherTriangle))};
+                        if(bIsSelf && FaceHandle == OtherFaceHandle) continue;
+                        if(!TrianglesIntersect(Vertices, OtherLeafTriangles[OtherTriangle - OtherFirstTriangle])) continue;
+                        if(bIsSelf && FacesShareVertex(FaceHandle, OtherFaceHandle)) continue;
+
+                        if(bIsSelf && OtherFaceHandle < FaceHandle) TaskFacePairs.emplace_back(OtherFaceHandle, FaceHandle);
+                        else TaskFacePairs.emplace_back(FaceHandle, OtherFaceHandle);
+                    }
+                }
+                return false;
+            });
         }
-        return false; // We want the nearest face, not just any intersecting face.
+
+        std::lock_guard<std::mutex> Lock(FacePairsMutex);
+        FacePairs.insert(FacePairs.end(), TaskFacePairs.begin(), TaskFacePairs.end());
     });
-    return nearest_face;
+
+    // Faces with several fan triangles may intersect more than once.
+    std::sort(FacePairs.begin(), FacePairs.end());
+    FacePairs.erase(std::unique(FacePairs.begin(), FacePairs.end()), FacePairs.end());
+    return FacePairs;
+}
+
+bool Mesh::FacesShareVertex(FH FaceHandle, FH OtherFaceHandle) const
+{
+    for(const auto& VertexHandle : M.fv_range(FaceHandle))
+    {
+        for(const auto& OtherVertexHandle : M.fv_range(OtherFaceHandle))
+        {
+            if(VertexHandle == OtherVertexHandle) return true;
+        }
+    }
+    return false;
 }
 
 bool Mesh::VertexBelongsToFace(VH VertexHandle, FH FaceHandle) const
@@ -382,37 +1294,84 @@ bool Mesh::EdgeBelongsToFace(EH EdgeHandle, FH FaceHandle) const
 }
 
 std::optional<float> Mesh::Intersect(const Ray &local_ray) const {
-    float distance = 0, min_distance = std::numeric_limits<float>::max();
-    MeshBVH->Intersect(local_ray, [&](uint fi) {
-        if (RayIntersectsFace(local_ray, FH{int(fi)}, &distance) && distance < min_distance) {
-            min_distance = distance;
+    const auto nearest = IntersectTriangles(local_ray);
+    return nearest ? std::make_optional(nearest->Distance) : std::nullopt;
+}
+bool Mesh::RayIntersects(const Ray &local_ray) const {
+    const WatertightRay triangle_ray(local_ray);
+    bool hit = false;
+    float t_max = std::numeric_limits<float>::max();
+    TraverseBVHLeaves(local_ray, t_max, [&](uint first, uint count, float &leaf_t_max) {
+        const auto [first_triangle, last_triangle] = MeshTriangles->GetTriangleRange(first, count);
+        return hit = MeshTriangles->IntersectAny(triangle_ray, first_triangle, last_triangle, leaf_t_max);
+    });
+    return hit;
+}
+
+MeshClosestPoint Mesh::ClosestPoint(glm::vec3 LocalPoint, float MaxDistance) const
+{
+    TriangleHit Nearest;
+    bool bIsFound = false;
+    float MaxDistanceSquare = MaxDistance * MaxDistance;
+    MeshBVH->TraverseLeavesByDistance(LocalPoint, MaxDistanceSquare, [&](uint First, uint Count, float& LeafMaxDistanceSquare)
+    {
+        const auto [FirstTriangle, LastTriangle] = MeshTriangles->GetTriangleRange(First, Count);
+        bIsFound |= MeshTriangles->ClosestPoint(LocalPoint, FirstTriangle, LastTriangle, LeafMaxDistanceSquare, Nearest);
+        return false;
+    });
+    if(!bIsFound)
+    {
+        return {};
+    }
+
+    const glm::vec3 A = MeshTriangles->GetVertex(Nearest.Triangle, 0);
+    const glm::vec3 B = MeshTriangles->GetVertex(Nearest.Triangle, 1);
+    const glm::vec3 C = MeshTriangles->GetVertex(Nearest.Triangle, 2);
+    const glm::vec3 Position = A + Nearest.U * (B - A) + Nearest.V * (C - A);
+    return {Position, Nearest.Distance, int(MeshTriangles->GetFace(Nearest.Triangle)), MeshTriangles->GetFanIndex(Nearest.Triangle), {Nearest.U, Nearest.V}};
+}
+
+void Mesh::ClosestPointBatch(const glm::vec3* LocalPoints, size_t PointCount, float MaxDistance, MeshClosestPoint* ClosestPointsOut) const
+{
+    ThreadPool::Get().ParallelFor(0, PointCount, PointBatchGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t i = Begin; i < End; ++i)
+        {
+            ClosestPointsOut[i] = ClosestPoint(LocalPoints[i], MaxDistance);
         }
-        return false; // We want the nearest intersection, not just any intersection.
     });
-    return min_distance < std::numeric_limits<float>::max() ? std::make_optional(min_distance) : std::nullopt;
 }
-bool Mesh::RayIntersects(const Ray &local_ray) const {
-    auto callback = [this, &local_ray](uint fi) { return RayIntersectsFace(local_ray, FH{int(fi)}); };
-    return MeshBVH->Intersect(local_ray, callback).has_value();
+
+std::vector<VH> Mesh::FindNearestVertices(glm::vec3 LocalPoint, uint K, float MaxDistance) const
+{
+    std::vector<VH> Vertices(K);
+    FindNearestVerticesBatch(&LocalPoint, 1, K, MaxDistance, Vertices.data());
+    Vertices.erase(std::find(Vertices.begin(), Vertices.end(), VH{}), Vertices.end());
+    return Vertices;
 }
 
-VH Mesh::FindNearestVertex(glm::vec3 WorldPoint) const
+void Mesh::FindNearestVerticesBatch(const glm::vec3* LocalPoints, size_t PointCount, uint K, float MaxDistance, VH* VerticesOut) const
 {
-    VH ClosestVertex;
-    
-    float MinDistanceSquare = std::numeric_limits<float>::max();
-    for(const auto& VertexHandle : M.vertices())
+    const auto VertexTree = GetVertexTree();
+    ThreadPool::Get().ParallelFor(0, PointCount, PointBatchGrainSize, [&](size_t Begin, size_t End)
     {
-        const glm::vec3 Diff = GetPosition(VertexHandle) - WorldPoint;
-        const float DistanceSquare = glm::dot(Diff, Diff);
-        if(DistanceSquare < MinDistanceSquare)
+        std::vector<uint> Indices(K);
+        std::vector<float> DistancesSquare(K);
+        for(size_t i = Begin; i < End; ++i)
         {
-            MinDistanceSquare = DistanceSquare;
-            ClosestVertex = VertexHandle;
+            const uint FoundCount = VertexTree->FindNearest(LocalPoints[i], K, MaxDistance * MaxDistance, Indices.data(), DistancesSquare.data());
+            for(uint j = 0; j < K; ++j)
+            {
+                VerticesOut[i * K + j] = j < FoundCount ? VH(int(Indices[j])) : VH{};
+            }
         }
-    }
+    });
+}
 
-    return ClosestVertex;
+VH Mesh::FindNearestVertex(glm::vec3 WorldPoint) const
+{
+    const auto Nearest = GetVertexTree()->FindNearest(WorldPoint);
+    return Nearest ? VH(int(*Nearest)) : VH{};
 }
 
 VH Mesh::FindNearestVertex(const Ray& LocalRay) const
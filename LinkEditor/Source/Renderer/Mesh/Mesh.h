@@ -8,17 +8,15 @@
 
 #include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
 #include "Renderer/AccelerationStructures/BVH/BVH.h"
+#include "Renderer/AccelerationStructures/WideBVH/WideBVH.h"
+#include "Renderer/AccelerationStructures/TriangleCache/TriangleCache.h"
+#include "Renderer/Mesh/MeshCodec.h"
+#include "Renderer/AccelerationStructures/KDTree/KDTree.h"
+#include "Renderer/Mesh/MeshFile.h"
+#include "Renderer/Mesh/MeshVertexFormat.h"
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
-struct MeshVertex
-{
-    glm::vec3 Position;
-    glm::vec4 Color;
-    glm::vec3 Normal;
-    glm::vec2 TexCoord;
-};
-
 enum class MeshElementType
 {
     None,
@@ -43,6 +41,16 @@ inline std::string MeshElementTypeToString(MeshElementType InElementType)
     }
 }
 
+// Vertices and indices of one element type's render buffers.
+struct MeshElementBuffers
+{
+    MeshElementType ElementType;
+    MeshVertexFormat VertexFormat;
+    std::vector<char> VertexData;
+    std::vector<uint> Indices;
+    bool bSharesVertexBuffers = false; // Drawn with the `MeshElementType::Vertex` buffers, and empty itself.
+};
+
 struct MeshElementIndex
 {
 public:
@@ -90,6 +98,81 @@ inline OpenMesh::Vec3uc ToOpenMesh(glm::vec4 Color)
 }
 
 struct Ray;
+struct VertexRemap;
+struct MeshCacheKey;
+
+// Stage and completed fraction of a mesh load, written by the loading thread and read by the UI.
+struct MeshLoadProgress
+{
+    std::atomic<const char*> Stage = "Queued";
+    std::atomic<float> Fraction = 0;
+
+    void Set(const char* InStage, float InFraction)
+    {
+        Stage = InStage;
+        Fraction = InFraction;
+    }
+};
+
+// Settings of a mesh load, copied from the `Mesh` statics with `Mesh::GetLoadOptions` when the load starts. Loads on another thread
+// only read their copy, so that the UI can change the statics meanwhile, and the cache key always matches the loaded mesh.
+struct MeshLoadOptions
+{
+    float VertexWeldTolerance = 0;
+    BVHBuildOptions BVHOptions;
+    float BVHRebuildThreshold = 0;
+    BVHType BVHQueryType = BVHType::Binary;
+    bool bUseMeshCache = false;
+    fs::path MeshCacheDirectory;
+    std::optional<MeshCodecOptions> CacheCompression; // Compressed caches if set.
+    glm::vec4 FaceColor{1};
+};
+
+struct BVHBenchmarkResult
+{
+    BVHType Type;
+    float BuildTimeMs;
+    float QueryTimeMs;
+    uint HitCount;
+};
+
+// Nearest hit of one ray of a batch query.
+struct MeshRayHit
+{
+    float Distance = std::numeric_limits<float>::infinity();
+    int Face = -1;
+    uint FanIndex = 0;              // The hit triangle spans the face's vertices `0`, `FanIndex + 1` and `FanIndex + 2`.
+    glm::vec2 Barycentrics{0};      // Barycentric coordinates of the triangle's second and third vertices.
+
+    bool IsHit() const { return Face >= 0; }
+};
+
+// Closest point on the mesh surface to a query point.
+struct MeshClosestPoint
+{
+    glm::vec3 Position{0};
+    float Distance = std::numeric_limits<float>::infinity();
+    int Face = -1;
+    uint FanIndex = 0;              // Same triangle convention as `MeshRayHit`.
+    glm::vec2 Barycentrics{0};
+
+    bool IsValid() const { return Face >= 0; }
+};
+
+// Screen region for marquee and lasso selection, in the normalized device coordinates of the query's clip transform.
+struct MeshSelectionRegion
+{
+    glm::vec2 Min{-1}, Max{1};      // Marquee rectangle. For a lasso, the bounds of the polygon.
+    std::vector<glm::vec2> Lasso;   // Lasso polygon (even-odd rule), or empty for a marquee.
+    // Optional depth buffer read back from the viewport (`DepthWidth * DepthHeight` window-space depths, bottom row first),
+    // to select only the elements that are not occluded.
+    const float* Depth = nullptr;
+    uint DepthWidth = 0, DepthHeight = 0;
+    float DepthBias = 1e-4f;        // Window-space depth tolerance of the visibility test.
+
+    static MeshSelectionRegion FromLasso(std::vector<glm::vec2> Polygon);
+    bool IsRectangle() const { return Lasso.empty() && !Depth; }
+};
 
 class Mesh
 {
@@ -123,12 +206,22 @@ public:
     };
     
 public:
-    Mesh(const fs::path& InMeshFilePath);
+    // Loads the mesh file, or its `.lkmesh` cache. Reports the load stages to `Progress`, if not null, e.g. for loads on another thread.
+    Mesh(const fs::path& InMeshFilePath, MeshLoadProgress* Progress = nullptr);
+    Mesh(const fs::path& InMeshFilePath, const MeshLoadOptions& Options, MeshLoadProgress* Progress = nullptr);
     ~Mesh();
 
-    static bool Load(const fs::path& InMeshFilePath, PolyMesh& OutMesh);
-
-    PolyMesh DeduplicateVertices();
+    // Reads positions and faces with the native readers of `ReadMeshFile`, or with OpenMesh's readers for the files they don't handle.
+    static bool Load(const fs::path& InMeshFilePath, MeshData& OutData);
+    // Snapshot of the load settings, to be taken on the thread that changes them.
+    static MeshLoadOptions GetLoadOptions();
+    // Merges duplicate vertices, or vertices within `WeldTolerance` if it is positive, and drops the faces that collapse.
+    static void DeduplicateVertices(MeshData& Data, float WeldTolerance = VertexWeldTolerance);
+    // Builds the half-edge structure of all faces at once, or adds the faces one by one if the mesh is not manifold.
+    static void CreatePolyMesh(const MeshData& Data, PolyMesh& OutMesh);
+    // Positions and faces as flat arrays, e.g. as a snapshot to write with `WriteMeshFile` in the background.
+    MeshData CreateMeshData() const;
+    std::vector<std::array<uint8_t, 3>> CreateFaceColors() const;
 
     glm::vec3 GetPosition(VH VertexHandle) const { return ToGlm(M.point(VertexHandle)); }
 
@@ -142,26 +235,74 @@ public:
         for (const auto& FH : M.faces()) SetFaceColor(FH, Color);
     }
 
-    std::vector<MeshVertex> CreateVertices(MeshElementType RenderElementType, const ElementIndex& Highlight = {}) const;
+    // Render vertices don't depend on the selection, which the mesh shaders read from a `MeshSelectionBuffer`.
+    // Quantized positions are relative to the mesh bounds, see `MeshVertexDecoding`.
+    std::vector<char> CreateVertices(MeshElementType RenderElementType, MeshVertexFormat Format = MeshVertexFormat::Float) const;
     std::vector<uint> CreateIndices(MeshElementType RenderElementType) const;
+    // Buffers of all `AllMeshElementTypes`, in order. Creates the face vertices and both triangle index streams in one pass over the faces.
+    // With `bShareFaces`, the face buffers share the vertex buffers instead.
+    std::vector<MeshElementBuffers> CreateElementBuffers(MeshVertexFormat Format = RenderVertexFormat, bool bShareFaces = bShareFaceVertices) const;
+    // Face of each triangle of `CreateTriangleIndices`, for the shaders to look up the face of `gl_PrimitiveID`.
+    std::vector<uint> CreateTriangleFaces() const;
+    // `PackNormal` of each face, for the shaders to shade faces flat without a vertex per face corner.
+    std::vector<uint> CreateFaceNormals() const;
 
     void SetTextureCoordinates(const std::vector<glm::vec2>& InTexCoords);
+    // Moves all vertices (e.g. after smoothing or baking a transform) without changing the topology, and updates normals and acceleration structures.
+    // Meshes in a scene are moved with `Scene::SetMeshPositions`, which also updates their entity bounds and render buffers.
+    void SetPositions(const std::vector<glm::vec3>& Positions);
 
     std::vector<uint> CreateTriangleIndices() const; // Triangulated face indices.
     std::vector<uint> CreateTriangulatedFaceIndices() const; // Triangle fan for each face.
     std::vector<uint> CreateEdgeIndices() const;
 
     BoundingBox ComputeBbox() const;
+    const BoundingBox& GetBoundingBox() const { return MeshBBox; }
     std::vector<BoundingBox> CreateFaceBoundingBoxes() const;
+    const BVH& GetBVH() const { return *MeshBVH; }
+    const TriangleCache& GetTriangleCache() const { return *MeshTriangles; }
+    // Also rebuilds the triangle cache, which follows the BVH's primitive order, and the wide BVH of `QueryType`.
+    void RebuildBVH(const BVHBuildOptions& Options = BVHOptions, BVHType QueryType = BVHQueryType);
+    // Refits the BVH to the current vertex positions, or rebuilds it with `Options` if the refit degraded its SAH cost by more than
+    // `RebuildThreshold`. Returns true if the BVH was rebuilt.
+    bool RefitBVH(const BVHBuildOptions& Options = BVHOptions, float RebuildThreshold = BVHRebuildThreshold, BVHType QueryType = BVHQueryType);
+    void UpdateWideBVH(BVHType QueryType = BVHQueryType); // Collapses the wide BVH selected by `QueryType`, and releases the unused ones.
+    // Times nearest-face queries of `RayCount` random rays through the mesh bounds with each `BVHType`.
+    std::vector<BVHBenchmarkResult> BenchmarkBVH(uint RayCount) const;
 
     std::optional<float> Intersect(const Ray& LocalRay) const;
     bool RayIntersects(const Ray& LocalRay) const;
     bool RayIntersectsFace(const Ray &, FH, float *distance_out = nullptr, glm::vec3 *intersect_point_out = nullptr) const;
+    // Nearest hits of `RayCount` local-space rays. Runs across threads, and traces groups of `FloatV::Width` consecutive rays
+    // as SIMD packets when they share a dominant direction axis, so coherent rays should be passed next to each other.
+    void IntersectBatch(const glm::vec3* Origins, const glm::vec3* Directions, size_t RayCount, MeshRayHit* HitsOut) const;
+    std::vector<MeshRayHit> IntersectBatch(const std::vector<glm::vec3>& Origins, const std::vector<glm::vec3>& Directions) const;
+
+    // Closest point on the surface within `MaxDistance` of the local-space point, or an invalid result if there is none.
+    MeshClosestPoint ClosestPoint(glm::vec3 LocalPoint, float MaxDistance = std::numeric_limits<float>::infinity()) const;
+    void ClosestPointBatch(const glm::vec3* LocalPoints, size_t PointCount, float MaxDistance, MeshClosestPoint* ClosestPointsOut) const;
+    // The `K` nearest vertices within `MaxDistance` of the local-space point, nearest first.
+    std::vector<VH> FindNearestVertices(glm::vec3 LocalPoint, uint K, float MaxDistance = std::numeric_limits<float>::infinity()) const;
+    // Writes `K` vertices per point to `VerticesOut`, nearest first, padded with invalid handles.
+    void FindNearestVerticesBatch(const glm::vec3* LocalPoints, size_t PointCount, uint K, float MaxDistance, VH* VerticesOut) const;
 
     VH FindNearestVertex(glm::vec3 WorldPoint) const;
     VH FindNearestVertex(const Ray& LocalRay) const;
     EH FindNearestEdge(const Ray& WorldRay) const;
     FH FindNearestIntersectingFace(const Ray& LocalRay, glm::vec3 *NearestIntersectPointOut = nullptr) const;
+    // Elements of the given type inside the region, in increasing index order. `LocalToClip` maps mesh space to clip space
+    // (the camera's view-projection times the model matrix). Edges and faces are selected when all their vertices are.
+    std::vector<ElementIndex> FindElementsInRegion(MeshElementType ElementType, const glm::mat4& LocalToClip, const MeshSelectionRegion& Region) const;
+
+    // Pairs `{face of this mesh, face of Other}` of intersecting faces. `OtherToLocal` maps `Other`'s local space to this mesh's.
+    std::vector<std::pair<FH, FH>> FindIntersectingFaces(const Mesh& Other, const glm::mat4& OtherToLocal) const;
+    // Pairs `{f, g}` with `f < g` of intersecting faces of this mesh. Neighbouring faces (sharing a vertex) always touch, so they are skipped.
+    std::vector<std::pair<FH, FH>> FindSelfIntersectingFaces() const;
+
+    const std::vector<ElementIndex>& GetHighlightedElements() const { return HighlightedElements; }
+    void SetHighlightedElements(std::vector<ElementIndex> Elements) { HighlightedElements = std::move(Elements); }
+    // The element and the elements shown highlighted with it: the vertices of an edge, and the vertices and edges of a face.
+    std::vector<ElementIndex> GetElementsHighlightedWith(const ElementIndex& Highlight) const;
 
     bool VertexBelongsToFace(VH VertexHandle, FH FaceHandle) const;
     bool VertexBelongsToEdge(VH VertexHandle, EH EdgeHandle) const;
@@ -176,11 +317,84 @@ public:
     inline static glm::vec4 FaceNormalIndicatorColor = glm::vec4{0.133, 0.867, 0.867, 1};   // Blender's default `Preferences->Themes->3D Viewport->Face Normal`.
     inline static glm::vec4 VertexNormalIndicatorColor = glm::vec4{0.137, 0.380, 0.867, 1}; // Blender's default `Preferences->Themes->3D Viewport->Vertex Normal`.
     inline static float NormalIndicatorLengthScale = 0.25;
+    inline static float VertexWeldTolerance = 0; // Welding distance on load, relative to the bounding box diagonal. Zero merges identical positions only.
+    inline static bool bUseMeshCache = true; // Load meshes from, and save them to, `.lkmesh` caches.
+    inline static fs::path MeshCacheDirectory; // Directory of the `.lkmesh` caches. If empty, each cache sits next to its source file.
+    inline static bool bCompressMeshCache = false; // Encode `.lkmesh` caches with `MeshCacheCodecOptions`. Smaller, but decoded on load.
+    inline static MeshCodecOptions MeshCacheCodecOptions;
+    inline static BVHBuildOptions BVHOptions;
+    inline static BVHType BVHQueryType = BVHType::Binary;
+    inline static float BVHRebuildThreshold = 1.5f; // Maximum SAH cost growth accepted by `RefitBVH`.
+    inline static constexpr size_t RayBatchGrainSize = 256; // Rays per batch query task.
+    inline static constexpr size_t PointBatchGrainSize = 256; // Points per batch closest-point/nearest-vertex task.
+    inline static constexpr uint OverlapTasksPerThread = 16; // Subtree pairs per thread of mesh-mesh and self-intersection queries.
+    inline static constexpr size_t ConnectivityGrainSize = 1 << 14; // Elements per task when setting up or saving the half-edge structure.
+    inline static MeshVertexFormat RenderVertexFormat = MeshVertexFormat::Float; // Of the render buffers of meshes added to the scene.
+    inline static bool bShareFaceVertices = true; // Draw faces from the shared vertices, with normals from `CreateFaceNormals`.
+    inline static constexpr size_t RenderBufferGrainSize = 1 << 13; // Elements per task when creating render vertices and indices.
+
+private:
+    // Dispatch to the acceleration structure selected by `BVHQueryType`. The visitor is inlined into the traversal.
+    template<typename LeafVisitor>
+    void TraverseBVHLeaves(const Ray& LocalRay, float& TMax, LeafVisitor&& VisitLeaf) const
+    {
+        if(BVHQueryType == BVHType::BVH4 && MeshBVH4) return MeshBVH4->TraverseLeaves(LocalRay, TMax, VisitLeaf);
+        if(BVHQueryType == BVHType::BVH8 && MeshBVH8) return MeshBVH8->TraverseLeaves(LocalRay, TMax, VisitLeaf);
+        return MeshBVH->TraverseLeaves(LocalRay, TMax, VisitLeaf);
+    }
+
+    // Nearest hit of the ray with the cached fan triangles, using `AccelerationStructure`'s leaf traversal.
+    template<typename AccelerationStructureType>
+    std::optional<TriangleHit> IntersectTriangles(const AccelerationStructureType& AccelerationStructure, const Ray& LocalRay) const
+    {
+        const WatertightRay TriangleRay(LocalRay);
+        std::optional<TriangleHit> Nearest;
+        float TMax = std::numeric_limits<float>::max();
+        AccelerationStructure.TraverseLeaves(LocalRay, TMax, [&](uint First, uint Count, float& LeafTMax) {
+            const auto [FirstTriangle, LastTriangle] = MeshTriangles->GetTriangleRange(First, Count);
+            if(TriangleHit Hit; MeshTriangles->IntersectNearest(TriangleRay, FirstTriangle, LastTriangle, LeafTMax, Hit)) Nearest = Hit;
+            return false;
+        });
+        return Nearest;
+    }
+    std::optional<TriangleHit> IntersectTriangles(const Ray& LocalRay) const;
+    // Up to `FloatV::Width` rays of a batch query.
+    void IntersectPacket(const glm::vec3* Origins, const glm::vec3* Directions, uint RayCount, MeshRayHit* HitsOut) const;
+    MeshRayHit ToMeshRayHit(const TriangleHit& Hit) const;
+    // Shared by `FindIntersectingFaces` and `FindSelfIntersectingFaces`, with `Other` being this mesh for the latter.
+    std::vector<std::pair<FH, FH>> FindIntersectingFacePairs(const Mesh& Other, const glm::mat4* OtherToLocal) const;
+    bool FacesShareVertex(FH FaceHandle, FH OtherFaceHandle) const;
+    void RebuildTriangleCache();
+    // Merges the vertices according to the remap table, keeping the face order. Repeated corners of a face are merged, and faces left
+    // with fewer than three corners are dropped.
+    static void RemapVertices(const VertexRemap& Remap, MeshData& Data);
+    // Sets all connectivity of a mesh resized to its element counts, in parallel. Halfedges follow OpenMesh's order, and invalid
+    // handles are -1.
+    static void SetHalfedgeConnectivity(PolyMesh& OutMesh, const glm::vec3* Positions, const int* VertexHalfedges, const int* FaceHalfedges,
+                                        const int* ToVertices, const int* NextHalfedges, const int* HalfedgeFaces);
+    // Restores the mesh, its normals and its BVH from a matching `.lkmesh` cache. Returns false if there is none.
+    bool LoadCache(const fs::path& InCachePath, const fs::path& InSourcePath, const MeshCacheKey& Key, const MeshLoadOptions& Options);
+    void SaveCache(const fs::path& InCachePath, const fs::path& InSourcePath, MeshCacheKey Key) const;
+    void RequestProperties();
+    // Prefix sum of the face valences, i.e. the first vertex of each face in the face buffer, followed by the corner count.
+    // Computed on first use. The topology doesn't change after loading, so neither do the offsets.
+    std::shared_ptr<const std::vector<uint>> GetFaceOffsets() const;
+    // Creates the face corner vertices and both triangle index streams, each if not null, in one parallel pass over the faces.
+    void CreateFaceStreams(MeshVertexFormat Format, std::vector<char>* VertexData, std::vector<uint>* TriangleIndices, std::vector<uint>* TriangulatedFaceIndices) const;
+    std::vector<char> CreateVertexStreamVertices(MeshVertexFormat Format) const;
+    std::vector<char> CreateEdgeStreamVertices(MeshVertexFormat Format) const;
+    // Built on first use after the vertex positions change.
+    std::shared_ptr<const KDTree> GetVertexTree() const;
 
 private:
     PolyMesh M;
     BoundingBox MeshBBox;
     std::shared_ptr<BVH> MeshBVH;
+    std::shared_ptr<BVH4> MeshBVH4;
+    std::shared_ptr<BVH8> MeshBVH8;
+    std::shared_ptr<TriangleCache> MeshTriangles;
+    mutable std::shared_ptr<const KDTree> MeshVertexTree;
+    mutable std::shared_ptr<const std::vector<uint>> MeshFaceOffsets;
     std::vector<ElementIndex> HighlightedElements; 
 };
 
@@ -0,0 +1,248 @@
+﻿#include "MeshCache.h"
+#include "Core/Thread/ThreadPool.h"
+
+#include <cstring>
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static constexpr size_t HashChunkSize = 1 << 22;
+static constexpr uint64_t HashMultiplier1 = 0x87c37b91114253d5ull, HashMultiplier2 = 0x4cf5ad432745937full;
+
+static uint64_t RotateLeft(uint64_t Value, int Bits) { return (Value << Bits) | (Value >> (64 - Bits)); }
+
+// MurmurHash3's 64-bit finalizer.
+static uint64_t MixHash(uint64_t Hash)
+{
+    Hash ^= Hash >> 33;
+    Hash *= 0xff51afd7ed558ccdull;
+    Hash ^= Hash >> 33;
+    Hash *= 0xc4ceb9fe1a85ec53ull;
+    return Hash ^ (Hash >> 33);
+}
+
+static uint64_t HashBytes(const char* Data, size_t Size, uint64_t Seed)
+{
+    uint64_t Hash = Seed ^ (Size * HashMultiplier2);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= Size; i += sizeof(uint64_t))
+    {
+        uint64_t Word;
+        std::memcpy(&Word, Data + i, sizeof(Word));
+        Hash = RotateLeft(Hash ^ (Word * HashMultiplier1), 31) * HashMultiplier2;
+    }
+    uint64_t Tail = 0;
+    std::memcpy(&Tail, Data + i, Size - i);
+    return MixHash(RotateLeft(Hash ^ (Tail * HashMultiplier1), 31) * HashMultiplier2);
+}
+
+static uint64_t AlignUp(uint64_t Offset) { return (Offset + MeshCacheAlignment - 1) / MeshCacheAlignment * MeshCacheAlignment; }
+
+// Positions and normals are quantized as the key asks, float arrays are split into byte planes, and integer arrays are delta coded.
+static std::vector<char> EncodeSection(MeshCacheSection Section, std::string_view Bytes, const MeshCacheHeader& Header)
+{
+    switch(Section)
+    {
+    case MeshCacheSection::Positions:
+        return EncodePositions(reinterpret_cast<const glm::vec3*>(Bytes.data()), Bytes.size() / sizeof(glm::vec3), {Header.BoundsMin, Header.BoundsMax},
+                               Header.Key.PositionBits);
+    case MeshCacheSection::VertexNormals:
+    case MeshCacheSection::FaceNormals:
+        return EncodeNormals(reinterpret_cast<const glm::vec3*>(Bytes.data()), Bytes.size() / sizeof(glm::vec3), Header.Key.NormalBits);
+    case MeshCacheSection::TexCoords:
+    case MeshCacheSection::BVHNodes:
+        return EncodeBytes(Bytes.data(), Bytes.size(), sizeof(float));
+    default:
+        return EncodeIndices(reinterpret_cast<const uint*>(Bytes.data()), Bytes.size() / sizeof(uint));
+    }
+}
+
+static bool DecodeSection(MeshCacheSection Section, std::string_view Encoded, std::vector<char>& Decoded)
+{
+    switch(Section)
+    {
+    case MeshCacheSection::Positions:
+        return Decoded.size() % sizeof(glm::vec3) == 0 &&
+               DecodePositions(Encoded, reinterpret_cast<glm::vec3*>(Decoded.data()), Decoded.size() / sizeof(glm::vec3));
+    case MeshCacheSection::VertexNormals:
+    case MeshCacheSection::FaceNormals:
+        return Decoded.size() % sizeof(glm::vec3) == 0 &&
+               DecodeNormals(Encoded, reinterpret_cast<glm::vec3*>(Decoded.data()), Decoded.size() / sizeof(glm::vec3));
+    case MeshCacheSection::TexCoords:
+    case MeshCacheSection::BVHNodes:
+        return DecodeBytes(Encoded, Decoded.data(), Decoded.size());
+    default:
+        return Decoded.size() % sizeof(uint) == 0 && DecodeIndices(Encoded, reinterpret_cast<uint*>(Decoded.data()), Decoded.size() / sizeof(uint));
+    }
+}
+
+// Size of a section's plain values, from the element counts in the header.
+static uint64_t GetSectionRawSize(MeshCacheSection Section, const MeshCacheHeader& Header)
+{
+    const uint64_t VertexCount = Header.VertexCount, FaceCount = Header.FaceCount, HalfedgeCount = uint64_t(Header.EdgeCount) * 2;
+    switch(Section)
+    {
+    case MeshCacheSection::Positions:
+    case MeshCacheSection::VertexNormals:
+        return VertexCount * sizeof(glm::vec3);
+    case MeshCacheSection::TexCoords:
+        return VertexCount * sizeof(glm::vec2);
+    case MeshCacheSection::FaceNormals:
+        return FaceCount * sizeof(glm::vec3);
+    case MeshCacheSection::VertexHalfedges:
+        return VertexCount * sizeof(int);
+    case MeshCacheSection::FaceHalfedges:
+        return FaceCount * sizeof(int);
+    case MeshCacheSection::BVHNodes:
+        return uint64_t(Header.BVHNodeCount) * sizeof(BVH::Node);
+    case MeshCacheSection::BVHPrimitiveIndices:
+        return FaceCount * sizeof(uint);
+    default:
+        return HalfedgeCount * sizeof(int);
+    }
+}
+
+fs::path GetMeshCachePath(const fs::path& InSourcePath, const fs::path& CacheDirectory)
+{
+    if(CacheDirectory.empty())
+    {
+        fs::path CachePath = InSourcePath;
+        return CachePath += ".lkmesh";
+    }
+
+    std::error_code Error;
+    const std::string AbsolutePath = fs::absolute(InSourcePath, Error).generic_string();
+    char PathHash[17];
+    std::snprintf(PathHash, sizeof(PathHash), "%016llx", static_cast<unsigned long long>(HashBytes(AbsolutePath.data(), AbsolutePath.size(), 0)));
+    return CacheDirectory / (InSourcePath.stem().string() + "-" + PathHash + ".lkmesh");
+}
+
+std::optional<MeshCacheKey> CreateMeshCacheKey(const fs::path& InSourcePath, float VertexWeldTolerance, const BVHBuildOptions& Options,
+                                               const std::optional<MeshCodecOptions>& Compression)
+{
+    std::error_code Error;
+    MeshCacheKey Key;
+    Key.SourceSize = fs::file_size(InSourcePath, Error);
+    if(Error) return {};
+    Key.SourceWriteTime = fs::last_write_time(InSourcePath, Error).time_since_epoch().count();
+    if(Error) return {};
+
+    Key.VertexWeldTolerance = VertexWeldTolerance;
+    Key.BVHBuilder = static_cast<uint>(Options.Builder);
+    Key.BVHMaxLeafSize = Options.MaxLeafSize;
+    Key.BVHBinCount = Options.BinCount;
+    if(Compression)
+    {
+        Key.bIsCompressed = 1;
+        Key.PositionBits = Compression->PositionBits;
+        Key.NormalBits = Compression->NormalBits;
+    }
+    return Key;
+}
+
+uint64_t HashFileContents(const fs::path& InFilePath)
+{
+    const MappedFile File(InFilePath);
+    if(!File.IsOpen()) return 0;
+
+    const size_t ChunkCount = (File.GetSize() + HashChunkSize - 1) / HashChunkSize;
+    std::vector<uint64_t> ChunkHashes(ChunkCount);
+    ThreadPool::Get().ParallelFor(0, ChunkCount, 1, [&](size_t Begin, size_t End)
+    {
+        for(size_t Chunk = Begin; Chunk < End; ++Chunk)
+        {
+            const size_t Offset = Chunk * HashChunkSize;
+            ChunkHashes[Chunk] = HashBytes(File.GetData() + Offset, std::min(HashChunkSize, File.GetSize() - Offset), Chunk);
+        }
+    });
+
+    uint64_t Hash = File.GetSize();
+    for(const uint64_t ChunkHash : ChunkHashes) Hash = MixHash(Hash * HashMultiplier1 ^ ChunkHash);
+    return Hash;
+}
+
+MeshCacheReader::MeshCacheReader(const fs::path& InCachePath, const fs::path& InSourcePath, const MeshCacheKey& Key) : File(InCachePath)
+{
+    if(!File.IsOpen() || File.GetSize() < sizeof(MeshCacheHeader)) return;
+
+    // The mapping is page-aligned, so the header and the aligned sections can be read in place.
+    const auto* FileHeader = reinterpret_cast<const MeshCacheHeader*>(File.GetData());
+    if(FileHeader->Magic != MeshCacheMagic || FileHeader->Version != MeshCacheVersion || FileHeader->HeaderSize != sizeof(MeshCacheHeader)) return;
+    for(size_t Section = 0; Section < MeshCacheSectionCount; ++Section)
+    {
+        const uint64_t Offset = FileHeader->SectionOffsets[Section], Size = FileHeader->SectionSizes[Section];
+        if(Offset % MeshCacheAlignment != 0 || Offset > File.GetSize() || Size > File.GetSize() - Offset) return;
+    }
+
+    const MeshCacheKey& CachedKey = FileHeader->Key;
+    if(CachedKey.SourceSize != Key.SourceSize || CachedKey.VertexWeldTolerance != Key.VertexWeldTolerance ||
+       CachedKey.BVHBuilder != Key.BVHBuilder || CachedKey.BVHMaxLeafSize != Key.BVHMaxLeafSize || CachedKey.BVHBinCount != Key.BVHBinCount ||
+       CachedKey.bIsCompressed != Key.bIsCompressed || CachedKey.PositionBits != Key.PositionBits || CachedKey.NormalBits != Key.NormalBits) return;
+    if(CachedKey.SourceWriteTime != Key.SourceWriteTime && CachedKey.SourceHash != HashFileContents(InSourcePath)) return;
+
+    if(CachedKey.bIsCompressed)
+    {
+        for(size_t Section = 0; Section < MeshCacheSectionCount; ++Section)
+        {
+            if(FileHeader->SectionRawSizes[Section] != GetSectionRawSize(static_cast<MeshCacheSection>(Section), *FileHeader)) return;
+            DecodedSections[Section].resize(FileHeader->SectionRawSizes[Section]);
+            const std::string_view Encoded{File.GetData() + FileHeader->SectionOffsets[Section], FileHeader->SectionSizes[Section]};
+            if(!DecodeSection(static_cast<MeshCacheSection>(Section), Encoded, DecodedSections[Section])) return;
+        }
+    }
+    else if(FileHeader->SectionSizes != FileHeader->SectionRawSizes) return;
+
+    Header = FileHeader;
+}
+
+bool WriteMeshCache(const fs::path& InCachePath, MeshCacheHeader Header, const std::array<std::string_view, MeshCacheSectionCount>& RawSections)
+{
+    std::array<std::string_view, MeshCacheSectionCount> Sections = RawSections;
+    std::array<std::vector<char>, MeshCacheSectionCount> EncodedSections;
+    uint64_t Offset = AlignUp(sizeof(MeshCacheHeader));
+    for(size_t Section = 0; Section < MeshCacheSectionCount; ++Section)
+    {
+        Header.SectionRawSizes[Section] = RawSections[Section].size();
+        if(Header.Key.bIsCompressed)
+        {
+            EncodedSections[Section] = EncodeSection(static_cast<MeshCacheSection>(Section), RawSections[Section], Header);
+            Sections[Section] = {EncodedSections[Section].data(), EncodedSections[Section].size()};
+        }
+        Header.SectionOffsets[Section] = Offset;
+        Header.SectionSizes[Section] = Sections[Section].size();
+        Offset = AlignUp(Offset + Sections[Section].size());
+    }
+
+    std::error_code Error;
+    if(InCachePath.has_parent_path()) fs::create_directories(InCachePath.parent_path(), Error);
+    fs::path TempPath = InCachePath;
+    TempPath += ".tmp";
+    {
+        std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+        if(!File) return false;
+
+        static constexpr std::array<char, MeshCacheAlignment> Padding{};
+        const auto WritePadded = [&](const char* Data, size_t Size)
+        {
+            File.write(Data, static_cast<std::streamsize>(Size));
+            File.write(Padding.data(), static_cast<std::streamsize>(AlignUp(Size) - Size));
+        };
+        WritePadded(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        for(const auto& Section : Sections) WritePadded(Section.data(), Section.size());
+        if(!File)
+        {
+            File.close();
+            fs::remove(TempPath, Error);
+            return false;
+        }
+    }
+
+    fs::rename(TempPath, InCachePath, Error);
+    if(Error)
+    {
+        fs::remove(TempPath, Error);
+        return false;
+    }
+    return true;
+}
+
+LINK_EDITOR_NAMESPACE_END
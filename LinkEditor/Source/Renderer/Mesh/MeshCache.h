@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "Core/File/MappedFile.h"
+#include "Renderer/AccelerationStructures/BVH/BVH.h"
+#include "Renderer/Mesh/MeshCodec.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Sections of a `.lkmesh` file. Each is an array of plain values, aligned to `MeshCacheAlignment`, or its `MeshCodec` encoding in
+// compressed caches.
+enum class MeshCacheSection : uint
+{
+    Positions,              // `glm::vec3` per vertex.
+    VertexNormals,          // `glm::vec3` per vertex.
+    TexCoords,              // `glm::vec2` per vertex.
+    FaceNormals,            // `glm::vec3` per face.
+    VertexHalfedges,        // Outgoing halfedge per vertex, or -1 for isolated vertices.
+    FaceHalfedges,          // First halfedge per face.
+    HalfedgeToVertices,     // Per halfedge, in OpenMesh's order (edge `e` has the halfedges `2e` and `2e + 1`).
+    HalfedgeNextHalfedges,
+    HalfedgeFaces,          // -1 for boundary halfedges.
+    BVHNodes,               // `BVH::Node`s, root first.
+    BVHPrimitiveIndices,    // Face per BVH primitive slot.
+    Count
+};
+
+inline constexpr size_t MeshCacheSectionCount = static_cast<size_t>(MeshCacheSection::Count);
+inline constexpr size_t MeshCacheAlignment = 64;
+inline constexpr uint MeshCacheVersion = 2;
+inline constexpr std::array<char, 8> MeshCacheMagic{'L', 'K', 'M', 'E', 'S', 'H', '\0', '\0'};
+
+// The source file and load settings a cache was created from.
+struct MeshCacheKey
+{
+    uint64_t SourceSize = 0;
+    int64_t SourceWriteTime = 0;
+    uint64_t SourceHash = 0; // Hash of the source file contents. Only compared when the write time differs, e.g. after a copy.
+    float VertexWeldTolerance = 0;
+    uint BVHBuilder = 0, BVHMaxLeafSize = 0, BVHBinCount = 0;
+    uint bIsCompressed = 0, PositionBits = 0, NormalBits = 0; // Whether sections are encoded, with these `MeshCodecOptions`.
+};
+
+struct MeshCacheHeader
+{
+    std::array<char, 8> Magic = MeshCacheMagic;
+    uint Version = MeshCacheVersion;
+    uint HeaderSize = sizeof(MeshCacheHeader);
+    MeshCacheKey Key;
+    uint VertexCount = 0, EdgeCount = 0, FaceCount = 0, BVHNodeCount = 0;
+    glm::vec3 BoundsMin{0}, BoundsMax{0};
+    float BVHBuildSAHCost = 0;
+    std::array<uint64_t, MeshCacheSectionCount> SectionOffsets{}, SectionSizes{}; // In bytes, from the start of the file.
+    std::array<uint64_t, MeshCacheSectionCount> SectionRawSizes{}; // Decoded sizes, which differ from `SectionSizes` in compressed caches.
+};
+
+// Cache file path of a mesh source file: next to the source (`<source>.lkmesh`) if `CacheDirectory` is empty, and otherwise in
+// `CacheDirectory`, named after a hash of the source's absolute path.
+fs::path GetMeshCachePath(const fs::path& InSourcePath, const fs::path& CacheDirectory);
+
+// Key of the source file and settings, without the content hash, which is only computed when needed. Empty if the source can't be read.
+// Caches are compressed if `Compression` is set.
+std::optional<MeshCacheKey> CreateMeshCacheKey(const fs::path& InSourcePath, float VertexWeldTolerance, const BVHBuildOptions& Options,
+                                               const std::optional<MeshCodecOptions>& Compression);
+
+// 64-bit hash of the file contents, computed in parallel chunks. Zero if the file can't be read.
+uint64_t HashFileContents(const fs::path& InFilePath);
+
+// Memory-mapped `.lkmesh` file. Sections are read in place, or decoded in parallel on opening if the cache is compressed.
+class MeshCacheReader
+{
+public:
+    // Opens the cache if it exists, has the current version, and matches the key. The source contents are only hashed if its write
+    // time differs from the cached one.
+    MeshCacheReader(const fs::path& InCachePath, const fs::path& InSourcePath, const MeshCacheKey& Key);
+
+    bool IsValid() const { return Header != nullptr; }
+    const MeshCacheHeader& GetHeader() const { return *Header; }
+
+    // The section's values, or null if it doesn't hold exactly `Count` of them.
+    template<typename T>
+    const T* GetSection(MeshCacheSection Section, size_t Count) const
+    {
+        const size_t Index = static_cast<size_t>(Section);
+        if(Header->SectionRawSizes[Index] != Count * sizeof(T)) return nullptr;
+        if(Header->Key.bIsCompressed) return reinterpret_cast<const T*>(DecodedSections[Index].data());
+        return reinterpret_cast<const T*>(File.GetData() + Header->SectionOffsets[Index]);
+    }
+
+private:
+    MappedFile File;
+    const MeshCacheHeader* Header = nullptr;
+    std::array<std::vector<char>, MeshCacheSectionCount> DecodedSections;
+};
+
+// Writes the header and sections to a temporary file, which then replaces the cache, so that readers never see a partial file.
+// Fills in the header's section table, and encodes the sections first if the key asks for compression.
+bool WriteMeshCache(const fs::path& InCachePath, MeshCacheHeader Header, const std::array<std::string_view, MeshCacheSectionCount>& Sections);
+
+template<typename T>
+std::string_view AsBytes(const T* Data, size_t Count) { return {reinterpret_cast<const char*>(Data), Count * sizeof(T)}; }
+
+LINK_EDITOR_NAMESPACE_END
@@ -0,0 +1,476 @@
+﻿#include "MeshCodec.h"
+#include "Core/Thread/ThreadPool.h"
+
+#include <cstring>
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static constexpr size_t ValuesPerChunk = 1 << 16; // Indices, positions or normals per chunk.
+static constexpr size_t BytesPerChunk = 1 << 18;
+static constexpr uint RansProbabilityBits = 12;
+static constexpr uint RansProbabilityScale = 1 << RansProbabilityBits;
+static constexpr uint32_t RansLowerBound = 1u << 23;
+static constexpr uint RansStateCount = 4;
+static constexpr size_t MaxVarintBytes = 5;
+
+enum class StreamKind : uint32_t { Indices, Positions, Normals, Bytes };
+
+struct StreamHeader
+{
+    StreamKind Kind;
+    uint32_t Parameter; // Quantization bits, or the byte plane stride.
+    uint64_t Count;     // Values, or bytes for byte streams.
+    glm::vec3 BoundsMin, BoundsMax;
+    uint64_t ChunkCount; // Followed by the end offset of each chunk, from the start of the stream.
+};
+
+// Entropy-coded block of one chunk's transformed bytes.
+struct BlockHeader
+{
+    uint32_t RawSize;
+    uint32_t bIsStored; // Raw bytes follow, because rANS coding didn't make them smaller.
+};
+
+// rANS with a static model and byte-wise renormalization, as in Fabian Giesen's `rans_byte.h`.
+struct RansModel
+{
+    std::array<uint16_t, 256> Frequencies{};
+    std::array<uint16_t, 257> Starts{};
+
+    void Finalize()
+    {
+        for(uint Symbol = 0; Symbol < 256; ++Symbol) Starts[Symbol + 1] = uint16_t(Starts[Symbol] + Frequencies[Symbol]);
+    }
+};
+
+// Frequencies scaled to sum to `RansProbabilityScale`, keeping every present symbol encodable.
+static RansModel CreateRansModel(const std::vector<uint8_t>& Bytes)
+{
+    std::array<uint64_t, 256> Counts{};
+    for(const uint8_t Byte : Bytes) ++Counts[Byte];
+
+    RansModel Model;
+    int Sum = 0;
+    for(uint Symbol = 0; Symbol < 256; ++Symbol)
+    {
+        if(Counts[Symbol] == 0) continue;
+        Model.Frequencies[Symbol] = uint16_t(std::max<uint64_t>(1, Counts[Symbol] * RansProbabilityScale / Bytes.size()));
+        Sum += Model.Frequencies[Symbol];
+    }
+    // Rounding leaves the sum off by at most the number of symbols. Take the difference from the most frequent symbols.
+    while(Sum != int(RansProbabilityScale))
+    {
+        const auto Largest = std::max_element(Model.Frequencies.begin(), Model.Frequencies.end());
+        const int Step = Sum > int(RansProbabilityScale) ? -1 : 1;
+        const int Change = Step * std::min(std::abs(Sum - int(RansProbabilityScale)), std::max(1, *Largest / 2 - 1));
+        *Largest = uint16_t(*Largest + Change);
+        Sum += Change;
+    }
+    Model.Finalize();
+    return Model;
+}
+
+static void AppendBytes(std::vector<char>& Out, const void* Data, size_t Size)
+{
+    Out.insert(Out.end(), static_cast<const char*>(Data), static_cast<const char*>(Data) + Size);
+}
+
+static std::vector<char> EntropyEncode(const std::vector<uint8_t>& Bytes)
+{
+    std::vector<char> Block;
+    BlockHeader Header{uint32_t(Bytes.size()), 0};
+    if(!Bytes.empty())
+    {
+        const RansModel Model = CreateRansModel(Bytes);
+        // Symbols are coded backwards, so that the decoder reads forwards. Symbol `i` uses state `i % RansStateCount`.
+        std::vector<uint8_t> Buffer(Bytes.size() * 2 + 64);
+        uint8_t* Out = Buffer.data() + Buffer.size();
+        std::array<uint32_t, RansStateCount> States;
+        States.fill(RansLowerBound);
+        for(size_t i = Bytes.size(); i-- > 0;)
+        {
+            uint32_t& State = States[i % RansStateCount];
+            const uint32_t Frequency = Model.Frequencies[Bytes[i]];
+            const uint32_t MaxState = ((RansLowerBound >> RansProbabilityBits) << 8) * Frequency;
+            while(State >= MaxState)
+            {
+                *--Out = uint8_t(State & 0xff);
+                State >>= 8;
+            }
+            State = ((State / Frequency) << RansProbabilityBits) + (State % Frequency) + Model.Starts[Bytes[i]];
+        }
+        for(uint i = RansStateCount; i-- > 0;)
+        {
+            Out -= sizeof(uint32_t);
+            std::memcpy(Out, &States[i], sizeof(uint32_t));
+        }
+
+        const size_t PayloadSize = Buffer.data() + Buffer.size() - Out;
+        if(sizeof(Model.Frequencies) + PayloadSize < Bytes.size())
+        {
+            AppendBytes(Block, &Header, sizeof(Header));
+            AppendBytes(Block, Model.Frequencies.data(), sizeof(Model.Frequencies));
+            AppendBytes(Block, Out, PayloadSize);
+            return Block;
+        }
+    }
+    Header.bIsStored = 1;
+    AppendBytes(Block, &Header, sizeof(Header));
+    AppendBytes(Block, Bytes.data(), Bytes.size());
+    return Block;
+}
+
+// Fails if the block decodes to more than `MaxRawSize` bytes.
+static bool EntropyDecode(std::string_view Block, size_t MaxRawSize, std::vector<uint8_t>& Bytes)
+{
+    BlockHeader Header;
+    if(Block.size() < sizeof(Header)) return false;
+    std::memcpy(&Header, Block.data(), sizeof(Header));
+    Block.remove_prefix(sizeof(Header));
+    if(Header.RawSize > MaxRawSize) return false;
+    Bytes.resize(Header.RawSize);
+    if(Header.bIsStored)
+    {
+        if(Block.size() != Header.RawSize) return false;
+        std::memcpy(Bytes.data(), Block.data(), Block.size());
+        return true;
+    }
+
+    RansModel Model;
+    if(Block.size() < sizeof(Model.Frequencies) + RansStateCount * sizeof(uint32_t)) return false;
+    std::memcpy(Model.Frequencies.data(), Block.data(), sizeof(Model.Frequencies));
+    Block.remove_prefix(sizeof(Model.Frequencies));
+    // The 16-bit starts wrap around for corrupt frequencies, so the sum is checked in 32 bits before the slots are filled.
+    uint32_t FrequencySum = 0;
+    for(const uint16_t Frequency : Model.Frequencies) FrequencySum += Frequency;
+    if(FrequencySum != RansProbabilityScale) return false;
+    Model.Finalize();
+    for(uint Symbol = 0; Symbol < 256; ++Symbol)
+    {
+        if(Model.Starts[Symbol] > Model.Starts[Symbol + 1]) return false;
+    }
+
+    // Symbol, frequency and offset within the symbol's range of each slot, so that decoding a symbol takes one lookup.
+    struct SlotEntry { uint16_t Frequency, Offset; uint8_t Symbol; };
+    std::array<SlotEntry, RansProbabilityScale> Slots;
+    for(uint Symbol = 0; Symbol < 256; ++Symbol)
+    {
+        for(uint Slot = Model.Starts[Symbol]; Slot < Model.Starts[Symbol + 1]; ++Slot)
+        {
+            Slots[Slot] = {Model.Frequencies[Symbol], uint16_t(Slot - Model.Starts[Symbol]), uint8_t(Symbol)};
+        }
+    }
+
+    const auto* In = reinterpret_cast<const uint8_t*>(Block.data());
+    const auto* InEnd = In + Block.size();
+    std::array<uint32_t, RansStateCount> States;
+    for(uint i = 0; i < RansStateCount; ++i, In += sizeof(uint32_t)) std::memcpy(&States[i], In, sizeof(uint32_t));
+
+    const auto DecodeSymbol = [&](uint32_t& State, uint8_t& Symbol)
+    {
+        const SlotEntry& Entry = Slots[State & (RansProbabilityScale - 1)];
+        Symbol = Entry.Symbol;
+        State = Entry.Frequency * (State >> RansProbabilityBits) + Entry.Offset;
+        while(State < RansLowerBound)
+        {
+            if(In == InEnd) return false;
+            State = (State << 8) | *In++;
+        }
+        return true;
+    };
+    // The states are independent between renormalizations, so the decoding of consecutive symbols overlaps.
+    static_assert(RansStateCount == 4);
+    size_t i = 0;
+    for(; i + RansStateCount <= Bytes.size(); i += RansStateCount)
+    {
+        if(!DecodeSymbol(States[0], Bytes[i]) || !DecodeSymbol(States[1], Bytes[i + 1]) || !DecodeSymbol(States[2], Bytes[i + 2]) ||
+           !DecodeSymbol(States[3], Bytes[i + 3])) return false;
+    }
+    for(; i < Bytes.size(); ++i)
+    {
+        if(!DecodeSymbol(States[i % RansStateCount], Bytes[i])) return false;
+    }
+    return true;
+}
+
+static uint32_t ZigZag(uint32_t Delta) { return (Delta << 1) ^ uint32_t(int32_t(Delta) >> 31); }
+static uint32_t UnZigZag(uint32_t Value) { return (Value >> 1) ^ (0u - (Value & 1)); }
+
+static void AppendVarint(std::vector<uint8_t>& Bytes, uint32_t Value)
+{
+    while(Value >= 0x80)
+    {
+        Bytes.emplace_back(uint8_t(Value | 0x80));
+        Value >>= 7;
+    }
+    Bytes.emplace_back(uint8_t(Value));
+}
+
+static bool ReadVarint(const uint8_t*& In, const uint8_t* End, uint32_t& Value)
+{
+    Value = 0;
+    for(uint Shift = 0; Shift < 35; Shift += 7)
+    {
+        if(In == End) return false;
+        const uint8_t Byte = *In++;
+        Value |= uint32_t(Byte & 0x7f) << Shift;
+        if(Byte < 0x80) return true;
+    }
+    return false;
+}
+
+// Appends the zigzag varint deltas of `Count` values `Value(i)`, starting from zero.
+template<typename ValueGetter>
+static void AppendDeltas(std::vector<uint8_t>& Bytes, size_t Count, const ValueGetter& Value)
+{
+    uint32_t Previous = 0;
+    for(size_t i = 0; i < Count; ++i)
+    {
+        const uint32_t Current = Value(i);
+        AppendVarint(Bytes, ZigZag(Current - Previous));
+        Previous = Current;
+    }
+}
+
+template<typename ValueSetter>
+static bool ReadDeltas(const uint8_t*& In, const uint8_t* End, size_t Count, const ValueSetter& SetValue)
+{
+    uint32_t Value = 0;
+    for(size_t i = 0; i < Count; ++i)
+    {
+        uint32_t Delta;
+        if(!ReadVarint(In, End, Delta)) return false;
+        Value += UnZigZag(Delta);
+        SetValue(i, Value);
+    }
+    return true;
+}
+
+// Transforms (`Transform(Chunk, Bytes)`) and entropy-codes the chunks in parallel, and concatenates them after the header and chunk table.
+template<typename ChunkTransform>
+static std::vector<char> EncodeChunks(StreamHeader Header, const ChunkTransform& Transform)
+{
+    std::vector<std::vector<char>> Blocks(Header.ChunkCount);
+    ThreadPool::Get().ParallelFor(0, Header.ChunkCount, 1, [&](size_t Begin, size_t End)
+    {
+        std::vector<uint8_t> Bytes;
+        for(size_t Chunk = Begin; Chunk < End; ++Chunk)
+        {
+            Bytes.clear();
+            Transform(Chunk, Bytes);
+            Blocks[Chunk] = EntropyEncode(Bytes);
+        }
+    });
+
+    std::vector<char> Encoded;
+    AppendBytes(Encoded, &Header, sizeof(Header));
+    uint64_t Offset = sizeof(Header) + Header.ChunkCount * sizeof(uint64_t);
+    for(const auto& Block : Blocks) AppendBytes(Encoded, &(Offset += Block.size()), sizeof(Offset));
+    for(const auto& Block : Blocks) AppendBytes(Encoded, Block.data(), Block.size());
+    return Encoded;
+}
+
+static bool ReadStreamHeader(std::string_view Encoded, StreamHeader& Header)
+{
+    if(Encoded.size() < sizeof(Header)) return false;
+    std::memcpy(&Header, Encoded.data(), sizeof(Header));
+    return Header.ChunkCount <= (Encoded.size() - sizeof(Header)) / sizeof(uint64_t);
+}
+
+// Entropy-decodes the chunks in parallel and passes their bytes to `Inverse(Chunk, Begin, End)`, which returns false for corrupt data.
+// Chunks of more than `MaxChunkBytes` bytes are corrupt.
+template<typename ChunkInverse>
+static bool DecodeChunks(std::string_view Encoded, const StreamHeader& Header, size_t MaxChunkBytes, const ChunkInverse& Inverse)
+{
+    std::atomic<bool> bIsValid = true;
+    ThreadPool::Get().ParallelFor(0, Header.ChunkCount, 1, [&](size_t Begin, size_t End)
+    {
+        std::vector<uint8_t> Bytes;
+        for(size_t Chunk = Begin; Chunk < End && bIsValid; ++Chunk)
+        {
+            uint64_t BlockBegin = sizeof(Header) + Header.ChunkCount * sizeof(uint64_t), BlockEnd;
+            if(Chunk > 0) std::memcpy(&BlockBegin, Encoded.data() + sizeof(Header) + (Chunk - 1) * sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&BlockEnd, Encoded.data() + sizeof(Header) + Chunk * sizeof(uint64_t), sizeof(uint64_t));
+            if(BlockBegin > BlockEnd || BlockEnd > Encoded.size() || !EntropyDecode(Encoded.substr(BlockBegin, BlockEnd - BlockBegin), MaxChunkBytes, Bytes) ||
+               !Inverse(Chunk, Bytes.data(), Bytes.data() + Bytes.size()))
+            {
+                bIsValid = false;
+            }
+        }
+    });
+    return bIsValid;
+}
+
+static size_t GetChunkCount(size_t Count, size_t ChunkSize) { return (Count + ChunkSize - 1) / ChunkSize; }
+
+std::vector<char> EncodeIndices(const uint* Values, size_t Count)
+{
+    const StreamHeader Header{StreamKind::Indices, 0, Count, {}, {}, GetChunkCount(Count, ValuesPerChunk)};
+    return EncodeChunks(Header, [&](size_t Chunk, std::vector<uint8_t>& Bytes)
+    {
+        const uint* ChunkValues = Values + Chunk * ValuesPerChunk;
+        AppendDeltas(Bytes, std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk), [&](size_t i) { return ChunkValues[i]; });
+    });
+}
+
+bool DecodeIndices(std::string_view Encoded, uint* Values, size_t Count)
+{
+    StreamHeader Header;
+    if(!ReadStreamHeader(Encoded, Header) || Header.Kind != StreamKind::Indices || Header.Count != Count || Header.ChunkCount != GetChunkCount(Count, ValuesPerChunk)) return false;
+
+    return DecodeChunks(Encoded, Header, ValuesPerChunk * MaxVarintBytes, [&](size_t Chunk, const uint8_t* In, const uint8_t* End)
+    {
+        uint* ChunkValues = Values + Chunk * ValuesPerChunk;
+        return ReadDeltas(In, End, std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk), [&](size_t i, uint32_t Value) { ChunkValues[i] = Value; }) && In == End;
+    });
+}
+
+std::vector<char> EncodePositions(const glm::vec3* Positions, size_t Count, const BoundingBox& Bounds, uint Bits)
+{
+    if(Bits == 0) return EncodeBytes(Positions, Count * sizeof(glm::vec3), sizeof(float));
+
+    Bits = std::clamp(Bits, 8u, 24u);
+    const float MaxQuantized = float((1u << Bits) - 1);
+    const glm::vec3 Extent = Bounds.Max - Bounds.Min;
+    glm::vec3 Scale;
+    for(int Axis = 0; Axis < 3; ++Axis) Scale[Axis] = Extent[Axis] > 0 ? MaxQuantized / Extent[Axis] : 0;
+    const StreamHeader Header{StreamKind::Positions, Bits, Count, Bounds.Min, Bounds.Max, GetChunkCount(Count, ValuesPerChunk)};
+    return EncodeChunks(Header, [&](size_t Chunk, std::vector<uint8_t>& Bytes)
+    {
+        // One component at a time, since each varies smoothly along the vertex order.
+        const glm::vec3* ChunkPositions = Positions + Chunk * ValuesPerChunk;
+        for(int Axis = 0; Axis < 3; ++Axis)
+        {
+            AppendDeltas(Bytes, std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk), [&](size_t i)
+            {
+                return uint32_t(std::clamp((ChunkPositions[i][Axis] - Bounds.Min[Axis]) * Scale[Axis], 0.f, MaxQuantized) + 0.5f);
+            });
+        }
+    });
+}
+
+bool DecodePositions(std::string_view Encoded, glm::vec3* Positions, size_t Count)
+{
+    StreamHeader Header;
+    if(!ReadStreamHeader(Encoded, Header)) return false;
+    if(Header.Kind == StreamKind::Bytes) return DecodeBytes(Encoded, Positions, Count * sizeof(glm::vec3));
+    if(Header.Kind != StreamKind::Positions || Header.Count != Count || Header.ChunkCount != GetChunkCount(Count, ValuesPerChunk) || Header.Parameter > 24) return false;
+
+    const glm::vec3 Step = (Header.BoundsMax - Header.BoundsMin) / float((1u << Header.Parameter) - 1);
+    return DecodeChunks(Encoded, Header, 3 * ValuesPerChunk * MaxVarintBytes, [&](size_t Chunk, const uint8_t* In, const uint8_t* End)
+    {
+        glm::vec3* ChunkPositions = Positions + Chunk * ValuesPerChunk;
+        const size_t ChunkCount = std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk);
+        for(int Axis = 0; Axis < 3; ++Axis)
+        {
+            if(!ReadDeltas(In, End, ChunkCount, [&](size_t i, uint32_t Value) { ChunkPositions[i][Axis] = Header.BoundsMin[Axis] + float(Value) * Step[Axis]; })) return false;
+        }
+        return In == End;
+    });
+}
+
+glm::vec2 EncodeOctahedral(glm::vec3 Normal)
+{
+    const float Norm = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+    if(Norm == 0) return glm::vec2{0};
+    Normal /= Norm;
+    glm::vec2 Encoded{Normal.x, Normal.y};
+    if(Normal.z < 0) Encoded = (1.f - glm::abs(glm::vec2{Normal.y, Normal.x})) * glm::vec2{Normal.x >= 0 ? 1.f : -1.f, Normal.y >= 0 ? 1.f : -1.f};
+    return Encoded;
+}
+
+glm::vec3 DecodeOctahedral(glm::vec2 Encoded)
+{
+    glm::vec3 Normal{Encoded.x, Encoded.y, 1.f - std::abs(Encoded.x) - std::abs(Encoded.y)};
+    if(Normal.z < 0)
+    {
+        const glm::vec2 Folded = (1.f - glm::abs(glm::vec2{Normal.y, Normal.x})) * glm::vec2{Normal.x >= 0 ? 1.f : -1.f, Normal.y >= 0 ? 1.f : -1.f};
+        Normal.x = Folded.x;
+        Normal.y = Folded.y;
+    }
+    return glm::normalize(Normal);
+}
+
+std::vector<char> EncodeNormals(const glm::vec3* Normals, size_t Count, uint Bits)
+{
+    if(Bits == 0) return EncodeBytes(Normals, Count * sizeof(glm::vec3), sizeof(float));
+
+    Bits = std::clamp(Bits, 6u, 16u);
+    const float MaxQuantized = float((1u << Bits) - 1);
+    const StreamHeader Header{StreamKind::Normals, Bits, Count, {}, {}, GetChunkCount(Count, ValuesPerChunk)};
+    return EncodeChunks(Header, [&](size_t Chunk, std::vector<uint8_t>& Bytes)
+    {
+        const size_t ChunkCount = std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk);
+        std::vector<glm::vec2> Encoded(ChunkCount);
+        for(size_t i = 0; i < ChunkCount; ++i) Encoded[i] = EncodeOctahedral(Normals[Chunk * ValuesPerChunk + i]);
+        for(int Axis = 0; Axis < 2; ++Axis)
+        {
+            AppendDeltas(Bytes, ChunkCount, [&](size_t i) { return uint32_t(std::clamp(Encoded[i][Axis] * 0.5f + 0.5f, 0.f, 1.f) * MaxQuantized + 0.5f); });
+        }
+    });
+}
+
+bool DecodeNormals(std::string_view Encoded, glm::vec3* Normals, size_t Count)
+{
+    StreamHeader Header;
+    if(!ReadStreamHeader(Encoded, Header)) return false;
+    if(Header.Kind == StreamKind::Bytes) return DecodeBytes(Encoded, Normals, Count * sizeof(glm::vec3));
+    if(Header.Kind != StreamKind::Normals || Header.Count != Count || Header.ChunkCount != GetChunkCount(Count, ValuesPerChunk) || Header.Parameter > 16) return false;
+
+    const float Step = 2.f / float((1u << Header.Parameter) - 1);
+    return DecodeChunks(Encoded, Header, 2 * ValuesPerChunk * MaxVarintBytes, [&](size_t Chunk, const uint8_t* In, const uint8_t* End)
+    {
+        const size_t ChunkCount = std::min(ValuesPerChunk, Count - Chunk * ValuesPerChunk);
+        std::vector<glm::vec2> Octahedral(ChunkCount);
+        for(int Axis = 0; Axis < 2; ++Axis)
+        {
+            if(!ReadDeltas(In, End, ChunkCount, [&](size_t i, uint32_t Value) { Octahedral[i][Axis] = float(Value) * Step - 1.f; })) return false;
+        }
+        for(size_t i = 0; i < ChunkCount; ++i) Normals[Chunk * ValuesPerChunk + i] = DecodeOctahedral(Octahedral[i]);
+        return In == End;
+    });
+}
+
+std::vector<char> EncodeBytes(const void* Data, size_t Size, uint Stride)
+{
+    Stride = std::clamp(Stride, 1u, 16u);
+    const size_t ChunkSize = BytesPerChunk / Stride * Stride;
+    const StreamHeader Header{StreamKind::Bytes, Stride, Size, {}, {}, GetChunkCount(Size, ChunkSize)};
+    return EncodeChunks(Header, [&](size_t Chunk, std::vector<uint8_t>& Bytes)
+    {
+        // Byte `k` of each element goes to plane `k`. A partial trailing element is appended as is.
+        const auto* ChunkData = static_cast<const uint8_t*>(Data) + Chunk * ChunkSize;
+        const size_t ChunkBytes = std::min(ChunkSize, Size - Chunk * ChunkSize), ElementCount = ChunkBytes / Stride;
+        Bytes.resize(ChunkBytes);
+        for(uint Plane = 0; Plane < Stride; ++Plane)
+        {
+            for(size_t i = 0; i < ElementCount; ++i) Bytes[Plane * ElementCount + i] = ChunkData[i * Stride + Plane];
+        }
+        std::copy(ChunkData + ElementCount * Stride, ChunkData + ChunkBytes, Bytes.begin() + ElementCount * Stride);
+    });
+}
+
+bool DecodeBytes(std::string_view Encoded, void* Data, size_t Size)
+{
+    StreamHeader Header;
+    if(!ReadStreamHeader(Encoded, Header) || Header.Kind != StreamKind::Bytes || Header.Count != Size || Header.Parameter < 1 || Header.Parameter > 16) return false;
+
+    const uint Stride = Header.Parameter;
+    const size_t ChunkSize = BytesPerChunk / Stride * Stride;
+    if(Header.ChunkCount != GetChunkCount(Size, ChunkSize)) return false;
+
+    return DecodeChunks(Encoded, Header, ChunkSize, [&](size_t Chunk, const uint8_t* In, const uint8_t* End)
+    {
+        auto* ChunkData = static_cast<uint8_t*>(Data) + Chunk * ChunkSize;
+        const size_t ChunkBytes = std::min(ChunkSize, Size - Chunk * ChunkSize), ElementCount = ChunkBytes / Stride;
+        if(size_t(End - In) != ChunkBytes) return false;
+        for(uint Plane = 0; Plane < Stride; ++Plane)
+        {
+            for(size_t i = 0; i < ElementCount; ++i) ChunkData[i * Stride + Plane] = In[Plane * ElementCount + i];
+        }
+        std::copy(In + ElementCount * Stride, End, ChunkData + ElementCount * Stride);
+        return true;
+    });
+}
+
+LINK_EDITOR_NAMESPACE_END
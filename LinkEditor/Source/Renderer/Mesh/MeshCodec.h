@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+struct MeshCodecOptions
+{
+    uint PositionBits = 0; // Bits per quantized position component, relative to the bounds, in `[8, 24]`. Zero keeps positions exact.
+    uint NormalBits = 16;  // Bits per octahedral normal component, in `[6, 16]`. Zero keeps normals exact.
+};
+
+// Encoded streams are split into chunks that are encoded and decoded in parallel. Each chunk goes through a stream-specific transform
+// (quantization, deltas, varints, byte planes) and then a static-model rANS coder with four interleaved states, so that consecutive
+// symbols don't depend on each other during decoding. Chunks that don't compress are stored as is.
+// Decoding functions return false if the data is corrupt or doesn't hold `Count` values.
+
+// Lossless. Each value is coded as the zigzag varint of its difference to the previous one, so indices close to their predecessor
+// (e.g. the corners of neighbouring faces) take one byte before entropy coding. Signed values (e.g. -1 handles) work too.
+std::vector<char> EncodeIndices(const uint* Values, size_t Count);
+bool DecodeIndices(std::string_view Encoded, uint* Values, size_t Count);
+
+// Quantizes positions to `Bits` per component over `Bounds`, and codes each component's deltas like indices. Exact if `Bits` is zero.
+std::vector<char> EncodePositions(const glm::vec3* Positions, size_t Count, const BoundingBox& Bounds, uint Bits);
+bool DecodePositions(std::string_view Encoded, glm::vec3* Positions, size_t Count);
+
+// Octahedral encoding of unit normals with `Bits` per component. Exact if `Bits` is zero.
+std::vector<char> EncodeNormals(const glm::vec3* Normals, size_t Count, uint Bits);
+bool DecodeNormals(std::string_view Encoded, glm::vec3* Normals, size_t Count);
+
+// Octahedral mapping of unit normals to `[-1, 1]^2`, also used by packed render vertices.
+glm::vec2 EncodeOctahedral(glm::vec3 Normal);
+glm::vec3 DecodeOctahedral(glm::vec2 Encoded);
+
+// Lossless. Splits the data into `Stride` byte planes (e.g. 4 for floats, so that exponent bytes are coded together).
+std::vector<char> EncodeBytes(const void* Data, size_t Size, uint Stride);
+bool DecodeBytes(std::string_view Encoded, void* Data, size_t Size);
+
+LINK_EDITOR_NAMESPACE_END
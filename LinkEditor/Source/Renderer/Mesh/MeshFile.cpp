@@ -0,0 +1,851 @@
+﻿#include "MeshFile.h"
+#include "Core/File/MappedFile.h"
+#include "Core/Thread/ThreadPool.h"
+
+#include <charconv>
+#include <cstring>
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static constexpr size_t MinTextChunkSize = 1 << 20; // Bytes of text per parsing task.
+static constexpr size_t TextChunksPerThread = 8;
+static constexpr size_t BinaryGrainSize = 1 << 16; // Vertices or faces per binary copy task.
+static constexpr size_t RecordsPerWriteChunk = 1 << 15; // Vertices or faces per formatting task when writing.
+static constexpr size_t WriteChunksPerThread = 4;        // Formatting tasks per thread in each batch that is written at once.
+static constexpr size_t MaxFloatChars = 15;              // Shortest round-trip float, e.g. `-1.1754944e-38`.
+static constexpr size_t MaxIntChars = 11;
+
+// Vertices and faces parsed from one chunk of text. Face vertex indices are 0-based. The indices of the corners in `RelativeCorners`
+// are relative to the chunk's first vertex (OBJ's negative indices).
+struct MeshChunk
+{
+    std::vector<glm::vec3> Positions;
+    std::vector<uint> FaceSizes;
+    std::vector<int64_t> FaceVertices;
+    std::vector<size_t> RelativeCorners;
+    bool bIsValid = true;
+};
+
+static bool IsSpace(char C) { return C == ' ' || C == '\t' || C == '\r'; }
+
+static const char* SkipSpaces(const char* P, const char* End)
+{
+    while(P < End && IsSpace(*P)) ++P;
+    return P;
+}
+
+static const char* SkipToken(const char* P, const char* End)
+{
+    while(P < End && !IsSpace(*P)) ++P;
+    return P;
+}
+
+static const char* FindLineEnd(const char* P, const char* End)
+{
+    const void* NewLine = std::memchr(P, '\n', End - P);
+    return NewLine ? static_cast<const char*>(NewLine) : End;
+}
+
+static std::string_view NextToken(const char*& P, const char* End)
+{
+    const char* Begin = SkipSpaces(P, End);
+    P = SkipToken(Begin, End);
+    return {Begin, static_cast<size_t>(P - Begin)};
+}
+
+// Parses the number after `P` and optional spaces, and moves `P` past it.
+template<typename T>
+static bool ParseNumber(const char*& P, const char* End, T& Out)
+{
+    P = SkipSpaces(P, End);
+    if(P < End && *P == '+') ++P;
+    const auto [Next, Error] = std::from_chars(P, End, Out);
+    if(Error != std::errc()) return false;
+    P = Next;
+    return true;
+}
+
+// Calls `Visit(Begin, End)` for each data line in `[Begin, End)`, i.e. each line that is not blank or a '#' comment, without its
+// leading spaces and line break.
+template<typename LineVisitor>
+static void ForEachDataLine(const char* Begin, const char* End, LineVisitor&& Visit)
+{
+    for(const char* Line = Begin; Line < End;)
+    {
+        const char* LineEnd = FindLineEnd(Line, End);
+        const char* First = SkipSpaces(Line, LineEnd);
+        if(First < LineEnd && *First != '#') Visit(First, LineEnd);
+        Line = LineEnd + 1;
+    }
+}
+
+// Finds the next data line after `P` and moves `P` past it. Returns false at the end of the text.
+static bool NextDataLine(const char*& P, const char* End, const char*& LineBegin, const char*& LineEnd)
+{
+    bool bIsFound = false;
+    while(!bIsFound && P < End)
+    {
+        LineEnd = FindLineEnd(P, End);
+        LineBegin = SkipSpaces(P, LineEnd);
+        bIsFound = LineBegin < LineEnd && *LineBegin != '#';
+        P = std::min(LineEnd + 1, End);
+    }
+    return bIsFound;
+}
+
+// Splits the text into chunks of whole lines, a few per thread.
+static std::vector<std::string_view> SplitLines(std::string_view Text)
+{
+    const size_t ChunkCount = std::clamp<size_t>(Text.size() / MinTextChunkSize, 1, ThreadPool::Get().GetThreadCount() * TextChunksPerThread);
+    std::vector<std::string_view> Chunks;
+    Chunks.reserve(ChunkCount);
+    const char* Begin = Text.data();
+    const char* End = Text.data() + Text.size();
+    for(size_t i = 1; i <= ChunkCount && Begin < End; ++i)
+    {
+        const char* ChunkEnd = i == ChunkCount ? End : FindLineEnd(std::max(Begin, Text.data() + Text.size() / ChunkCount * i), End);
+        if(ChunkEnd < End) ++ChunkEnd;
+        Chunks.emplace_back(Begin, ChunkEnd - Begin);
+        Begin = ChunkEnd;
+    }
+    return Chunks;
+}
+
+// Calls `ParseLine(Chunk, LineIndex, Begin, End)` for each data line of the text, in parallel chunks. `LineIndex` is the index of
+// the line among the data lines of the text, which takes an extra counting pass, so it is only computed if `bNeedsLineIndices`.
+template<typename LineParser>
+static std::vector<MeshChunk> ParseLines(std::string_view Text, bool bNeedsLineIndices, const LineParser& ParseLine)
+{
+    const auto TextChunks = SplitLines(Text);
+    std::vector<size_t> FirstLineIndices(TextChunks.size() + 1, 0);
+    if(bNeedsLineIndices)
+    {
+        ThreadPool::Get().ParallelFor(0, TextChunks.size(), 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+        {
+            for(size_t i = ChunkBegin; i < ChunkEnd; ++i)
+            {
+                size_t LineCount = 0;
+                ForEachDataLine(TextChunks[i].data(), TextChunks[i].data() + TextChunks[i].size(), [&](const char*, const char*) { ++LineCount; });
+                FirstLineIndices[i + 1] = LineCount;
+            }
+        });
+        std::partial_sum(FirstLineIndices.begin(), FirstLineIndices.end(), FirstLineIndices.begin());
+    }
+
+    std::vector<MeshChunk> Chunks(TextChunks.size());
+    ThreadPool::Get().ParallelFor(0, TextChunks.size(), 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for(size_t i = ChunkBegin; i < ChunkEnd; ++i)
+        {
+            size_t LineIndex = FirstLineIndices[i];
+            ForEachDataLine(TextChunks[i].data(), TextChunks[i].data() + TextChunks[i].size(), [&](const char* Begin, const char* End)
+            {
+                if(Chunks[i].bIsValid) ParseLine(Chunks[i], LineIndex, Begin, End);
+                ++LineIndex;
+            });
+        }
+    });
+    return Chunks;
+}
+
+// Concatenates the chunks, releasing them. Fails if a chunk is invalid or a face vertex index is out of range.
+static bool MergeChunks(std::vector<MeshChunk>& Chunks, MeshData& OutData)
+{
+    std::vector<size_t> VertexOffsets(Chunks.size() + 1, 0), FaceOffsets(Chunks.size() + 1, 0), CornerOffsets(Chunks.size() + 1, 0);
+    for(size_t i = 0; i < Chunks.size(); ++i)
+    {
+        if(!Chunks[i].bIsValid) return false;
+        VertexOffsets[i + 1] = VertexOffsets[i] + Chunks[i].Positions.size();
+        FaceOffsets[i + 1] = FaceOffsets[i] + Chunks[i].FaceSizes.size();
+        CornerOffsets[i + 1] = CornerOffsets[i] + Chunks[i].FaceVertices.size();
+    }
+    if(VertexOffsets.back() > std::numeric_limits<uint>::max() || CornerOffsets.back() > std::numeric_limits<uint>::max()) return false;
+
+    OutData.Positions.resize(VertexOffsets.back());
+    OutData.FaceOffsets.assign(FaceOffsets.back() + 1, 0);
+    OutData.FaceVertices.resize(CornerOffsets.back());
+    std::atomic<bool> bIsValid = true;
+    ThreadPool::Get().ParallelFor(0, Chunks.size(), 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for(size_t i = ChunkBegin; i < ChunkEnd; ++i)
+        {
+            MeshChunk& Chunk = Chunks[i];
+            std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), OutData.Positions.begin() + VertexOffsets[i]);
+
+            uint Corner = static_cast<uint>(CornerOffsets[i]);
+            for(size_t Face = 0; Face < Chunk.FaceSizes.size(); ++Face)
+            {
+                Corner += Chunk.FaceSizes[Face];
+                OutData.FaceOffsets[FaceOffsets[i] + Face + 1] = Corner;
+            }
+
+            for(const size_t RelativeCorner : Chunk.RelativeCorners) Chunk.FaceVertices[RelativeCorner] += VertexOffsets[i];
+            for(size_t Corner = 0; Corner < Chunk.FaceVertices.size(); ++Corner)
+            {
+                const int64_t Vertex = Chunk.FaceVertices[Corner];
+                if(Vertex < 0 || Vertex >= static_cast<int64_t>(VertexOffsets.back())) bIsValid = false;
+                OutData.FaceVertices[CornerOffsets[i] + Corner] = static_cast<uint>(Vertex);
+            }
+            Chunk = {};
+        }
+    });
+    return bIsValid;
+}
+
+// Faces `{0, 1, 2}`, `{3, 4, 5}`, ... over all vertices, for formats that store each triangle's vertices separately.
+static void SetTriangleFaces(MeshData& Data)
+{
+    const size_t TriangleCount = Data.Positions.size() / 3;
+    Data.FaceOffsets.resize(TriangleCount + 1);
+    Data.FaceVertices.resize(TriangleCount * 3);
+    ThreadPool::Get().ParallelFor(0, TriangleCount + 1, BinaryGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Face = Begin; Face < End; ++Face) Data.FaceOffsets[Face] = static_cast<uint>(Face * 3);
+    });
+    std::iota(Data.FaceVertices.begin(), Data.FaceVertices.end(), 0u);
+}
+
+static bool ReadObj(std::string_view Text, MeshData& OutData)
+{
+    auto Chunks = ParseLines(Text, false, [](MeshChunk& Chunk, size_t, const char* Line, const char* LineEnd)
+    {
+        if(LineEnd - Line < 2 || !IsSpace(Line[1])) return;
+
+        if(Line[0] == 'v')
+        {
+            glm::vec3 Position;
+            ++Line;
+            Chunk.bIsValid = ParseNumber(Line, LineEnd, Position.x) && ParseNumber(Line, LineEnd, Position.y) && ParseNumber(Line, LineEnd, Position.z);
+            Chunk.Positions.emplace_back(Position);
+        }
+        else if(Line[0] == 'f')
+        {
+            // Each corner is `v`, `v/vt`, `v//vn` or `v/vt/vn`. Only `v` is read.
+            uint FaceSize = 0;
+            for(Line = SkipSpaces(Line + 1, LineEnd); Line < LineEnd; Line = SkipSpaces(SkipToken(Line, LineEnd), LineEnd), ++FaceSize)
+            {
+                int64_t Vertex;
+                if(!ParseNumber(Line, LineEnd, Vertex) || Vertex == 0)
+                {
+                    Chunk.bIsValid = false;
+                    return;
+                }
+                if(Vertex < 0)
+                {
+                    Chunk.RelativeCorners.emplace_back(Chunk.FaceVertices.size());
+                    Vertex += static_cast<int64_t>(Chunk.Positions.size());
+                }
+                else
+                {
+                    --Vertex;
+                }
+                Chunk.FaceVertices.emplace_back(Vertex);
+            }
+            Chunk.FaceSizes.emplace_back(FaceSize);
+        }
+    });
+    return MergeChunks(Chunks, OutData);
+}
+
+static bool ReadOff(std::string_view Text, MeshData& OutData)
+{
+    // The header is `[ST][C][N]OFF`, with the vertex, face and edge counts on the same or the next line.
+    const char* P = Text.data();
+    const char* End = Text.data() + Text.size();
+    const char *HeaderLine, *HeaderLineEnd;
+    if(!NextDataLine(P, End, HeaderLine, HeaderLineEnd)) return false;
+
+    const std::string_view Keyword = NextToken(HeaderLine, HeaderLineEnd);
+    if(Keyword.size() < 3 || Keyword.substr(Keyword.size() - 3) != "OFF" || Keyword.substr(0, Keyword.size() - 3).find_first_not_of("STCN") != std::string_view::npos) return false;
+    if(SkipSpaces(HeaderLine, HeaderLineEnd) == HeaderLineEnd && !NextDataLine(P, End, HeaderLine, HeaderLineEnd)) return false;
+
+    size_t VertexCount, FaceCount;
+    if(!ParseNumber(HeaderLine, HeaderLineEnd, VertexCount) || !ParseNumber(HeaderLine, HeaderLineEnd, FaceCount)) return false;
+
+    // Vertex lines are `x y z [...]` and face lines are `n v1 ... vn [...]`, followed by optional colors etc.
+    auto Chunks = ParseLines(std::string_view(P, End - P), true, [&](MeshChunk& Chunk, size_t LineIndex, const char* Line, const char* LineEnd)
+    {
+        if(LineIndex < VertexCount)
+        {
+            glm::vec3 Position;
+            Chunk.bIsValid = ParseNumber(Line, LineEnd, Position.x) && ParseNumber(Line, LineEnd, Position.y) && ParseNumber(Line, LineEnd, Position.z);
+            Chunk.Positions.emplace_back(Position);
+        }
+        else if(LineIndex < VertexCount + FaceCount)
+        {
+            uint FaceSize;
+            Chunk.bIsValid = ParseNumber(Line, LineEnd, FaceSize);
+            for(uint i = 0; i < FaceSize && Chunk.bIsValid; ++i)
+            {
+                int64_t Vertex;
+                Chunk.bIsValid = ParseNumber(Line, LineEnd, Vertex);
+                Chunk.FaceVertices.emplace_back(Vertex);
+            }
+            Chunk.FaceSizes.emplace_back(FaceSize);
+        }
+    });
+    return MergeChunks(Chunks, OutData) && OutData.Positions.size() == VertexCount && OutData.GetFaceCount() == FaceCount;
+}
+
+static bool ReadStl(std::string_view Text, MeshData& OutData)
+{
+    // Binary files may start with "solid" too, so check the size implied by the binary triangle count first.
+    static constexpr size_t HeaderSize = 84, TriangleSize = 50;
+    uint32_t TriangleCount = 0;
+    if(Text.size() >= HeaderSize) std::memcpy(&TriangleCount, Text.data() + 80, sizeof(TriangleCount));
+    if(Text.size() >= HeaderSize && Text.size() == HeaderSize + size_t(TriangleCount) * TriangleSize)
+    {
+        // Each triangle is a normal, three positions and a 2-byte attribute.
+        OutData.Positions.resize(size_t(TriangleCount) * 3);
+        ThreadPool::Get().ParallelFor(0, TriangleCount, BinaryGrainSize, [&](size_t Begin, size_t End)
+        {
+            for(size_t Triangle = Begin; Triangle < End; ++Triangle)
+            {
+                std::memcpy(&OutData.Positions[Triangle * 3], Text.data() + HeaderSize + Triangle * TriangleSize + sizeof(glm::vec3), sizeof(glm::vec3) * 3);
+            }
+        });
+    }
+    else
+    {
+        if(Text.substr(0, 5) != "solid") return false;
+
+        auto Chunks = ParseLines(Text, false, [](MeshChunk& Chunk, size_t, const char* Line, const char* LineEnd)
+        {
+            if(NextToken(Line, LineEnd) != "vertex") return;
+
+            glm::vec3 Position;
+            Chunk.bIsValid = ParseNumber(Line, LineEnd, Position.x) && ParseNumber(Line, LineEnd, Position.y) && ParseNumber(Line, LineEnd, Position.z);
+            Chunk.Positions.emplace_back(Position);
+        });
+        if(!MergeChunks(Chunks, OutData) || OutData.Positions.size() % 3 != 0) return false;
+    }
+    SetTriangleFaces(OutData);
+    return true;
+}
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty
+{
+    std::string Name;
+    PlyType Type;
+    PlyType CountType; // Type of the item count of lists.
+    bool bIsList = false;
+};
+
+struct PlyElement
+{
+    std::string Name;
+    size_t Count = 0;
+    std::vector<PlyProperty> Properties;
+};
+
+static std::optional<PlyType> ParsePlyType(std::string_view Name)
+{
+    if(Name == "char" || Name == "int8") return PlyType::Int8;
+    if(Name == "uchar" || Name == "uint8") return PlyType::UInt8;
+    if(Name == "short" || Name == "int16") return PlyType::Int16;
+    if(Name == "ushort" || Name == "uint16") return PlyType::UInt16;
+    if(Name == "int" || Name == "int32") return PlyType::Int32;
+    if(Name == "uint" || Name == "uint32") return PlyType::UInt32;
+    if(Name == "float" || Name == "float32") return PlyType::Float32;
+    if(Name == "double" || Name == "float64") return PlyType::Float64;
+    return {};
+}
+
+static size_t GetPlyTypeSize(PlyType Type)
+{
+    switch(Type)
+    {
+    case PlyType::Int8: case PlyType::UInt8: return 1;
+    case PlyType::Int16: case PlyType::UInt16: return 2;
+    case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+    default: return 8;
+    }
+}
+
+template<typename T>
+static T ReadBinary(const char* Data, bool bIsSwapped)
+{
+    char Bytes[sizeof(T)];
+    std::memcpy(Bytes, Data, sizeof(T));
+    if(bIsSwapped) std::reverse(Bytes, Bytes + sizeof(T));
+    T Value;
+    std::memcpy(&Value, Bytes, sizeof(T));
+    return Value;
+}
+
+// All PLY types convert to double exactly, except 64-bit doubles themselves.
+static double ReadPlyValue(const char* Data, PlyType Type, bool bIsSwapped)
+{
+    switch(Type)
+    {
+    case PlyType::Int8: return ReadBinary<int8_t>(Data, false);
+    case PlyType::UInt8: return ReadBinary<uint8_t>(Data, false);
+    case PlyType::Int16: return ReadBinary<int16_t>(Data, bIsSwapped);
+    case PlyType::UInt16: return ReadBinary<uint16_t>(Data, bIsSwapped);
+    case PlyType::Int32: return ReadBinary<int32_t>(Data, bIsSwapped);
+    case PlyType::UInt32: return ReadBinary<uint32_t>(Data, bIsSwapped);
+    case PlyType::Float32: return ReadBinary<float>(Data, bIsSwapped);
+    default: return ReadBinary<double>(Data, bIsSwapped);
+    }
+}
+
+// Parses the header up to and including the `end_header` line, and moves `P` past it.
+static bool ReadPlyHeader(const char*& P, const char* End, std::string& OutFormat, std::vector<PlyElement>& OutElements)
+{
+    const char *LineBegin, *LineEnd;
+    if(!NextDataLine(P, End, LineBegin, LineEnd) || NextToken(LineBegin, LineEnd) != "ply") return false;
+
+    while(NextDataLine(P, End, LineBegin, LineEnd))
+    {
+        const std::string_view Keyword = NextToken(LineBegin, LineEnd);
+        if(Keyword == "end_header") return !OutFormat.empty();
+
+        if(Keyword == "format")
+        {
+            OutFormat = NextToken(LineBegin, LineEnd);
+        }
+        else if(Keyword == "element")
+        {
+            PlyElement& Element = OutElements.emplace_back();
+            Element.Name = NextToken(LineBegin, LineEnd);
+            if(!ParseNumber(LineBegin, LineEnd, Element.Count)) return false;
+        }
+        else if(Keyword == "property")
+        {
+            if(OutElements.empty()) return false;
+
+            PlyProperty Property;
+            std::string_view TypeName = NextToken(LineBegin, LineEnd);
+            if(TypeName == "list")
+            {
+                const auto CountType = ParsePlyType(NextToken(LineBegin, LineEnd));
+                if(!CountType) return false;
+                Property.CountType = *CountType;
+                Property.bIsList = true;
+                TypeName = NextToken(LineBegin, LineEnd);
+            }
+            const auto Type = ParsePlyType(TypeName);
+            if(!Type) return false;
+            Property.Type = *Type;
+            Property.Name = NextToken(LineBegin, LineEnd);
+            OutElements.back().Properties.emplace_back(std::move(Property));
+        }
+        else if(Keyword != "comment" && Keyword != "obj_info")
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool ReadPly(std::string_view Text, MeshData& OutData)
+{
+    const char* P = Text.data();
+    const char* End = Text.data() + Text.size();
+    std::string Format;
+    std::vector<PlyElement> Elements;
+    if(!ReadPlyHeader(P, End, Format, Elements)) return false;
+
+    // Vertex positions are the `x`, `y` and `z` properties of `vertex`, and faces the `vertex_indices` (or `vertex_index`) list of `face`.
+    const PlyElement* VertexElement = nullptr;
+    const PlyElement* FaceElement = nullptr;
+    std::array<int, 3> PositionProperties{-1, -1, -1};
+    int IndexProperty = -1;
+    for(const auto& Element : Elements)
+    {
+        for(int i = 0; i < int(Element.Properties.size()); ++i)
+        {
+            const PlyProperty& Property = Element.Properties[i];
+            if(Element.Name == "vertex" && Property.Name.size() == 1 && Property.Name[0] >= 'x' && Property.Name[0] <= 'z')
+            {
+                PositionProperties[Property.Name[0] - 'x'] = i;
+                VertexElement = &Element;
+            }
+            else if(Element.Name == "face" && (Property.Name == "vertex_indices" || Property.Name == "vertex_index") && Property.bIsList)
+            {
+                IndexProperty = i;
+                FaceElement = &Element;
+            }
+        }
+    }
+    if(!VertexElement || *std::min_element(PositionProperties.begin(), PositionProperties.end()) < 0) return false;
+    if(std::any_of(VertexElement->Properties.begin(), VertexElement->Properties.end(), [](const PlyProperty& Property) { return Property.bIsList; })) return false;
+
+    const size_t FaceCount = FaceElement ? FaceElement->Count : 0;
+    if(Format == "ascii")
+    {
+        // Each element item is one line, with list properties written as the item count followed by the items.
+        std::vector<size_t> FirstLineIndices{0};
+        for(const auto& Element : Elements) FirstLineIndices.emplace_back(FirstLineIndices.back() + Element.Count);
+
+        auto Chunks = ParseLines(std::string_view(P, End - P), true, [&](MeshChunk& Chunk, size_t LineIndex, const char* Line, const char* LineEnd)
+        {
+            const size_t ElementIndex = std::upper_bound(FirstLineIndices.begin(), FirstLineIndices.end(), LineIndex) - FirstLineIndices.begin() - 1;
+            if(ElementIndex >= Elements.size()) return;
+
+            const PlyElement& Element = Elements[ElementIndex];
+            if(&Element == VertexElement)
+            {
+                glm::vec3 Position;
+                for(int i = 0; i < int(Element.Properties.size()) && Chunk.bIsValid; ++i)
+                {
+                    const auto Axis = std::find(PositionProperties.begin(), PositionProperties.end(), i);
+                    if(Axis != PositionProperties.end()) Chunk.bIsValid = ParseNumber(Line, LineEnd, Position[int(Axis - PositionProperties.begin())]);
+                    else Line = SkipToken(SkipSpaces(Line, LineEnd), LineEnd);
+                }
+                Chunk.Positions.emplace_back(Position);
+            }
+            else if(&Element == FaceElement)
+            {
+                for(int i = 0; i < int(Element.Properties.size()) && Chunk.bIsValid; ++i)
+                {
+                    if(!Element.Properties[i].bIsList)
+                    {
+                        Line = SkipToken(SkipSpaces(Line, LineEnd), LineEnd);
+                        continue;
+                    }
+
+                    uint ItemCount;
+                    Chunk.bIsValid = ParseNumber(Line, LineEnd, ItemCount);
+                    for(uint Item = 0; Item < ItemCount && Chunk.bIsValid; ++Item)
+                    {
+                        if(i != IndexProperty)
+                        {
+                            Line = SkipToken(SkipSpaces(Line, LineEnd), LineEnd);
+                            continue;
+                        }
+                        int64_t Vertex;
+                        Chunk.bIsValid = ParseNumber(Line, LineEnd, Vertex);
+                        Chunk.FaceVertices.emplace_back(Vertex);
+                    }
+                    if(i == IndexProperty) Chunk.FaceSizes.emplace_back(ItemCount);
+                }
+            }
+        });
+        return MergeChunks(Chunks, OutData) && OutData.Positions.size() == VertexElement->Count && OutData.GetFaceCount() == FaceCount;
+    }
+
+    if(Format != "binary_little_endian" && Format != "binary_big_endian") return false;
+
+    // Binary elements are read in place. Vertices have a fixed size. Faces are scanned once for their list sizes, and their indices
+    // are then copied in parallel.
+    const bool bIsSwapped = Format == "binary_big_endian";
+    // Each item takes at least the size of its scalars and list counts, so reject header counts that don't fit in the file before
+    // allocating for them.
+    size_t RemainingSize = size_t(End - P);
+    for(const auto& Element : Elements)
+    {
+        size_t MinItemSize = 0;
+        for(const auto& Property : Element.Properties) MinItemSize += GetPlyTypeSize(Property.bIsList ? Property.CountType : Property.Type);
+        if(MinItemSize == 0) continue;
+        if(Element.Count > RemainingSize / MinItemSize) return false;
+        RemainingSize -= Element.Count * MinItemSize;
+    }
+
+    std::vector<size_t> IndexListOffsets(FaceCount);
+    OutData.FaceOffsets.assign(FaceCount + 1, 0);
+    for(const auto& Element : Elements)
+    {
+        const bool bHasLists = std::any_of(Element.Properties.begin(), Element.Properties.end(), [](const PlyProperty& Property) { return Property.bIsList; });
+        if(!bHasLists)
+        {
+            std::vector<size_t> PropertyOffsets{0};
+            for(const auto& Property : Element.Properties) PropertyOffsets.emplace_back(PropertyOffsets.back() + GetPlyTypeSize(Property.Type));
+            const size_t Stride = PropertyOffsets.back();
+            if(Stride > 0 && Element.Count > size_t(End - P) / Stride) return false;
+
+            if(&Element == VertexElement)
+            {
+                OutData.Positions.resize(Element.Count);
+                ThreadPool::Get().ParallelFor(0, Element.Count, BinaryGrainSize, [&](size_t Begin, size_t End)
+                {
+                    for(size_t Vertex = Begin; Vertex < End; ++Vertex)
+                    {
+                        for(int Axis = 0; Axis < 3; ++Axis)
+                        {
+                            const PlyProperty& Property = Element.Properties[PositionProperties[Axis]];
+                            OutData.Positions[Vertex][Axis] = float(ReadPlyValue(P + Vertex * Stride + PropertyOffsets[PositionProperties[Axis]], Property.Type, bIsSwapped));
+                        }
+                    }
+                });
+            }
+            P += Stride * Element.Count;
+            continue;
+        }
+
+        for(size_t Item = 0; Item < Element.Count; ++Item)
+        {
+            for(int i = 0; i < int(Element.Properties.size()); ++i)
+            {
+                const PlyProperty& Property = Element.Properties[i];
+                const size_t Size = GetPlyTypeSize(Property.bIsList ? Property.CountType : Property.Type);
+                if(size_t(End - P) < Size) return false;
+                if(!Property.bIsList)
+                {
+                    P += Size;
+                    continue;
+                }
+
+                const double ItemCount = ReadPlyValue(P, Property.CountType, bIsSwapped);
+                if(ItemCount < 0 || ItemCount > double((size_t(End - P) - Size) / GetPlyTypeSize(Property.Type))) return false;
+                if(&Element == FaceElement && i == IndexProperty)
+                {
+                    IndexListOffsets[Item] = P + Size - Text.data();
+                    OutData.FaceOffsets[Item + 1] = uint(ItemCount);
+                }
+                P += Size + size_t(ItemCount) * GetPlyTypeSize(Property.Type);
+            }
+        }
+    }
+    if(!FaceElement) return true;
+
+    const PlyType IndexType = FaceElement->Properties[IndexProperty].Type;
+    std::partial_sum(OutData.FaceOffsets.begin(), OutData.FaceOffsets.end(), OutData.FaceOffsets.begin());
+    OutData.FaceVertices.resize(OutData.FaceOffsets.back());
+    std::atomic<bool> bIsValid = true;
+    ThreadPool::Get().ParallelFor(0, FaceCount, BinaryGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t Face = Begin; Face < End; ++Face)
+        {
+            const char* Index = Text.data() + IndexListOffsets[Face];
+            for(uint Corner = OutData.FaceOffsets[Face]; Corner < OutData.FaceOffsets[Face + 1]; ++Corner, Index += GetPlyTypeSize(IndexType))
+            {
+                const double Vertex = ReadPlyValue(Index, IndexType, bIsSwapped);
+                if(Vertex < 0 || Vertex >= double(OutData.Positions.size())) bIsValid = false;
+                OutData.FaceVertices[Corner] = uint(Vertex);
+            }
+        }
+    });
+    return bIsValid;
+}
+
+static std::string GetLowercaseExtension(const fs::path& InFilePath)
+{
+    std::string Extension = InFilePath.extension().string();
+    std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char C) { return char(std::tolower(C)); });
+    return Extension;
+}
+
+bool ReadMeshFile(const fs::path& InFilePath, MeshData& OutData)
+{
+    OutData = {};
+    const std::string Extension = GetLowercaseExtension(InFilePath);
+    if(Extension != ".obj" && Extension != ".ply" && Extension != ".stl" && Extension != ".off") return false;
+
+    const MappedFile File(InFilePath);
+    if(!File.IsOpen()) return false;
+
+    bool bIsRead = false;
+    if(Extension == ".obj") bIsRead = ReadObj(File.GetText(), OutData);
+    else if(Extension == ".ply") bIsRead = ReadPly(File.GetText(), OutData);
+    else if(Extension == ".stl") bIsRead = ReadStl(File.GetText(), OutData);
+    else bIsRead = ReadOff(File.GetText(), OutData);
+
+    if(!bIsRead) OutData = {};
+    return bIsRead;
+}
+
+// Formats `Count` records in chunks of `RecordsPerWriteChunk` with `Format(Begin, End, Out)`, in parallel batches. Each batch is written
+// by a separate task while the next one is formatted, so that formatting overlaps with I/O.
+template<typename ChunkFormatter>
+static void WriteChunks(std::ofstream& File, size_t Count, const ChunkFormatter& Format)
+{
+    const size_t RecordsPerBatch = (ThreadPool::Get().GetThreadCount() + 1) * WriteChunksPerThread * RecordsPerWriteChunk;
+    std::array<std::vector<std::string>, 2> Batches;
+    TaskGroup Writes;
+    for(size_t BatchBegin = 0, Batch = 0; BatchBegin < Count; BatchBegin += RecordsPerBatch, ++Batch)
+    {
+        const size_t BatchEnd = std::min(Count, BatchBegin + RecordsPerBatch);
+        std::vector<std::string>& Chunks = Batches[Batch % 2];
+        Chunks.resize((BatchEnd - BatchBegin + RecordsPerWriteChunk - 1) / RecordsPerWriteChunk);
+        ThreadPool::Get().ParallelFor(0, Chunks.size(), 1, [&](size_t Begin, size_t End)
+        {
+            for(size_t Chunk = Begin; Chunk < End; ++Chunk)
+            {
+                const size_t RecordBegin = BatchBegin + Chunk * RecordsPerWriteChunk;
+                Chunks[Chunk].clear();
+                Format(RecordBegin, std::min(BatchEnd, RecordBegin + RecordsPerWriteChunk), Chunks[Chunk]);
+            }
+        });
+        // The other buffer is free again once the previous batch is written.
+        Writes.Wait();
+        Writes.Run([&File, &Chunks]
+        {
+            for(const std::string& Chunk : Chunks) File.write(Chunk.data(), static_cast<std::streamsize>(Chunk.size()));
+        });
+    }
+    Writes.Wait();
+}
+
+template<typename T>
+static char* WriteNumber(char* P, T Value) { return std::to_chars(P, P + (std::is_floating_point_v<T> ? MaxFloatChars : MaxIntChars), Value).ptr; }
+
+template<typename T>
+static char* WriteBinary(char* P, const T& Value)
+{
+    std::memcpy(P, &Value, sizeof(T));
+    return P + sizeof(T);
+}
+
+// `Out` is sized for the largest possible records, which `Format(P)` writes to in place, and then shrunk to the written size.
+template<typename RecordFormatter>
+static void FormatInPlace(std::string& Out, size_t MaxSize, const RecordFormatter& Format)
+{
+    Out.resize(MaxSize);
+    char* const Begin = Out.data();
+    Out.resize(Format(Begin) - Begin);
+}
+
+static bool HasFaceLabels(const MeshData& Data, const MeshFileAttributes& Attributes) { return Attributes.FaceLabels.size() == Data.GetFaceCount(); }
+static bool HasFaceColors(const MeshData& Data, const MeshFileAttributes& Attributes) { return Attributes.FaceColors.size() == Data.GetFaceCount(); }
+
+static void WriteObj(std::ofstream& File, const MeshData& Data, const MeshFileAttributes& Attributes)
+{
+    WriteChunks(File, Data.GetVertexCount(), [&](size_t Begin, size_t End, std::string& Out)
+    {
+        FormatInPlace(Out, (End - Begin) * (3 * (MaxFloatChars + 1) + 2), [&](char* P)
+        {
+            for(size_t Vertex = Begin; Vertex < End; ++Vertex)
+            {
+                *P++ = 'v';
+                for(int Axis = 0; Axis < 3; ++Axis)
+                {
+                    *P++ = ' ';
+                    P = WriteNumber(P, Data.Positions[Vertex][Axis]);
+                }
+                *P++ = '\n';
+            }
+            return P;
+        });
+    });
+
+    // OBJ has no per-face attributes, so labels become groups, started whenever the label changes.
+    const bool bHasLabels = HasFaceLabels(Data, Attributes);
+    WriteChunks(File, Data.GetFaceCount(), [&](size_t Begin, size_t End, std::string& Out)
+    {
+        const size_t GroupSize = bHasLabels ? (End - Begin) * (MaxIntChars + 12) : 0;
+        FormatInPlace(Out, (Data.FaceOffsets[End] - Data.FaceOffsets[Begin]) * (MaxIntChars + 1) + (End - Begin) * 2 + GroupSize, [&](char* P)
+        {
+            for(size_t Face = Begin; Face < End; ++Face)
+            {
+                if(bHasLabels && (Face == 0 || Attributes.FaceLabels[Face] != Attributes.FaceLabels[Face - 1]))
+                {
+                    std::memcpy(P, "g segment_", 10);
+                    P = WriteNumber(P + 10, Attributes.FaceLabels[Face]);
+                    *P++ = '\n';
+                }
+                *P++ = 'f';
+                for(uint Corner = Data.FaceOffsets[Face]; Corner < Data.FaceOffsets[Face + 1]; ++Corner)
+                {
+                    *P++ = ' ';
+                    P = WriteNumber(P, Data.FaceVertices[Corner] + 1);
+                }
+                *P++ = '\n';
+            }
+            return P;
+        });
+    });
+}
+
+static void WritePly(std::ofstream& File, const MeshData& Data, const MeshFileAttributes& Attributes)
+{
+    const bool bHasLabels = HasFaceLabels(Data, Attributes), bHasColors = HasFaceColors(Data, Attributes);
+    File << "ply\nformat binary_little_endian 1.0\ncomment LinkEditor\n"
+         << "element vertex " << Data.GetVertexCount() << "\nproperty float x\nproperty float y\nproperty float z\n"
+         << "element face " << Data.GetFaceCount() << "\nproperty list uint int vertex_indices\n";
+    if(bHasLabels) File << "property int label\n";
+    if(bHasColors) File << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    File << "end_header\n";
+
+    // Positions are written as is. Like the reader, this assumes a little-endian host.
+    File.write(reinterpret_cast<const char*>(Data.Positions.data()), static_cast<std::streamsize>(Data.Positions.size() * sizeof(glm::vec3)));
+    WriteChunks(File, Data.GetFaceCount(), [&](size_t Begin, size_t End, std::string& Out)
+    {
+        const size_t FaceSize = sizeof(uint32_t) + (bHasLabels ? sizeof(int) : 0) + (bHasColors ? 3 : 0);
+        FormatInPlace(Out, (Data.FaceOffsets[End] - Data.FaceOffsets[Begin]) * sizeof(int) + (End - Begin) * FaceSize, [&](char* P)
+        {
+            for(size_t Face = Begin; Face < End; ++Face)
+            {
+                P = WriteBinary(P, uint32_t(Data.GetFaceSize(uint(Face))));
+                for(uint Corner = Data.FaceOffsets[Face]; Corner < Data.FaceOffsets[Face + 1]; ++Corner)
+                {
+                    P = WriteBinary(P, int(Data.FaceVertices[Corner]));
+                }
+                if(bHasLabels) P = WriteBinary(P, Attributes.FaceLabels[Face]);
+                if(bHasColors) P = WriteBinary(P, Attributes.FaceColors[Face]);
+            }
+            return P;
+        });
+    });
+}
+
+// Triangles of the faces as fans.
+static uint64_t GetStlTriangleCount(const MeshData& Data)
+{
+    uint64_t TriangleCount = 0;
+    for(uint Face = 0; Face < Data.GetFaceCount(); ++Face) TriangleCount += std::max(Data.GetFaceSize(Face), 2u) - 2;
+    return TriangleCount;
+}
+
+static void WriteStl(std::ofstream& File, const MeshData& Data, const MeshFileAttributes& Attributes)
+{
+    std::array<char, 80> Header{};
+    std::memcpy(Header.data(), "LinkEditor", 10);
+    File.write(Header.data(), Header.size());
+    const uint32_t StlTriangleCount = uint32_t(GetStlTriangleCount(Data));
+    File.write(reinterpret_cast<const char*>(&StlTriangleCount), sizeof(StlTriangleCount));
+
+    const bool bHasColors = HasFaceColors(Data, Attributes);
+    WriteChunks(File, Data.GetFaceCount(), [&](size_t Begin, size_t End, std::string& Out)
+    {
+        FormatInPlace(Out, (Data.FaceOffsets[End] - Data.FaceOffsets[Begin]) * 50, [&](char* P)
+        {
+            for(size_t Face = Begin; Face < End; ++Face)
+            {
+                // 15-bit colors in the attribute word, in the VisCAM/SolidView layout (bit 15 marks a valid color, red in the low bits).
+                uint16_t Color = 0;
+                if(bHasColors)
+                {
+                    const auto& [Red, Green, Blue] = Attributes.FaceColors[Face];
+                    Color = uint16_t(0x8000 | ((Blue >> 3) << 10) | ((Green >> 3) << 5) | (Red >> 3));
+                }
+                const uint First = Data.FaceOffsets[Face];
+                if(Data.GetFaceSize(uint(Face)) < 3) continue;
+
+                const glm::vec3& A = Data.Positions[Data.FaceVertices[First]];
+                for(uint Corner = First + 1; Corner + 1 < Data.FaceOffsets[Face + 1]; ++Corner)
+                {
+                    const glm::vec3& B = Data.Positions[Data.FaceVertices[Corner]], &C = Data.Positions[Data.FaceVertices[Corner + 1]];
+                    const glm::vec3 Normal = glm::cross(B - A, C - A);
+                    const float Length = glm::length(Normal);
+                    P = WriteBinary(P, Length > 0 ? Normal / Length : glm::vec3{0});
+                    P = WriteBinary(P, A);
+                    P = WriteBinary(P, B);
+                    P = WriteBinary(P, C);
+                    P = WriteBinary(P, Color);
+                }
+            }
+            return P;
+        });
+    });
+}
+
+bool WriteMeshFile(const fs::path& InFilePath, const MeshData& Data, const MeshFileAttributes& Attributes)
+{
+    const std::string Extension = GetLowercaseExtension(InFilePath);
+    if(Extension != ".obj" && Extension != ".ply" && Extension != ".stl") return false;
+    // Checked before the file is truncated, since the count is written first.
+    if(Extension == ".stl" && GetStlTriangleCount(Data) > std::numeric_limits<uint32_t>::max()) return false;
+
+    std::ofstream File(InFilePath, std::ios::binary | std::ios::trunc);
+    if(!File) return false;
+
+    if(Extension == ".obj") WriteObj(File, Data, Attributes);
+    else if(Extension == ".ply") WritePly(File, Data, Attributes);
+    else WriteStl(File, Data, Attributes);
+    return File.good();
+}
+
+LINK_EDITOR_NAMESPACE_END
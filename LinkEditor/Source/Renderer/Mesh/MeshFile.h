@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include "pch.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Polygon mesh as flat arrays, as read from mesh files. Face `f` has the vertices `FaceVertices[FaceOffsets[f]]` up to
+// `FaceVertices[FaceOffsets[f + 1] - 1]`.
+struct MeshData
+{
+    std::vector<glm::vec3> Positions;
+    std::vector<uint> FaceOffsets{0};
+    std::vector<uint> FaceVertices;
+
+    uint GetVertexCount() const { return static_cast<uint>(Positions.size()); }
+    uint GetFaceCount() const { return static_cast<uint>(FaceOffsets.size() - 1); }
+    uint GetFaceSize(uint Face) const { return FaceOffsets[Face + 1] - FaceOffsets[Face]; }
+};
+
+// Native readers for OBJ, PLY, STL and OFF files. Files are memory-mapped; text is parsed in parallel chunks of lines, and binary
+// PLY and STL data is read in place. Only positions and faces are read.
+// Returns false, leaving `OutData` empty, for other formats and for content these readers don't handle (e.g. binary OFF, or OBJ
+// line continuations), so that the caller can fall back to a general reader.
+bool ReadMeshFile(const fs::path& InFilePath, MeshData& OutData);
+
+// Per-face attributes written along with a mesh. Each is only written if it has one value per face.
+struct MeshFileAttributes
+{
+    std::vector<int> FaceLabels; // Segmentation labels.
+    std::vector<std::array<uint8_t, 3>> FaceColors;
+};
+
+// Writes binary PLY, OBJ or binary STL, chosen by the extension. Records are formatted in parallel chunks (numbers with `std::to_chars`),
+// and each batch of chunks is written while the next one is formatted.
+// PLY stores labels and colors as face properties, OBJ starts a group `segment_<label>` at each label change, and STL stores colors in
+// each triangle's attribute word. STL faces are written as triangle fans.
+// Returns false for other extensions, for STL files of more than 2^32 - 1 triangles, and on write errors.
+bool WriteMeshFile(const fs::path& InFilePath, const MeshData& Data, const MeshFileAttributes& Attributes = {});
+
+LINK_EDITOR_NAMESPACE_END
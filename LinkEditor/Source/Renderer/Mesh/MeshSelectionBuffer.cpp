@@ -0,0 +1,85 @@
+﻿#include "MeshSelectionBuffer.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static constexpr uint MaxDirtyWordGap = 16; // Dirty words closer than this are uploaded together.
+
+MeshSelectionBuffer::MeshSelectionBuffer(const Mesh& InMesh)
+    : ElementCounts{InMesh.GetFaceCount(), InMesh.GetEdgeCount(), InMesh.GetVertexCount()}
+{
+    Words.resize(SectionCount, 0);
+    uint Offset = 0;
+    for (uint Section = 0; Section < SectionCount; ++Section)
+    {
+        Words[Section] = Offset;
+        Offset += (ElementCounts[Section / 2] + 31) / 32;
+    }
+    Words.resize(SectionCount + Offset, 0);
+    SelectionStorage = std::make_unique<StorageBuffer>(Words.data(), uint32_t(Words.size() * sizeof(uint)), SelectionBinding);
+
+    std::vector<uint> TriangleFaces = InMesh.CreateTriangleFaces();
+    if (TriangleFaces.empty()) TriangleFaces.push_back(0); // Storage buffers can't be empty.
+    TriangleFacesStorage = std::make_unique<StorageBuffer>(TriangleFaces.data(), uint32_t(TriangleFaces.size() * sizeof(uint)), TriangleFacesBinding);
+}
+
+void MeshSelectionBuffer::SetSelected(const std::vector<Mesh::ElementIndex>& Elements)
+{
+    if (Elements == Selected) return;
+
+    SetBits(Selected, false, false);
+    SetBits(Elements, false, true);
+    Selected = Elements;
+    UploadDirtyWords();
+}
+
+void MeshSelectionBuffer::SetHovered(const std::vector<Mesh::ElementIndex>& Elements)
+{
+    if (Elements == Hovered) return;
+
+    SetBits(Hovered, true, false);
+    SetBits(Elements, true, true);
+    Hovered = Elements;
+    UploadDirtyWords();
+}
+
+void MeshSelectionBuffer::Bind() const
+{
+    SelectionStorage->Bind();
+    TriangleFacesStorage->Bind();
+}
+
+void MeshSelectionBuffer::SetBits(const std::vector<Mesh::ElementIndex>& Elements, bool bIsHovered, bool bValue)
+{
+    for (const auto& Element : Elements)
+    {
+        uint Section;
+        switch (Element.ElementType) {
+        case MeshElementType::Face: Section = FaceSelected; break;
+        case MeshElementType::Edge: Section = EdgeSelected; break;
+        case MeshElementType::Vertex: Section = VertexSelected; break;
+        default: continue;
+        }
+        if (!Element.IsValid() || uint(Element.Idx()) >= ElementCounts[Section / 2]) continue;
+
+        Section += bIsHovered ? 1 : 0;
+        const uint Word = SectionCount + Words[Section] + uint(Element.Idx()) / 32, Bit = 1u << (uint(Element.Idx()) % 32);
+        Words[Word] = bValue ? Words[Word] | Bit : Words[Word] & ~Bit;
+        DirtyWords.push_back(Word);
+    }
+}
+
+void MeshSelectionBuffer::UploadDirtyWords()
+{
+    std::sort(DirtyWords.begin(), DirtyWords.end());
+    DirtyWords.erase(std::unique(DirtyWords.begin(), DirtyWords.end()), DirtyWords.end());
+    for (size_t i = 0; i < DirtyWords.size();)
+    {
+        const uint First = DirtyWords[i];
+        uint Last = First;
+        for (++i; i < DirtyWords.size() && DirtyWords[i] - Last <= MaxDirtyWordGap; ++i) Last = DirtyWords[i];
+        SelectionStorage->SetData(Words.data() + First, (Last - First + 1) * sizeof(uint), First * sizeof(uint));
+    }
+    DirtyWords.clear();
+}
+
+LINK_EDITOR_NAMESPACE_END
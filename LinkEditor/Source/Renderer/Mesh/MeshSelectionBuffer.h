@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "Renderer/Mesh/Mesh.h"
+#include "Renderer/Buffers/StorageBuffer.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Selection and hover state of a mesh for the mesh shaders: one bit per face, edge and vertex in a storage buffer (`MeshSelectionSSBO`),
+// and the face of each triangle of the face buffer in another (`TriangleFacesSSBO`), so that the fragment shader finds the face of
+// `gl_PrimitiveID`. Changing the selection uploads only the words whose bits changed, instead of the vertex buffers.
+class MeshSelectionBuffer
+{
+public:
+    inline static constexpr uint32_t SelectionBinding = 3;
+    inline static constexpr uint32_t TriangleFacesBinding = 4;
+
+    MeshSelectionBuffer(const Mesh& InMesh);
+
+    // Each replaces the previous elements. Elements of any type may be mixed.
+    void SetSelected(const std::vector<Mesh::ElementIndex>& Elements);
+    void SetHovered(const std::vector<Mesh::ElementIndex>& Elements);
+
+    void Bind() const;
+
+private:
+    // Bit arrays, in the order of their word offsets at the start of the buffer.
+    enum Section : uint
+    {
+        FaceSelected,
+        FaceHovered,
+        EdgeSelected,
+        EdgeHovered,
+        VertexSelected,
+        VertexHovered,
+        SectionCount,
+    };
+
+    void SetBits(const std::vector<Mesh::ElementIndex>& Elements, bool bIsHovered, bool bValue);
+    void UploadDirtyWords();
+
+private:
+    uint ElementCounts[SectionCount / 2]; // Faces, edges and vertices.
+    std::vector<uint> Words;              // Section offsets (relative to the end of the offsets), followed by the sections.
+    std::vector<uint> DirtyWords;
+    std::vector<Mesh::ElementIndex> Selected, Hovered;
+    std::unique_ptr<StorageBuffer> SelectionStorage;
+    std::unique_ptr<StorageBuffer> TriangleFacesStorage;
+};
+
+LINK_EDITOR_NAMESPACE_END
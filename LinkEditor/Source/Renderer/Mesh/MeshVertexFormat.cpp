@@ -0,0 +1,69 @@
+﻿#include "MeshVertexFormat.h"
+#include "Renderer/Mesh/MeshCodec.h"
+
+#include <glm/packing.hpp>
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static_assert(sizeof(MeshVertex) == 48 && sizeof(PackedMeshVertex) == 24 && sizeof(QuantizedMeshVertex) == 20);
+
+uint GetMeshVertexSize(MeshVertexFormat Format)
+{
+    switch(Format)
+    {
+    case MeshVertexFormat::Float: return sizeof(MeshVertex);
+    case MeshVertexFormat::Packed: return sizeof(PackedMeshVertex);
+    case MeshVertexFormat::Quantized: return sizeof(QuantizedMeshVertex);
+    }
+    return 0;
+}
+
+uint32_t PackNormal(const glm::vec3& Normal)
+{
+    return glm::packSnorm2x16(EncodeOctahedral(Normal));
+}
+
+MeshVertexDecoding::MeshVertexDecoding(MeshVertexFormat Format, const BoundingBox& Bounds)
+    : Format(Format)
+{
+    if(Format == MeshVertexFormat::Quantized && Bounds.IsValid())
+    {
+        PositionOffset = glm::vec4{Bounds.Min, 0};
+        PositionScale = glm::vec4{Bounds.Max - Bounds.Min, 0}; // Normalized shorts are in `[0, 1]`.
+    }
+}
+
+MeshVertexWriter::MeshVertexWriter(MeshVertexFormat Format, const BoundingBox& Bounds, void* Data)
+    : Format(Format), Data(static_cast<char*>(Data))
+{
+    const MeshVertexDecoding Decoding(Format, Bounds);
+    QuantizationOffset = Decoding.PositionOffset;
+    for(int Axis = 0; Axis < 3; ++Axis)
+    {
+        QuantizationScale[Axis] = Decoding.PositionScale[Axis] > 0 ? 65535.f / Decoding.PositionScale[Axis] : 0.f;
+    }
+}
+
+void MeshVertexWriter::Write(size_t Index, const glm::vec3& Position, const glm::vec4& Color, const glm::vec3& Normal, const glm::vec2& TexCoord) const
+{
+    if(Format == MeshVertexFormat::Float)
+    {
+        reinterpret_cast<MeshVertex*>(Data)[Index] = {Position, Color, Normal, TexCoord};
+        return;
+    }
+
+    const uint32_t PackedColor = glm::packUnorm4x8(Color);
+    const uint32_t PackedNormal = PackNormal(Normal);
+    const uint32_t PackedTexCoord = glm::packHalf2x16(TexCoord);
+    if(Format == MeshVertexFormat::Packed)
+    {
+        reinterpret_cast<PackedMeshVertex*>(Data)[Index] = {Position, PackedColor, PackedNormal, PackedTexCoord};
+    }
+    else
+    {
+        const glm::vec3 Quantized = glm::clamp(glm::round((Position - QuantizationOffset) * QuantizationScale), 0.f, 65535.f);
+        reinterpret_cast<QuantizedMeshVertex*>(Data)[Index] = {{uint16_t(Quantized.x), uint16_t(Quantized.y), uint16_t(Quantized.z), 0}, PackedColor, PackedNormal, PackedTexCoord};
+    }
+}
+
+LINK_EDITOR_NAMESPACE_END
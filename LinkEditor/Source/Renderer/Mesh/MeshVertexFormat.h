@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+struct MeshVertex
+{
+    glm::vec3 Position;
+    glm::vec4 Color;
+    glm::vec3 Normal;
+    glm::vec2 TexCoord;
+};
+
+// Float positions, RGBA8 colors, octahedral normals as two normalized shorts, and half float texture coordinates.
+struct PackedMeshVertex
+{
+    glm::vec3 Position;
+    uint32_t Color;
+    uint32_t Normal;
+    uint32_t TexCoord;
+};
+
+// `PackedMeshVertex` with positions quantized to 16 bits over the mesh bounds.
+struct QuantizedMeshVertex
+{
+    uint16_t Position[4]; // The fourth component keeps the attributes 4-byte aligned.
+    uint32_t Color;
+    uint32_t Normal;
+    uint32_t TexCoord;
+};
+
+enum class MeshVertexFormat
+{
+    Float,     // `MeshVertex`, 48 bytes.
+    Packed,    // `PackedMeshVertex`, 24 bytes.
+    Quantized, // `QuantizedMeshVertex`, 20 bytes. Positions are within 1/65535 of the bounds' extent.
+};
+
+uint GetMeshVertexSize(MeshVertexFormat Format);
+// Octahedral normal as two normalized shorts, as in packed vertices and face normal buffers. Unpacked with `unpackSnorm2x16` in GLSL.
+uint32_t PackNormal(const glm::vec3& Normal);
+
+// Maps the position attribute back to local positions in the shaders, as `PositionOffset + a_Position * PositionScale`, and tells
+// them how normals are encoded.
+struct MeshVertexDecoding
+{
+    MeshVertexFormat Format = MeshVertexFormat::Float;
+    glm::vec4 PositionOffset{0};
+    glm::vec4 PositionScale{1};
+
+    MeshVertexDecoding() = default;
+    MeshVertexDecoding(MeshVertexFormat Format, const BoundingBox& Bounds);
+};
+
+// Writes render vertices in any format, e.g. from parallel tasks, each to its own indices.
+class MeshVertexWriter
+{
+public:
+    MeshVertexWriter(MeshVertexFormat Format, const BoundingBox& Bounds, void* Data);
+
+    void Write(size_t Index, const glm::vec3& Position, const glm::vec4& Color, const glm::vec3& Normal, const glm::vec2& TexCoord = glm::vec2{0}) const;
+
+private:
+    MeshVertexFormat Format;
+    glm::vec3 QuantizationOffset, QuantizationScale; // To `[0, 65535]`.
+    char* Data;
+};
+
+LINK_EDITOR_NAMESPACE_END
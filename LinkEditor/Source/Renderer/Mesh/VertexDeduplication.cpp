@@ -0,0 +1,310 @@
+﻿#include "VertexDeduplication.h"
+#include "Core/Thread/ThreadPool.h"
+#include <cstring>
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+static constexpr size_t RemapGrainSize = 65536;
+static constexpr size_t BucketTargetSize = 4096; // Records per hash bucket, so each bucket's table stays in cache.
+static constexpr uint MaxBucketBits = 16;
+static constexpr float WeldGridResolution = 1024; // Maximum number of weld grid cells along the longest axis of the bounds.
+
+// Maps float bits to an unsigned key with the same order, and merges `-0` into `+0`.
+static uint32_t OrderedKey(float Value)
+{
+    uint32_t Bits = 0;
+    if(Value != 0) std::memcpy(&Bits, &Value, sizeof(Bits));
+    return Bits & 0x80000000u ? ~Bits : Bits | 0x80000000u;
+}
+
+// Mixes the position keys into a well-distributed hash (the 64-bit finalizer of MurmurHash3), so grids and symmetric data don't collide.
+static uint64_t HashKey(const glm::uvec3& Key)
+{
+    uint64_t Hash = (uint64_t(Key.x) << 32 | Key.y) ^ (uint64_t(Key.z) * 0x9E3779B97F4A7C15ull);
+    Hash ^= Hash >> 33;
+    Hash *= 0xFF51AFD7ED558CCDull;
+    Hash ^= Hash >> 33;
+    Hash *= 0xC4CEB9FE1A85EC53ull;
+    Hash ^= Hash >> 33;
+    return Hash;
+}
+
+struct KeyedVertex
+{
+    glm::uvec3 Key;
+    uint Index;
+};
+
+static size_t BucketOfKey(const glm::uvec3& Key, uint BucketBits)
+{
+    return BucketBits == 0 ? 0 : size_t(HashKey(Key) >> (64 - BucketBits));
+}
+
+// Scatters the vertices' `{Key(i), i}` records into `2^BucketBits` buckets by the top bits of their key hash, in parallel.
+// Records keep increasing indices within each bucket. Bucket `b` spans `[BucketOffsetsOut[b], BucketOffsetsOut[b + 1])`.
+template<typename KeyFunction>
+static void PartitionByKeyHash(size_t Count, uint BucketBits, const KeyFunction& Key, std::vector<KeyedVertex>& RecordsOut, std::vector<size_t>& BucketOffsetsOut)
+{
+    const size_t BucketCount = size_t(1) << BucketBits;
+    const auto BucketOf = [BucketBits](const glm::uvec3& VertexKey) { return BucketOfKey(VertexKey, BucketBits); };
+
+    // Fixed chunks, so both passes agree on the ranges. Offsets are bucket-major, so chunks stay in order within a bucket.
+    const size_t ChunkCount = std::max<size_t>(1, std::min<size_t>((ThreadPool::Get().GetThreadCount() + 1) * 4, Count / RemapGrainSize));
+    const size_t ChunkSize = (Count + ChunkCount - 1) / ChunkCount;
+    std::vector<size_t> ChunkOffsets(BucketCount * ChunkCount, 0);
+    ThreadPool::Get().ParallelFor(0, ChunkCount, 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for(size_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            for(size_t i = Chunk * ChunkSize; i < std::min(Count, (Chunk + 1) * ChunkSize); ++i) ++ChunkOffsets[BucketOf(Key(i)) * ChunkCount + Chunk];
+        }
+    });
+
+    BucketOffsetsOut.assign(BucketCount + 1, 0);
+    size_t Offset = 0;
+    for(size_t Bucket = 0; Bucket < BucketCount; ++Bucket)
+    {
+        BucketOffsetsOut[Bucket] = Offset;
+        for(size_t Chunk = 0; Chunk < ChunkCount; ++Chunk)
+        {
+            const size_t ChunkCountInBucket = ChunkOffsets[Bucket * ChunkCount + Chunk];
+            ChunkOffsets[Bucket * ChunkCount + Chunk] = Offset;
+            Offset += ChunkCountInBucket;
+        }
+    }
+    BucketOffsetsOut[BucketCount] = Offset;
+
+    RecordsOut.resize(Count);
+    ThreadPool::Get().ParallelFor(0, ChunkCount, 1, [&](size_t ChunkBegin, size_t ChunkEnd)
+    {
+        for(size_t Chunk = ChunkBegin; Chunk < ChunkEnd; ++Chunk)
+        {
+            for(size_t i = Chunk * ChunkSize; i < std::min(Count, (Chunk + 1) * ChunkSize); ++i)
+            {
+                const glm::uvec3 VertexKey = Key(i);
+                RecordsOut[ChunkOffsets[BucketOf(VertexKey) * ChunkCount + Chunk]++] = {VertexKey, static_cast<uint>(i)};
+            }
+        }
+    });
+}
+
+static uint BucketBitsFor(size_t Count)
+{
+    uint BucketBits = 0;
+    while(BucketBits < MaxBucketBits && (Count >> BucketBits) > BucketTargetSize) ++BucketBits;
+    return BucketBits;
+}
+
+// Numbers the vertices that are their own first occurrence in order, and resolves all others through them.
+static VertexRemap NumberFirstOccurrences(const std::vector<uint>& FirstOccurrences)
+{
+    const size_t Count = FirstOccurrences.size();
+    VertexRemap Remap;
+    Remap.NewIndices.resize(Count);
+    for(size_t i = 0; i < Count; ++i)
+    {
+        if(FirstOccurrences[i] == i) Remap.NewIndices[i] = Remap.UniqueCount++;
+    }
+    ThreadPool::Get().ParallelFor(0, Count, RemapGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t i = Begin; i < End; ++i)
+        {
+            if(FirstOccurrences[i] != i) Remap.NewIndices[i] = Remap.NewIndices[FirstOccurrences[i]];
+        }
+    });
+    return Remap;
+}
+
+VertexRemap CreateExactVertexRemap(const glm::vec3* Positions, size_t Count)
+{
+    // Partition the vertices by position hash into cache-sized buckets, then deduplicate each bucket independently with a small
+    // open-addressing table. Equal positions always land in the same bucket.
+    std::vector<KeyedVertex> Records;
+    std::vector<size_t> BucketOffsets;
+    const auto Key = [Positions](size_t i) { return glm::uvec3(OrderedKey(Positions[i].x), OrderedKey(Positions[i].y), OrderedKey(Positions[i].z)); };
+    PartitionByKeyHash(Count, BucketBitsFor(Count), Key, Records, BucketOffsets);
+
+    std::vector<uint> FirstOccurrences(Count);
+    ThreadPool::Get().ParallelFor(0, BucketOffsets.size() - 1, 1, [&](size_t BucketBegin, size_t BucketEnd)
+    {
+        static constexpr uint EmptySlot = std::numeric_limits<uint>::max();
+        std::vector<uint> Slots; // Index of the first record with each key in the bucket.
+        for(size_t Bucket = BucketBegin; Bucket < BucketEnd; ++Bucket)
+        {
+            const size_t First = BucketOffsets[Bucket], Last = BucketOffsets[Bucket + 1];
+            size_t SlotCount = 16;
+            while(SlotCount < (Last - First) * 2) SlotCount *= 2;
+            Slots.assign(SlotCount, EmptySlot);
+
+            // Records are in increasing vertex order, so the first record inserted for a key is its first occurrence.
+            for(size_t Record = First; Record < Last; ++Record)
+            {
+                const KeyedVertex& Vertex = Records[Record];
+                size_t Slot = HashKey(Vertex.Key) & (SlotCount - 1);
+                while(Slots[Slot] != EmptySlot && Records[Slots[Slot]].Key != Vertex.Key) Slot = (Slot + 1) & (SlotCount - 1);
+                if(Slots[Slot] == EmptySlot) Slots[Slot] = static_cast<uint>(Record);
+                FirstOccurrences[Vertex.Index] = Records[Slots[Slot]].Index;
+            }
+        }
+    });
+    return NumberFirstOccurrences(FirstOccurrences);
+}
+
+// Lock-free union-find whose roots are the smallest index of their set, so the result does not depend on the order of unions.
+static uint FindRoot(std::vector<std::atomic<uint>>& Parents, uint Index)
+{
+    uint Parent = Parents[Index].load(std::memory_order_relaxed);
+    while(Parent != Index)
+    {
+        // Path halving. Losing the race to another thread is harmless, since both only shorten the path.
+        const uint GrandParent = Parents[Parent].load(std::memory_order_relaxed);
+        Parents[Index].compare_exchange_weak(Parent, GrandParent, std::memory_order_relaxed);
+        Index = GrandParent;
+        Parent = Parents[Index].load(std::memory_order_relaxed);
+    }
+    return Index;
+}
+
+static void Unite(std::vector<std::atomic<uint>>& Parents, uint A, uint B)
+{
+    while(true)
+    {
+        A = FindRoot(Parents, A);
+        B = FindRoot(Parents, B);
+        if(A == B) return;
+        if(A > B) std::swap(A, B);
+        // Link the larger root under the smaller one, unless another thread linked it in the meantime.
+        uint Expected = B;
+        if(Parents[B].compare_exchange_strong(Expected, A, std::memory_order_relaxed)) return;
+    }
+}
+
+VertexRemap CreateWeldVertexRemap(const glm::vec3* Positions, size_t Count, float Tolerance, const BoundingBox& Bounds)
+{
+    if(Tolerance <= 0 || Count == 0)
+    {
+        return CreateExactVertexRemap(Positions, Count);
+    }
+
+    // Cells are at least as large as the tolerance, so vertices within tolerance are in the same or adjacent cells. Much larger cells
+    // make most vertices farther than the tolerance from their cell's sides, so that they don't need to look at neighbour cells.
+    const glm::vec3 Extent = Bounds.Max - Bounds.Min;
+    const float CellSize = std::max(Tolerance, std::max({Extent.x, Extent.y, Extent.z}) / WeldGridResolution);
+    const auto Cell = [&](size_t i) { return glm::uvec3(glm::clamp((Positions[i] - Bounds.Min) / CellSize, glm::vec3(0), glm::vec3(WeldGridResolution))); };
+    const uint BucketBits = BucketBitsFor(Count);
+    std::vector<KeyedVertex> Records;
+    std::vector<size_t> BucketOffsets;
+    PartitionByKeyHash(Count, BucketBits, Cell, Records, BucketOffsets);
+    const size_t BucketCount = BucketOffsets.size() - 1;
+
+    // Group each bucket's records by cell and sort them along x within the cell, and count the cells to size the cell tables.
+    std::vector<size_t> TableOffsets(BucketCount + 1, 0);
+    ThreadPool::Get().ParallelFor(0, BucketCount, 1, [&](size_t BucketBegin, size_t BucketEnd)
+    {
+        for(size_t Bucket = BucketBegin; Bucket < BucketEnd; ++Bucket)
+        {
+            const auto First = Records.begin() + BucketOffsets[Bucket], Last = Records.begin() + BucketOffsets[Bucket + 1];
+            std::sort(First, Last, [Positions](const KeyedVertex& A, const KeyedVertex& B)
+            {
+                return std::tie(A.Key.x, A.Key.y, A.Key.z, Positions[A.Index].x) < std::tie(B.Key.x, B.Key.y, B.Key.z, Positions[B.Index].x);
+            });
+            size_t CellCount = 0;
+            for(auto Record = First; Record != Last; ++Record) CellCount += Record == First || Record->Key != (Record - 1)->Key;
+            size_t SlotCount = 16;
+            while(SlotCount < CellCount * 2) SlotCount *= 2;
+            TableOffsets[Bucket + 1] = SlotCount;
+        }
+    });
+    for(size_t Bucket = 0; Bucket < BucketCount; ++Bucket) TableOffsets[Bucket + 1] += TableOffsets[Bucket];
+
+    // Open-addressing tables mapping each cell to its record range `[x, y)`, one per bucket.
+    static constexpr uint EmptySlot = std::numeric_limits<uint>::max();
+    std::vector<glm::uvec2> CellTable(TableOffsets.back(), glm::uvec2(EmptySlot));
+    const auto FindCellSlot = [&](const glm::uvec3& CellKey, size_t Bucket)
+    {
+        const size_t SlotMask = TableOffsets[Bucket + 1] - TableOffsets[Bucket] - 1;
+        size_t Slot = HashKey(CellKey) & SlotMask;
+        while(CellTable[TableOffsets[Bucket] + Slot].x != EmptySlot && Records[CellTable[TableOffsets[Bucket] + Slot].x].Key != CellKey) Slot = (Slot + 1) & SlotMask;
+        return TableOffsets[Bucket] + Slot;
+    };
+    ThreadPool::Get().ParallelFor(0, BucketCount, 1, [&](size_t BucketBegin, size_t BucketEnd)
+    {
+        for(size_t Bucket = BucketBegin; Bucket < BucketEnd; ++Bucket)
+        {
+            for(size_t First = BucketOffsets[Bucket], Last; First < BucketOffsets[Bucket + 1]; First = Last)
+            {
+                for(Last = First + 1; Last < BucketOffsets[Bucket + 1] && Records[Last].Key == Records[First].Key; ++Last) {}
+                CellTable[FindCellSlot(Records[First].Key, Bucket)] = glm::uvec2(First, Last);
+            }
+        }
+    });
+
+    std::vector<std::atomic<uint>> Parents(Count);
+    ThreadPool::Get().ParallelFor(0, Count, RemapGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t i = Begin; i < End; ++i) Parents[i].store(static_cast<uint>(i), std::memory_order_relaxed);
+    });
+
+    // Unite each vertex with the vertices within tolerance among the later records of its cell, and in the 13 neighbour cells with
+    // a larger offset that it is close enough to, so that each pair is tested once. Records of a cell are swept along x.
+    const float ToleranceSquared = Tolerance * Tolerance;
+    const float SideDistance = Tolerance * 1.001f + CellSize * 1e-5f; // Slack for the rounding of cell coordinates.
+    ThreadPool::Get().ParallelFor(0, BucketCount, 1, [&](size_t BucketBegin, size_t BucketEnd)
+    {
+        for(size_t Bucket = BucketBegin; Bucket < BucketEnd; ++Bucket)
+        {
+            for(size_t Record = BucketOffsets[Bucket]; Record < BucketOffsets[Bucket + 1]; ++Record)
+            {
+                const KeyedVertex& Vertex = Records[Record];
+                const glm::vec3& Position = Positions[Vertex.Index];
+                const auto UniteInRange = [&](size_t Other, size_t Last)
+                {
+                    for(; Other < Last && Positions[Records[Other].Index].x <= Position.x + Tolerance; ++Other)
+                    {
+                        const glm::vec3 Offset = Positions[Records[Other].Index] - Position;
+                        if(glm::dot(Offset, Offset) <= ToleranceSquared) Unite(Parents, Vertex.Index, Records[Other].Index);
+                    }
+                };
+
+                size_t CellEnd = Record + 1;
+                while(CellEnd < BucketOffsets[Bucket + 1] && Records[CellEnd].Key == Vertex.Key) ++CellEnd;
+                UniteInRange(Record + 1, CellEnd);
+
+                const glm::vec3 CellPosition = (Position - Bounds.Min) - glm::vec3(Vertex.Key) * CellSize;
+                const glm::bvec3 IsNearLow = glm::lessThanEqual(CellPosition, glm::vec3(SideDistance));
+                const glm::bvec3 IsNearHigh = glm::greaterThanEqual(CellPosition, glm::vec3(CellSize - SideDistance));
+                if(!glm::any(IsNearLow) && !glm::any(IsNearHigh)) continue;
+
+                for(uint Neighbour = 14; Neighbour < 27; ++Neighbour)
+                {
+                    const glm::ivec3 Direction = glm::ivec3(Neighbour % 3, Neighbour / 3 % 3, Neighbour / 9) - glm::ivec3(1);
+                    bool bIsNear = true;
+                    for(uint Axis = 0; Axis < 3; ++Axis)
+                    {
+                        bIsNear &= Direction[Axis] == 0 || (Direction[Axis] < 0 ? IsNearLow[Axis] : IsNearHigh[Axis]);
+                    }
+                    if(!bIsNear) continue;
+
+                    const glm::uvec3 NeighbourCell = Vertex.Key + glm::uvec3(Direction);
+                    const glm::uvec2 Range = CellTable[FindCellSlot(NeighbourCell, BucketOfKey(NeighbourCell, BucketBits))];
+                    if(Range.x == EmptySlot) continue;
+
+                    const auto First = std::partition_point(Records.begin() + Range.x, Records.begin() + Range.y, [&](const KeyedVertex& Other)
+                    {
+                        return Positions[Other.Index].x < Position.x - Tolerance;
+                    });
+                    UniteInRange(First - Records.begin(), Range.y);
+                }
+            }
+        }
+    });
+
+    std::vector<uint> FirstOccurrences(Count);
+    ThreadPool::Get().ParallelFor(0, Count, RemapGrainSize, [&](size_t Begin, size_t End)
+    {
+        for(size_t i = Begin; i < End; ++i) FirstOccurrences[i] = FindRoot(Parents, static_cast<uint>(i));
+    });
+    return NumberFirstOccurrences(FirstOccurrences);
+}
+
+LINK_EDITOR_NAMESPACE_END
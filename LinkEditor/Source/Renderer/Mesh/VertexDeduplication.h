@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include "pch.h"
+#include "Renderer/AccelerationStructures/BoundingBox/BoundingBox.h"
+
+LINK_EDITOR_NAMESPACE_BEGIN
+
+// Old-to-new vertex index table of a vertex deduplication. New indices are numbered in order of first occurrence,
+// so deduplicating an already unique vertex list yields the identity.
+struct VertexRemap
+{
+    std::vector<uint> NewIndices; // New index of each old vertex.
+    uint UniqueCount = 0;
+};
+
+// Merges vertices with identical positions (`-0` and `+0` are equal). Vertices are partitioned by position hash into cache-sized
+// buckets, which are deduplicated in parallel with small per-bucket hash tables.
+VertexRemap CreateExactVertexRemap(const glm::vec3* Positions, size_t Count);
+
+// Merges vertices within `Tolerance` of each other, transitively: each cluster is a connected component of the "within tolerance"
+// graph, and keeps the position of its first vertex. Neighbours are found in a uniform hash grid over `Bounds`, with cells no smaller
+// than the tolerance, partitioned into cache-sized buckets that are processed in parallel. Falls back to `CreateExactVertexRemap` for a zero tolerance.
+VertexRemap CreateWeldVertexRemap(const glm::vec3* Positions, size_t Count, float Tolerance, const BoundingBox& Bounds);
+
+LINK_EDITOR_NAMESPACE_END
@@ -70,6 +70,10 @@ void Renderer::UpdateShaderData(std::vector<ShaderBindingDescriptor>&& Descripto
             {
                 Shader->UploadUniformMat4(Descriptor.BindingName, Descriptor.MatrixData.value());
             }
+            else if (Descriptor.IntData.has_value())
+            {
+                Shader->UploadUniformInt(Descriptor.BindingName, Descriptor.IntData.value());
+            }
         }
     }
 }
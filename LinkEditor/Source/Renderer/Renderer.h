@@ -75,6 +75,7 @@ struct ShaderBindingDescriptor
     std::optional<float> ScalarData = std::nullopt;
     std::optional<glm::vec4> VectorData = std::nullopt;
     std::optional<glm::mat4> MatrixData = std::nullopt;
+    std::optional<int> IntData = std::nullopt;
 };
 
 struct ShaderBindingData
@@ -2,6 +2,8 @@
 #include "Renderer/Buffers/IndexBuffer.h"
 #include "Renderer/Mesh/Mesh.h"
 #include "Renderer/Gizmo/Gizmo.h"
+#include "Renderer/Ray/Ray.h"
+#include "Core/Thread/ThreadPool.h"
 
 LINK_EDITOR_NAMESPACE_BEGIN
 
@@ -46,7 +48,40 @@ void Scene::SetViewportSize(uint32_t Width, uint32_t Height)
     SceneRenderer->GetFrameBuffer()->Resize(Width, Height);
 }
 
+entt::entity Scene::AddMesh(std::unique_ptr<Mesh> InMesh, MeshCreateInfo InMeshCreateInfo)
+{
+    MeshBufferMap MeshBuffers;
+    const MeshVertexFormat VertexFormat = Mesh::RenderVertexFormat;
+    for (const auto& [ElementType, Format, VertexData, Indices, bSharesVertexBuffers] : InMesh->CreateElementBuffers(VertexFormat))
+    {
+        if (bSharesVertexBuffers)
+        {
+            MeshBuffers.emplace(ElementType, MeshBuffers.at(MeshElementType::Vertex));
+            continue;
+        }
+
+        auto VertexArrayBuffer = std::make_shared<VertexArray>();
+        auto VertexBufferObject = std::make_shared<VertexBuffer>(VertexData.size());
+        VertexBufferObject->SetLayout(CreateDefaultVertexLayout(Format));
+        VertexBufferObject->SetData(VertexData.data(), VertexData.size());
+        VertexArrayBuffer->AddVertexBuffer(VertexBufferObject);
+
+        auto IndexBufferObject = std::make_shared<IndexBuffer>(Indices.data(), Indices.size());
+        VertexArrayBuffer->SetIndexBuffer(IndexBufferObject);
+        MeshBuffers.emplace(ElementType, VertexArrayBuffer);
+    }
+
+    const auto FaceNormals = InMesh->CreateFaceNormals();
+    return AddMesh(std::move(InMesh), std::move(InMeshCreateInfo), std::move(MeshBuffers), VertexFormat, FaceNormals);
+}
+
 entt::entity Scene::AddMesh(Mesh&& InMesh, MeshCreateInfo InMeshCreateInfo)
+{
+    // Copies the mesh, see `MeshComponent`.
+    return AddMesh(std::make_unique<Mesh>(std::move(InMesh)), std::move(InMeshCreateInfo));
+}
+
+entt::entity Scene::AddMesh(std::unique_ptr<Mesh> InMesh, MeshCreateInfo InMeshCreateInfo, MeshBufferMap MeshBuffers, MeshVertexFormat VertexFormat, const std::vector<uint>& FaceNormals)
 {
     const auto Entity = Registry.create();
 
@@ -61,26 +96,15 @@ entt::entity Scene::AddMesh(Mesh&& InMesh, MeshCreateInfo InMeshCreateInfo)
         SetEntityVisible(Entity, false);
     }
 
-    MeshBufferMap MeshBuffers;
-    for (auto ElementType : AllMeshElementTypes)
-    {
-        auto VertexArrayBuffer = std::make_shared<VertexArray>();
-        std::vector<MeshVertex> Vertices = InMesh.CreateVertices(ElementType);
-        std::vector<uint> Indices = InMesh.CreateIndices(ElementType);
-
-        auto VertexBufferObject = std::make_shared<VertexBuffer>(Vertices.size() * sizeof(MeshVertex));
-        VertexBufferObject->SetLayout(CreateDefaultVertexLayout());
-        VertexBufferObject->SetData(Vertices.data(), Vertices.size() * sizeof(MeshVertex));
-        VertexArrayBuffer->AddVertexBuffer(VertexBufferObject);
-
-        auto IndexBufferObject = std::make_shared<IndexBuffer>(Indices.data(), Indices.size());
-        VertexArrayBuffer->SetIndexBuffer(IndexBufferObject);
-        MeshBuffers.emplace(ElementType, VertexArrayBuffer);
-    }
-    
     SceneMeshGLData->PrimaryMeshs.emplace(Entity, MeshBuffers);
-
-    Registry.emplace<Mesh>(Entity, std::move(InMesh));
+    SceneMeshGLData->SelectionBuffers.emplace(Entity, std::make_shared<MeshSelectionBuffer>(*InMesh));
+    SceneMeshGLData->VertexDecodings.emplace(Entity, MeshVertexDecoding(VertexFormat, InMesh->GetBoundingBox()));
+    const uint EmptyFaceNormal = 0; // Storage buffers can't be empty.
+    SceneMeshGLData->FaceNormalBuffers.emplace(Entity, std::make_shared<StorageBuffer>(
+        FaceNormals.empty() ? &EmptyFaceNormal : FaceNormals.data(), uint32_t(std::max<size_t>(FaceNormals.size(), 1) * sizeof(uint)), MeshGLData::FaceNormalsBinding));
+
+    Registry.emplace<MeshComponent>(Entity, std::move(InMesh));
+    Registry.emplace<EntityTreeProxy>(Entity, EntityTree.Insert(ComputeWorldBoundingBox(Entity), static_cast<uint>(Entity)));
     
     if(InMeshCreateInfo.bIsSelect)
     {
@@ -97,12 +121,113 @@ entt::entity Scene::AddMesh(Mesh&& InMesh, MeshCreateInfo InMeshCreateInfo)
 
 entt::entity Scene::AddMesh(const fs::path& MeshFilePath, MeshCreateInfo InMeshCreateInfo)
 {
-    return AddMesh(Mesh(MeshFilePath), std::move(InMeshCreateInfo));
+    return AddMesh(std::make_unique<Mesh>(MeshFilePath), std::move(InMeshCreateInfo));
+}
+
+void Scene::ImportMesh(const fs::path& MeshFilePath, MeshCreateInfo InMeshCreateInfo)
+{
+    auto Import = std::make_shared<MeshImport>();
+    Import->FilePath = MeshFilePath;
+    Import->CreateInfo = std::move(InMeshCreateInfo);
+    MeshImports.emplace_back(Import);
+
+    // The task only touches the import, so it is safe to outlive the scene. Render settings are read here, since the UI may change them
+    // while the task runs.
+    const MeshLoadOptions LoadOptions = Mesh::GetLoadOptions();
+    const MeshVertexFormat VertexFormat = Mesh::RenderVertexFormat;
+    const bool bShareFaceVertices = Mesh::bShareFaceVertices;
+    ThreadPool::Get().EnqueueBackground([Import, LoadOptions, VertexFormat, bShareFaceVertices]
+    {
+        Import->LoadedMesh = std::make_unique<Mesh>(Import->FilePath, LoadOptions, &Import->Progress);
+        Import->Progress.Set("Creating buffers", 1);
+        Import->ElementData = Import->LoadedMesh->CreateElementBuffers(VertexFormat, bShareFaceVertices);
+        Import->FaceNormals = Import->LoadedMesh->CreateFaceNormals();
+        for (const auto& Element : Import->ElementData)
+        {
+            Import->TotalBytes += Element.VertexData.size() + Element.Indices.size() * sizeof(uint);
+        }
+        Import->Progress.Set("Uploading", 0);
+        Import->bIsLoaded = true;
+    });
+}
+
+void Scene::UploadMeshImportSlice(MeshImport& Import)
+{
+    auto& Element = Import.ElementData[Import.UploadingElement];
+    if (Element.bSharesVertexBuffers)
+    {
+        Import.Buffers.emplace(Element.ElementType, Import.Buffers.at(MeshElementType::Vertex));
+        ++Import.UploadingElement;
+        return;
+    }
+
+    const size_t VertexBytes = Element.VertexData.size(), IndexBytes = Element.Indices.size() * sizeof(uint);
+    if (!Import.UploadingArray)
+    {
+        Import.UploadingArray = std::make_shared<VertexArray>();
+        auto VertexBufferObject = std::make_shared<VertexBuffer>(VertexBytes);
+        VertexBufferObject->SetLayout(CreateDefaultVertexLayout(Element.VertexFormat));
+        Import.UploadingArray->AddVertexBuffer(VertexBufferObject);
+        Import.UploadingArray->SetIndexBuffer(std::make_shared<IndexBuffer>(Element.Indices.size()));
+    }
+
+    if (Import.UploadedBytes < VertexBytes)
+    {
+        const size_t Size = std::min(MeshUploadSliceSize, VertexBytes - Import.UploadedBytes);
+        Import.UploadingArray->GetVertexBuffers().front()->SetData(Element.VertexData.data() + Import.UploadedBytes, Size, Import.UploadedBytes);
+        Import.UploadedBytes += Size;
+        Import.UploadedTotalBytes += Size;
+    }
+    else if (Import.UploadedBytes < VertexBytes + IndexBytes)
+    {
+        const size_t Offset = (Import.UploadedBytes - VertexBytes) / sizeof(uint);
+        const size_t Count = std::min(MeshUploadSliceSize / sizeof(uint), Element.Indices.size() - Offset);
+        Import.UploadingArray->GetIndexBuffer()->SetData(Element.Indices.data() + Offset, Count, Offset);
+        Import.UploadedBytes += Count * sizeof(uint);
+        Import.UploadedTotalBytes += Count * sizeof(uint);
+    }
+
+    if (Import.UploadedBytes == VertexBytes + IndexBytes)
+    {
+        Import.Buffers.emplace(Element.ElementType, std::move(Import.UploadingArray));
+        Import.UploadingArray.reset();
+        Import.UploadedBytes = 0;
+        ++Import.UploadingElement;
+        Element = {Element.ElementType, Element.VertexFormat, {}, {}}; // Release the uploaded data.
+    }
+    Import.Progress.Set("Uploading", Import.TotalBytes == 0 ? 1.f : float(Import.UploadedTotalBytes) / float(Import.TotalBytes));
+}
+
+void Scene::UpdateMeshImports()
+{
+    const auto StartTime = std::chrono::steady_clock::now();
+    const auto IsInBudget = [&]
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - StartTime).count() < MeshUploadBudgetMs;
+    };
+
+    for (auto It = MeshImports.begin(); It != MeshImports.end();)
+    {
+        MeshImport& Import = **It;
+        if (!Import.bIsLoaded)
+        {
+            ++It;
+            continue;
+        }
+
+        while (Import.UploadingElement < Import.ElementData.size() && IsInBudget()) UploadMeshImportSlice(Import);
+        if (Import.UploadingElement < Import.ElementData.size()) return;
+
+        // The wide BVH follows the query type of when the import started, which may have changed since.
+        Import.LoadedMesh->UpdateWideBVH();
+        AddMesh(std::move(Import.LoadedMesh), std::move(Import.CreateInfo), std::move(Import.Buffers), Import.ElementData.front().VertexFormat, Import.FaceNormals);
+        It = MeshImports.erase(It);
+    }
 }
 
 const Mesh& Scene::GetSelectedMesh() const
 {
-    return Registry.get<Mesh>(SelectedEntity);
+    return GetMesh(SelectedEntity);
 }
 
 void Scene::Render()
@@ -131,13 +256,21 @@ void Scene::Render()
         auto Entity = PrimaryMesh.first;
         auto ModelStruct = SceneMeshGLData->ModelMatrices.at(Entity);
         auto MeshVertexArrayBuffer = PrimaryMesh.second.at(SelectionMeshElementType);
+        const auto& VertexDecoding = SceneMeshGLData->VertexDecodings.at(Entity);
         
         SceneRenderer->UpdateShaderData({
+            // Vertex format, shared by the mesh shaders
+            ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_VertexFormat", std::nullopt, std::nullopt, std::nullopt, static_cast<int>(VertexDecoding.Format)},
+            ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_PositionOffset", std::nullopt, VertexDecoding.PositionOffset, std::nullopt},
+            ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_PositionScale", std::nullopt, VertexDecoding.PositionScale, std::nullopt},
+
             // Phong Shader
             ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_ModelMatrix", std::nullopt, std::nullopt, ModelStruct->Transform},
             ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_DiffuseColor", std::nullopt, SceneRenderer->ShaderData.Phong_Diffuse, std::nullopt},
             ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_SpecularColor", std::nullopt, SceneRenderer->ShaderData.Phong_Specular, std::nullopt},
             ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_Gloss", SceneRenderer->ShaderData.Phong_Gloss, std::nullopt, std::nullopt},
+            ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_HighlightColor", std::nullopt, Mesh::HighlightColor, std::nullopt},
+            ShaderBindingDescriptor{ShaderPipelineType::Phong, "u_ElementType", std::nullopt, std::nullopt, std::nullopt, static_cast<int>(SelectionMeshElementType)},
 
             // Depth Shader
             ShaderBindingDescriptor{ShaderPipelineType::Depth, "u_ModelMatrix", std::nullopt, std::nullopt, ModelStruct->Transform},
@@ -145,6 +278,8 @@ void Scene::Render()
             ShaderBindingDescriptor{ShaderPipelineType::Depth, "u_Far", SceneRenderer->ShaderData.Depth_FarPlane, std::nullopt, std::nullopt},
         });
         
+        SceneMeshGLData->SelectionBuffers.at(Entity)->Bind();
+        SceneMeshGLData->FaceNormalBuffers.at(Entity)->Bind();
         SceneRenderer->Render(MeshVertexArrayBuffer);
     }
 }
@@ -169,34 +304,45 @@ void Scene::UpdateLightsBuffer()
     LightsBuffer->SetData(&LightShaderData, sizeof(LightShaderData));
 }
 
-void Scene::UpdateRenderBuffers(entt::entity InEntity, MeshElementIndex HighLightElement)
+void Scene::UpdateSelectionBuffer(entt::entity InEntity, MeshElementIndex HighLightElement)
 {
     if(InEntity == entt::null)
     {
         return;
     }
 
-    const auto& SelectedMesh = Registry.get<Mesh>(InEntity);
-    auto& MeshBuffers = SceneMeshGLData->PrimaryMeshs.at(InEntity);
-    const Mesh::ElementIndex HighLight{HighLightElement};
-    for(auto ElementType : AllMeshElementTypes)
-    {
-        auto VertexArrayBuffer = MeshBuffers.at(ElementType);
-        std::vector<MeshVertex> Vertices = SelectedMesh.CreateVertices(ElementType, HighLight);
-
-        auto VertexBufferObject = VertexArrayBuffer->GetVertexBuffers()[0];
-        VertexBufferObject->SetData(Vertices.data(), Vertices.size() * sizeof(MeshVertex));
-    }
+    const auto& SelectedMesh = GetMesh(InEntity);
+    auto& SelectionBuffer = SceneMeshGLData->SelectionBuffers.at(InEntity);
+    SelectionBuffer->SetSelected(SelectedMesh.GetHighlightedElements());
+    SelectionBuffer->SetHovered(SelectedMesh.GetElementsHighlightedWith(Mesh::ElementIndex{HighLightElement}));
 }
 
-VertexBufferLayout Scene::CreateDefaultVertexLayout()
+VertexBufferLayout Scene::CreateDefaultVertexLayout(MeshVertexFormat Format)
 {
-    return {
-        {ShaderDataType::Float3, "a_Position"},
-        {ShaderDataType::Float4, "a_Color"},
-        {ShaderDataType::Float3, "a_WorldNormal"},
-        {ShaderDataType::Float2, "a_TexCoord"},
-    };
+    switch(Format)
+    {
+    case MeshVertexFormat::Packed:
+        return {
+            {ShaderDataType::Float3, "a_Position"},
+            {ShaderDataType::UByte4, "a_Color", true},
+            {ShaderDataType::Short2, "a_WorldNormal", true}, // Octahedral.
+            {ShaderDataType::Half2, "a_TexCoord"},
+        };
+    case MeshVertexFormat::Quantized:
+        return {
+            {ShaderDataType::UShort4, "a_Position", true}, // Relative to the mesh bounds.
+            {ShaderDataType::UByte4, "a_Color", true},
+            {ShaderDataType::Short2, "a_WorldNormal", true},
+            {ShaderDataType::Half2, "a_TexCoord"},
+        };
+    default:
+        return {
+            {ShaderDataType::Float3, "a_Position"},
+            {ShaderDataType::Float4, "a_Color"},
+            {ShaderDataType::Float3, "a_WorldNormal"},
+            {ShaderDataType::Float2, "a_TexCoord"},
+        };
+    }
 }
 
 std::optional<unsigned> Scene::GetModelBufferIndex(entt::entity Entity)
@@ -312,6 +458,164 @@ void Scene::SetModelMatrix(entt::entity InEntity, const glm::mat4& InModelMatrix
     Registry.replace<Model>(InEntity, InModelMatrix);
     SceneMeshGLData->ModelMatrices.at(InEntity)->Transform = InModelMatrix;
     SceneMeshGLData->ModelMatrices.at(InEntity)->UpdateInvTransform();
+
+    if(const auto* Proxy = Registry.try_get<EntityTreeProxy>(InEntity))
+    {
+        EntityTree.Move(Proxy->ProxyId, ComputeWorldBoundingBox(InEntity));
+    }
+}
+
+void Scene::SetMeshPositions(entt::entity InEntity, const std::vector<glm::vec3>& Positions)
+{
+    if(InEntity == entt::null)
+    {
+        return;
+    }
+
+    auto& EntityMesh = GetMesh(InEntity);
+    EntityMesh.SetPositions(Positions);
+    if(const auto* Proxy = Registry.try_get<EntityTreeProxy>(InEntity))
+    {
+        EntityTree.Move(Proxy->ProxyId, ComputeWorldBoundingBox(InEntity));
+    }
+
+    // The topology is unchanged, so only the vertices are uploaded again, in place. Quantized positions are relative to the new bounds.
+    auto& VertexDecoding = SceneMeshGLData->VertexDecodings.at(InEntity);
+    VertexDecoding = MeshVertexDecoding(VertexDecoding.Format, EntityMesh.GetBoundingBox());
+    const auto& MeshBuffers = SceneMeshGLData->PrimaryMeshs.at(InEntity);
+    for(const auto& [ElementType, Buffers] : MeshBuffers)
+    {
+        if(ElementType != MeshElementType::Vertex && Buffers == MeshBuffers.at(MeshElementType::Vertex))
+        {
+            continue;
+        }
+        const std::vector<char> VertexData = EntityMesh.CreateVertices(ElementType, VertexDecoding.Format);
+        Buffers->GetVertexBuffers().front()->SetData(VertexData.data(), VertexData.size());
+    }
+    const std::vector<uint> FaceNormals = EntityMesh.CreateFaceNormals();
+    if(!FaceNormals.empty())
+    {
+        SceneMeshGLData->FaceNormalBuffers.at(InEntity)->SetData(FaceNormals.data(), uint32_t(FaceNormals.size() * sizeof(uint)));
+    }
+}
+
+BoundingBox Scene::ComputeWorldBoundingBox(entt::entity InEntity) const
+{
+    return GetMesh(InEntity).GetBoundingBox() * Registry.get<Model>(InEntity).Transform;
+}
+
+entt::entity Scene::FindNearestIntersectingEntity(const Ray& WorldRay, float* DistanceOut) const
+{
+    entt::entity NearestEntity = entt::null;
+    float NearestDistance = std::numeric_limits<float>::max();
+    EntityTree.TraverseLeaves(WorldRay, NearestDistance, [&](uint UserData, float& TMax)
+    {
+        const auto Entity = static_cast<entt::entity>(UserData);
+        if(!Registry.has<Visible>(Entity))
+        {
+            return false;
+        }
+
+        const glm::mat4& Transform = Registry.get<Model>(Entity).Transform;
+        const Ray LocalRay = WorldRay.WorldToLocal(Transform);
+        if(const auto LocalDistance = GetMesh(Entity).Intersect(LocalRay))
+        {
+            // `WorldToLocal` renormalizes the direction, so measure the hit point along the world ray instead.
+            const glm::vec3 WorldPoint = Transform * glm::vec4(LocalRay(*LocalDistance), 1);
+            const float Distance = glm::dot(WorldPoint - WorldRay.Origin, WorldRay.Direction) / glm::dot(WorldRay.Direction, WorldRay.Direction);
+            if(Distance < TMax)
+            {
+                TMax = Distance;
+                NearestEntity = Entity;
+            }
+        }
+        return false;
+    });
+
+    if(NearestEntity != entt::null && DistanceOut)
+    {
+        *DistanceOut = NearestDistance;
+    }
+    return NearestEntity;
+}
+
+size_t Scene::FindIntersections(entt::entity Entity, bool bIsHighlight)
+{
+    if(Entity == entt::null)
+    {
+        return 0;
+    }
+
+    const auto& EntityMesh = GetMesh(Entity);
+    std::unordered_map<entt::entity, std::vector<Mesh::ElementIndex>> IntersectingFaces;
+    size_t PairCount = 0;
+    for(const auto& [FaceHandle, OtherFaceHandle] : EntityMesh.FindSelfIntersectingFaces())
+    {
+        IntersectingFaces[Entity].insert(IntersectingFaces[Entity].end(), {FaceHandle, OtherFaceHandle});
+        ++PairCount;
+    }
+
+    const BoundingBox WorldBox = ComputeWorldBoundingBox(Entity);
+    const glm::mat4 InvTransform = glm::inverse(Registry.get<Model>(Entity).Transform);
+    for(const auto Other : Registry.view<MeshComponent, Visible>())
+    {
+        if(Other == Entity || !WorldBox.Overlaps(ComputeWorldBoundingBox(Other)))
+        {
+            continue;
+        }
+
+        const auto FacePairs = EntityMesh.FindIntersectingFaces(GetMesh(Other), InvTransform * Registry.get<Model>(Other).Transform);
+        for(const auto& [FaceHandle, OtherFaceHandle] : FacePairs)
+        {
+            IntersectingFaces[Entity].emplace_back(FaceHandle);
+            IntersectingFaces[Other].emplace_back(OtherFaceHandle);
+        }
+        PairCount += FacePairs.size();
+    }
+
+    if(bIsHighlight)
+    {
+        // Meshes that no longer intersect lose their highlights from earlier queries.
+        for(const auto HighlightedEntity : Registry.view<MeshComponent>())
+        {
+            if(!GetMesh(HighlightedEntity).GetHighlightedElements().empty())
+            {
+                IntersectingFaces.try_emplace(HighlightedEntity);
+            }
+        }
+        for(auto& [IntersectingEntity, Faces] : IntersectingFaces)
+        {
+            std::sort(Faces.begin(), Faces.end());
+            Faces.erase(std::unique(Faces.begin(), Faces.end()), Faces.end());
+            GetMesh(IntersectingEntity).SetHighlightedElements(std::move(Faces));
+            UpdateSelectionBuffer(IntersectingEntity, IntersectingEntity == SelectedEntity ? SelectedElement : MeshElementIndex{});
+        }
+    }
+    return PairCount;
+}
+
+void Scene::SelectElementsInRegion(MeshSelectionRegion Region, bool bIsVisibleOnly)
+{
+    if(SelectedEntity == entt::null || SelectionMeshElementType == MeshElementType::None)
+    {
+        return;
+    }
+
+    std::vector<float> DepthBuffer;
+    if(bIsVisibleOnly)
+    {
+        const auto SceneFrameBuffer = SceneRenderer->GetFrameBuffer();
+        DepthBuffer = SceneFrameBuffer->ReadDepth();
+        Region.Depth = DepthBuffer.data();
+        Region.DepthWidth = SceneFrameBuffer->GetSpecification().Width;
+        Region.DepthHeight = SceneFrameBuffer->GetSpecification().Height;
+    }
+
+    auto& SelectedMesh = GetMesh(SelectedEntity);
+    const glm::mat4 LocalToClip = SceneCamera.GetViewProjectionMatrix() * GetModelMatrix(SelectedEntity);
+    SelectedMesh.SetHighlightedElements(SelectedMesh.FindElementsInRegion(SelectionMeshElementType, LocalToClip, Region));
+    SelectedElement = {};
+    UpdateSelectionBuffer(SelectedEntity, SelectedElement);
 }
 
 LINK_EDITOR_NAMESPACE_END
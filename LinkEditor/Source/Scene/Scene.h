@@ -6,9 +6,12 @@
 #include "Renderer/Camera/Camera.h"
 #include "Renderer/Buffers/VertexBuffer.h"
 #include "Renderer/Buffers/UniformBuffer.h"
+#include "Renderer/Buffers/StorageBuffer.h"
 #include "Renderer/Buffers/VertexArray.h"
 #include "Renderer/Light/DirectionalLight/DirectionalLight.h"
 #include "Renderer/Mesh/Mesh.h"
+#include "Renderer/Mesh/MeshSelectionBuffer.h"
+#include "Renderer/AccelerationStructures/DynamicAABBTree/DynamicAABBTree.h"
 
 #include "entt.hpp"
 
@@ -32,6 +35,21 @@ struct Model {
     glm::mat4 InvTransform = glm::mat4(1);
 };
 
+// Mesh of an entity. OpenMesh meshes can't be moved, only copied, so the registry holds them behind a pointer. Use `Scene::GetMesh`.
+using MeshComponent = std::unique_ptr<Mesh>;
+
+// Leaf of the entity's world bounds in `Scene::EntityTree`.
+struct EntityTreeProxy
+{
+    uint ProxyId;
+};
+
+// Destination of the entity's last export, reused by "Export Mesh".
+struct ExportDestination
+{
+    fs::path FilePath;
+};
+
 struct ViewProj {
     glm::mat4 ViewMatrix = glm::mat4(1);
     glm::mat4 ProjectionMatrix = glm::mat4(1);
@@ -72,9 +90,33 @@ struct MeshGLData
 {
     std::unordered_map<entt::entity, MeshBufferMap> PrimaryMeshs;
     std::unordered_map<entt::entity, std::shared_ptr<Model>> ModelMatrices;
+    std::unordered_map<entt::entity, std::shared_ptr<MeshSelectionBuffer>> SelectionBuffers;
+    std::unordered_map<entt::entity, MeshVertexDecoding> VertexDecodings;
+    std::unordered_map<entt::entity, std::shared_ptr<StorageBuffer>> FaceNormalBuffers; // `FaceNormalsSSBO` of `Mesh::CreateFaceNormals`.
+    inline static constexpr uint32_t FaceNormalsBinding = 5;
     // std::unordered_map<entt::entity, MeshBufferMap> NormalIndicators;
 };
 
+// A mesh file being loaded on the thread pool. Once loaded, its GL buffers are uploaded on the main thread by `Scene::UpdateMeshImports`.
+struct MeshImport
+{
+    fs::path FilePath;
+    MeshCreateInfo CreateInfo;
+    MeshLoadProgress Progress;
+    std::atomic<bool> bIsLoaded = false; // Set by the loading task once `LoadedMesh` and `ElementData` are complete.
+    std::unique_ptr<Mesh> LoadedMesh;
+    std::vector<MeshElementBuffers> ElementData;
+    std::vector<uint> FaceNormals;
+    size_t TotalBytes = 0; // Of all vertices and indices in `ElementData`.
+
+    // Upload state, only used on the main thread.
+    MeshBufferMap Buffers;
+    std::shared_ptr<VertexArray> UploadingArray;
+    size_t UploadingElement = 0; // Index in `ElementData`.
+    size_t UploadedBytes = 0;    // Of the uploading element's vertices, followed by its indices.
+    size_t UploadedTotalBytes = 0;
+};
+
 struct LightShaderParameters
 {
     glm::vec4 LightColorAndAmbient;
@@ -91,9 +133,19 @@ public:
     uint32_t GetViewportWidth() const { return ViewportWidth; }
     uint32_t GetViewportHeight() const { return ViewportHeight; }
 
+    entt::entity AddMesh(std::unique_ptr<Mesh> InMesh, MeshCreateInfo InMeshCreateInfo = {});
     entt::entity AddMesh(Mesh&& InMesh, MeshCreateInfo InMeshCreateInfo = {});
     entt::entity AddMesh(const fs::path& MeshFilePath, MeshCreateInfo InMeshCreateInfo = {});
+    // Loads the mesh file on the thread pool, without blocking. The mesh is added by `UpdateMeshImports` once it is loaded and uploaded.
+    // Several imports run concurrently.
+    void ImportMesh(const fs::path& MeshFilePath, MeshCreateInfo InMeshCreateInfo = {});
+    // Uploads the GL buffers of loaded imports in slices of `MeshUploadSliceSize` bytes for up to `MeshUploadBudgetMs`, and adds the
+    // meshes whose buffers are complete. Called once per frame, on the main thread.
+    void UpdateMeshImports();
+    const std::vector<std::shared_ptr<MeshImport>>& GetMeshImports() const { return MeshImports; }
     const Mesh& GetSelectedMesh() const;
+    Mesh& GetMesh(entt::entity Entity) { return *Registry.get<MeshComponent>(Entity); }
+    const Mesh& GetMesh(entt::entity Entity) const { return *Registry.get<MeshComponent>(Entity); }
     entt::entity GetSelectedEntity() const;
     entt::entity GetParentEntity(entt::entity Entity) const;
     std::string GetEntityName(entt::entity Entity) const;
@@ -101,13 +153,25 @@ public:
     void SelectEntity(entt::entity InEntity);
     glm::mat4 GetModelMatrix(entt::entity Entity) const;
     void SetModelMatrix(entt::entity Entity, const glm::mat4& InModelMatrix);
+    // Moves the vertices of the entity's mesh with `Mesh::SetPositions`, and updates its bounds in `EntityTree` and its render buffers.
+    void SetMeshPositions(entt::entity Entity, const std::vector<glm::vec3>& Positions);
+    BoundingBox ComputeWorldBoundingBox(entt::entity Entity) const;
+    // Nearest visible entity hit by the ray, or `entt::null`. Sets `DistanceOut` to the distance along the world ray, if not null.
+    entt::entity FindNearestIntersectingEntity(const Ray& WorldRay, float* DistanceOut = nullptr) const;
+    // Highlights the elements of type `SelectionMeshElementType` of the selected mesh inside the viewport region.
+    // With `bIsVisibleOnly`, the depth buffer is read back so that occluded elements are skipped.
+    void SelectElementsInRegion(MeshSelectionRegion Region, bool bIsVisibleOnly);
+    // Finds the faces of the entity's mesh that intersect each other or another visible mesh, and returns the number of intersecting
+    // face pairs. With `bIsHighlight`, the intersecting faces of all involved meshes become their highlighted elements.
+    size_t FindIntersections(entt::entity Entity, bool bIsHighlight);
     
     void Render();
-    VertexBufferLayout CreateDefaultVertexLayout();
+    VertexBufferLayout CreateDefaultVertexLayout(MeshVertexFormat Format = MeshVertexFormat::Float);
     std::optional<unsigned int> GetModelBufferIndex(entt::entity Entity);
     void UpdateViewProjBuffers();
     void UpdateLightsBuffer();
-    void UpdateRenderBuffers(entt::entity InEntity, MeshElementIndex HighLightElement);
+    // Shows the mesh's highlighted elements as selected, and `HighLightElement` as hovered, uploading only the changed selection bits.
+    void UpdateSelectionBuffer(entt::entity InEntity, MeshElementIndex HighLightElement);
 
     Camera CreateDefaultCamera() const;
 
@@ -121,6 +185,7 @@ public:
     
     entt::registry Registry;
     entt::entity SelectedEntity = entt::null;
+    DynamicAABBTree EntityTree; // World bounds of all mesh entities, for picking.
 
     std::unique_ptr<Renderer> SceneRenderer;
     RenderMode SceneRenderMode = RenderMode::Face;
@@ -131,10 +196,20 @@ public:
     MeshElementType SelectionMeshElementType = MeshElementType::Face;
     MeshElementIndex SelectedElement;
 
+    float MeshUploadBudgetMs = 4; // Main thread time per frame for uploading imported meshes.
+    inline static constexpr size_t MeshUploadSliceSize = 4 << 20;
+
     // buffers
     std::unique_ptr<UniformBuffer> ViewProjBuffer;
     std::unique_ptr<UniformBuffer> ViewProjNearFarBuffer;
     std::unique_ptr<UniformBuffer> LightsBuffer;
+
+private:
+    entt::entity AddMesh(std::unique_ptr<Mesh> InMesh, MeshCreateInfo InMeshCreateInfo, MeshBufferMap MeshBuffers, MeshVertexFormat VertexFormat, const std::vector<uint>& FaceNormals);
+    // Uploads the next slice of the import's buffers, and moves to its next element buffers once the current ones are complete.
+    void UploadMeshImportSlice(MeshImport& Import);
+
+    std::vector<std::shared_ptr<MeshImport>> MeshImports;
 };
 
 LINK_EDITOR_NAMESPACE_END
\ No newline at end of file
@@ -13,6 +13,10 @@
 #include <functional>
 #include <filesystem>
 #include <optional>
+#include <array>
+#include <numeric>
+#include <chrono>
+#include <random>
 
 #include <string>
 #include <sstream>
@@ -21,6 +25,12 @@
 #include <list>
 #include <unordered_map>
 #include <unordered_set>
+#include <deque>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include <format>
 